@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Device.h"
+#include "Draw.h"
+#include "GpuProfiler.h"
+#include "BenchRuntime.h"
+#include "SyntheticScene.h"
+
+
+namespace{
+    struct BenchOptions{
+        uint32_t frames = 300;
+        uint32_t warmupFrames = 30;  // 不计入统计，等待管线、驱动缓存和时钟稳定
+        uint32_t width = 800;
+        uint32_t height = 600;
+        const char* output = nullptr;  // 为空时输出到标准输出
+        Bench::SceneParameters scene;
+    };
+
+    void printUsage(){
+        std::cerr << "usage: VulkanBench [--frames N] [--warmup N] [--meshes N] [--instances N] [--pipelines N]\n"
+                     "                   [--seed N] [--width N] [--height N] [--static] [--output FILE]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options){
+        for (int i = 1; i < argc; i++) {
+            const char* name = argv[i];
+            if (strcmp(name, "--static") == 0) {
+                options.scene.animate = false;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (strcmp(name, "--output") == 0) {
+                options.output = value;
+                continue;
+            }
+            uint32_t number = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            if (strcmp(name, "--frames") == 0) options.frames = number;
+            else if (strcmp(name, "--warmup") == 0) options.warmupFrames = number;
+            else if (strcmp(name, "--meshes") == 0) options.scene.meshCount = number;
+            else if (strcmp(name, "--instances") == 0) options.scene.instanceCount = number;
+            else if (strcmp(name, "--pipelines") == 0) options.scene.pipelineCount = number;
+            else if (strcmp(name, "--seed") == 0) options.scene.seed = number;
+            else if (strcmp(name, "--width") == 0) options.width = number;
+            else if (strcmp(name, "--height") == 0) options.height = number;
+            else return false;
+        }
+        return options.frames > 0 && options.width > 0 && options.height > 0;
+    }
+}
+
+int main(int argc, char** argv){
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Bench::Runtime::DoInit(options.width, options.height);
+
+        Bench::SyntheticScene::create(options.scene);
+        DrawSpace::CommondFactory::setSceneRecorder(Bench::SyntheticScene::record);
+
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> frameTimes;
+        std::vector<double> gpuTimes;
+        uint64_t drawCount = 0;
+        uint64_t triangleCount = 0;
+        uint64_t lastGpuFrame = 0;
+        Clock::time_point measureStart = Clock::now();
+        uint32_t totalFrames = options.warmupFrames + options.frames;
+        for (uint32_t frame = 0; frame < totalFrames; frame++) {
+            if (frame == options.warmupFrames) {
+                measureStart = Clock::now();
+            }
+            Clock::time_point frameStart = Clock::now();
+            Bench::SyntheticScene::update(frame);
+            DrawSpace::CommondFactory::drawFrame();
+            if (frame < options.warmupFrames) {
+                continue;
+            }
+
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+            drawCount += Bench::SyntheticScene::getLastDrawCount();
+            triangleCount += Bench::SyntheticScene::getLastTriangleCount();
+            // GPU计时延迟几帧才回读，每个回读到的帧只记录一次
+            const auto& timings = Profiling::GpuProfiler::getFrameTimings();
+            uint64_t gpuFrame = Profiling::GpuProfiler::getTimingsFrameNumber();
+            if (!timings.empty() && gpuFrame != lastGpuFrame) {
+                gpuTimes.push_back(timings[0].milliseconds);
+                lastGpuFrame = gpuFrame;
+            }
+        }
+        vkDeviceWaitIdle(Device::VulkanDevice::getLogicalDevice());
+        double seconds = std::chrono::duration<double>(Clock::now() - measureStart).count();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(Device::VulkanDevice::getPhysicalDevice(), &properties);
+        std::string deviceName = properties.deviceName;
+        std::replace(deviceName.begin(), deviceName.end(), '"', '\'');
+
+        FILE* file = options.output ? fopen(options.output, "w") : stdout;
+        if (!file) {
+            throw std::runtime_error("failed to open benchmark output file!");
+        }
+        fprintf(file, "{\n");
+        fprintf(file, "  \"device\": \"%s\",\n", deviceName.c_str());
+        fprintf(file, "  \"scene\": {\"meshes\": %u, \"instances\": %u, \"pipelines\": %u, \"seed\": %u, \"animate\": %s},\n",
+                options.scene.meshCount, options.scene.instanceCount, options.scene.pipelineCount, options.scene.seed,
+                options.scene.animate ? "true" : "false");
+        fprintf(file, "  \"extent\": {\"width\": %u, \"height\": %u},\n", options.width, options.height);
+        fprintf(file, "  \"frames\": %u,\n  \"warmupFrames\": %u,\n  \"seconds\": %.4f,\n", options.frames, options.warmupFrames, seconds);
+        fprintf(file, "  \"framesPerSecond\": %.2f,\n", options.frames / seconds);
+        fprintf(file, "  \"drawsPerFrame\": %.1f,\n", static_cast<double>(drawCount) / options.frames);
+        fprintf(file, "  \"trianglesPerSecond\": %.0f,\n", triangleCount / seconds);
+        Bench::writeSummary(file, "frameTimeMs", Bench::summarize(frameTimes), false);
+        Bench::writeSummary(file, "gpuFrameTimeMs", Bench::summarize(gpuTimes), true);
+        fprintf(file, "}\n");
+        if (file != stdout) {
+            fclose(file);
+        }
+
+        Bench::SyntheticScene::cleanup();
+        Bench::Runtime::cleanup();
+
+        // 一次绘制都没有说明场景没有被渲染，作为测试失败处理
+        if (drawCount == 0) {
+            std::cerr << "benchmark recorded no draws" << std::endl;
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "BenchRuntime.h"
+#include "window.h"
+#include "Instance.h"
+#include "Device.h"
+#include "Present.h"
+#include "Draw.h"
+#include "PipelineData.h"
+#include "Config.h"
+#include "Descriptor.h"
+#include "Scene.h"
+#include "Jobs.h"
+#include "Sync.h"
+#include "GpuProfiler.h"
+#include "Capture.h"
+#include "Readback.h"
+#include "VideoSink.h"
+#include "FramePacer.h"
+#include "ShaderReload.h"
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+
+
+namespace Bench{
+    void Runtime::DoInit(uint32_t width, uint32_t height){
+        Config::presentGoal = Config::PresentGoal::MaxThroughput;
+        // 每次绘制的查询会计入测得的帧时间，需要时用VULKAN_PIPELINE_STATS=1打开
+        Config::enablePipelineStatistics = false;
+        Config::loadEnvironmentOverrides();
+        Config::enableValidationLayers = false;
+        Config::headless = true;
+        Config::headlessExtent = {width, height};
+
+        // 初始化和清理的顺序与VulkanMain保持一致
+        int error_code = 0;
+        Jobs::DoInit();
+        ShaderCompiler::DoInit();
+        Capture::DoInit();
+        Init::GlfwWindow::initWindow(error_code);
+        VkResult vk_error_code;
+        Init::Instance::CreateInstance(vk_error_code);
+        Config::setupDebugMessenger();
+        Device::DoInit();
+        Sync::DoInit();
+        Profiling::DoInit();
+        Readback::DoInit();
+        Video::DoInit();
+        Descriptor::DoInit();
+        Scene::DoInit();
+        Presentation::SwapChain::DoInit();
+        PipelineData::DoInit();
+        DrawSpace::CommondFactory::DoInit();
+        ShaderReload::DoInit();
+    }
+
+    void Runtime::cleanup(){
+        vkDeviceWaitIdle(Device::VulkanDevice::getLogicalDevice());
+        Readback::FrameReadback::collectAll();
+        Video::cleanup();
+        Capture::cleanup();
+        ShaderReload::cleanup();
+        Presentation::SwapChain::cleanup();
+        PipelineData::cleanup();
+        DrawSpace::CommondFactory::cleanup();
+        Scene::cleanup();
+        Descriptor::cleanup();
+        Readback::cleanup();
+        Profiling::cleanup();
+        Sync::cleanup();
+        Device::VulkanDevice::cleanup();
+        Init::Instance::cleanup();
+        Init::GlfwWindow::cleanup();
+        ShaderCompiler::cleanup();
+        Jobs::cleanup();
+    }
+
+    Summary summarize(const std::vector<double>& samples){
+        Summary summary;
+        if (samples.empty()) {
+            return summary;
+        }
+        // 与帧节奏统计使用同一种百分位算法
+        Pacing::RollingWindow window(static_cast<uint32_t>(samples.size()));
+        double total = 0.0;
+        for (double sample : samples) {
+            window.add(sample);
+            total += sample;
+            summary.max = std::max(summary.max, sample);
+        }
+        summary.mean = total / samples.size();
+        Pacing::Percentiles percentiles = window.compute();
+        summary.p50 = percentiles.p50;
+        summary.p95 = percentiles.p95;
+        summary.p99 = percentiles.p99;
+        return summary;
+    }
+
+    void writeSummary(FILE* file, const char* name, const Summary& summary, bool last){
+        fprintf(file, "  \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+                name, summary.mean, summary.p50, summary.p95, summary.p99, summary.max,
+                last ? "" : ",");
+    }
+}
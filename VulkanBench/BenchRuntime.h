@@ -0,0 +1,29 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Bench{
+    // 基准测试程序共用的无窗口渲染器初始化和销毁，顺序与VulkanMain.cpp一致
+    class Runtime{
+        Runtime();
+        Runtime(const Runtime&)=delete;
+        Runtime(const Runtime&&)=delete;
+        Runtime& operator=(const Runtime&)=delete;
+    public:
+        // 默认不限制帧率、不开验证层，环境变量仍然可以覆盖呈现目标
+        static void DoInit(uint32_t width, uint32_t height);
+        static void cleanup();
+    };
+
+    // 样本的均值、最大值和百分位，单位与样本一致
+    struct Summary{
+        double mean = 0.0;
+        double max = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+    };
+    Summary summarize(const std::vector<double>& samples);
+    // 写出一行"name": {...}，last为false时行尾加逗号
+    void writeSummary(FILE* file, const char* name, const Summary& summary, bool last);
+}
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ImageDiff.h"
+
+
+namespace{
+    struct DiffOptions{
+        const char* reference = nullptr;
+        const char* actual = nullptr;
+        uint32_t tolerance = 2;            // 单个通道允许的绝对差，吸收驱动间的舍入差异
+        double maxMismatchRatio = 0.0;     // 超过容差的像素占比上限
+        double minPsnr = 0.0;              // 为0时不检查
+        const char* mask = nullptr;
+        const char* output = nullptr;
+        ImageDiff::Comparator::Kernel kernel = ImageDiff::Comparator::Kernel::Auto;
+    };
+
+    void printUsage(){
+        std::cerr << "usage: VulkanImageDiff REFERENCE ACTUAL [--tolerance N] [--max-mismatch RATIO] [--min-psnr DB]"
+                     " [--mask FILE] [--kernel auto|scalar|avx2] [--output FILE]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char** argv, DiffOptions& options){
+        for (int i = 1; i < argc; i++) {
+            const char* name = argv[i];
+            if (name[0] != '-') {
+                if (options.reference == nullptr) options.reference = name;
+                else if (options.actual == nullptr) options.actual = name;
+                else return false;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (strcmp(name, "--tolerance") == 0) options.tolerance = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (strcmp(name, "--max-mismatch") == 0) options.maxMismatchRatio = std::strtod(value, nullptr);
+            else if (strcmp(name, "--min-psnr") == 0) options.minPsnr = std::strtod(value, nullptr);
+            else if (strcmp(name, "--mask") == 0) options.mask = value;
+            else if (strcmp(name, "--output") == 0) options.output = value;
+            else if (strcmp(name, "--kernel") == 0) {
+                if (strcmp(value, "auto") == 0) options.kernel = ImageDiff::Comparator::Kernel::Auto;
+                else if (strcmp(value, "scalar") == 0) options.kernel = ImageDiff::Comparator::Kernel::Scalar;
+                else if (strcmp(value, "avx2") == 0) options.kernel = ImageDiff::Comparator::Kernel::Avx2;
+                else return false;
+            }
+            else return false;
+        }
+        return options.reference != nullptr && options.actual != nullptr && options.tolerance <= 255;
+    }
+
+    std::string escape(std::string text){
+        for (char& c : text) {
+            if (c == '"' || c == '\\') c = '\'';
+        }
+        return text;
+    }
+}
+
+int main(int argc, char** argv){
+    DiffOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        ImageDiff::Image reference = ImageDiff::readPpm(options.reference);
+        ImageDiff::Image actual = ImageDiff::readPpm(options.actual);
+
+        ImageDiff::Comparator::setKernel(options.kernel);
+        std::vector<uint8_t> mask;
+        auto start = std::chrono::steady_clock::now();
+        ImageDiff::DiffResult result = ImageDiff::Comparator::compare(reference, actual, static_cast<uint8_t>(options.tolerance),
+                                                                      options.mask ? &mask : nullptr);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (options.mask) {
+            ImageDiff::writePgm(options.mask, reference.width, reference.height, mask);
+        }
+
+        double mismatchRatio = result.pixelCount ? static_cast<double>(result.mismatchCount) / result.pixelCount : 0.0;
+        bool passed = mismatchRatio <= options.maxMismatchRatio && (options.minPsnr <= 0.0 || result.psnr >= options.minPsnr);
+
+        FILE* file = options.output ? fopen(options.output, "w") : stdout;
+        if (!file) {
+            throw std::runtime_error("failed to open image diff output file!");
+        }
+        fprintf(file, "{\n");
+        fprintf(file, "  \"reference\": \"%s\",\n", escape(options.reference).c_str());
+        fprintf(file, "  \"actual\": \"%s\",\n", escape(options.actual).c_str());
+        fprintf(file, "  \"extent\": {\"width\": %u, \"height\": %u},\n", reference.width, reference.height);
+        fprintf(file, "  \"tolerance\": %u,\n", options.tolerance);
+        fprintf(file, "  \"mismatchedPixels\": %llu,\n", static_cast<unsigned long long>(result.mismatchCount));
+        fprintf(file, "  \"mismatchRatio\": %.6f,\n", mismatchRatio);
+        fprintf(file, "  \"maxError\": %u,\n", result.maxError);
+        fprintf(file, "  \"channelMaxError\": [%u, %u, %u, %u],\n", result.channelMaxError[0], result.channelMaxError[1],
+                result.channelMaxError[2], result.channelMaxError[3]);
+        fprintf(file, "  \"meanAbsoluteError\": %.6f,\n", result.meanAbsoluteError);
+        // JSON没有无穷大，两幅图完全相同时PSNR输出为null
+        if (std::isinf(result.psnr)) {
+            fprintf(file, "  \"psnr\": null,\n");
+        } else {
+            fprintf(file, "  \"psnr\": %.3f,\n", result.psnr);
+        }
+        fprintf(file, "  \"compareMs\": %.4f,\n", milliseconds);
+        fprintf(file, "  \"passed\": %s\n", passed ? "true" : "false");
+        fprintf(file, "}\n");
+        if (file != stdout) {
+            fclose(file);
+        }
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Device.h"
+#include "Draw.h"
+#include "MeshData.h"
+#include "PipelineData.h"
+#include "ShaderRegistry.h"
+#include "Present.h"
+#include "Descriptor.h"
+#include "Bindless.h"
+#include "Culling.h"
+#include "Scene.h"
+#include "Config.h"
+#include "VideoSink.h"
+#include "ImageDiff.h"
+#include "BenchRuntime.h"
+
+
+namespace{
+    struct MicroOptions{
+        double minTimeMs = 200.0;     // 每个基准的总测量时间
+        uint32_t repetitions = 5;     // 取中位数的重复次数
+        const char* filter = nullptr; // 只运行名字包含该字符串的基准
+        const char* output = nullptr;
+        const char* baseline = nullptr;
+        double threshold = 10.0;      // 比基线慢超过该百分比视为回归
+    };
+
+    // run(iterations)执行iterations次被测操作
+    struct Benchmark{
+        std::string subsystem;
+        std::string name;
+        uint64_t bytesPerOperation;
+        std::function<void(uint64_t iterations)> run;
+    };
+
+    struct Result{
+        std::string subsystem;
+        std::string name;
+        uint64_t iterations = 0;
+        double nsPerOperation = 0.0;
+        double bytesPerSecond = 0.0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+    const uint64_t MAX_ITERATIONS = 1ull << 32;
+
+    void printUsage(){
+        std::cerr << "usage: VulkanMicroBench [--filter TEXT] [--min-time MS] [--repetitions N] [--output FILE]\n"
+                     "                        [--baseline FILE] [--threshold PERCENT]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char** argv, MicroOptions& options){
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* name = argv[i];
+            const char* value = argv[i + 1];
+            if (strcmp(name, "--filter") == 0) options.filter = value;
+            else if (strcmp(name, "--min-time") == 0) options.minTimeMs = std::strtod(value, nullptr);
+            else if (strcmp(name, "--repetitions") == 0) options.repetitions = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (strcmp(name, "--output") == 0) options.output = value;
+            else if (strcmp(name, "--baseline") == 0) options.baseline = value;
+            else if (strcmp(name, "--threshold") == 0) options.threshold = std::strtod(value, nullptr);
+            else return false;
+        }
+        return argc % 2 == 1 && options.minTimeMs > 0.0 && options.repetitions > 0;
+    }
+
+    double timeOnce(const Benchmark& benchmark, uint64_t iterations){
+        Clock::time_point start = Clock::now();
+        benchmark.run(iterations);
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Result measure(const Benchmark& benchmark, const MicroOptions& options){
+        // 先把迭代次数放大到一次运行大约占总时间的1/repetitions，再重复测量取中位数
+        double target = options.minTimeMs / 1000.0 / options.repetitions;
+        uint64_t iterations = 1;
+        while (iterations < MAX_ITERATIONS) {
+            double seconds = timeOnce(benchmark, iterations);
+            if (seconds >= target) {
+                break;
+            }
+            double scale = seconds > 0.0 ? std::min(10.0, target / seconds * 1.2) : 10.0;
+            iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * scale));
+        }
+
+        std::vector<double> samples;
+        for (uint32_t repetition = 0; repetition < options.repetitions; repetition++) {
+            samples.push_back(timeOnce(benchmark, iterations) * 1e9 / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.subsystem = benchmark.subsystem;
+        result.name = benchmark.name;
+        result.iterations = iterations;
+        result.nsPerOperation = samples[samples.size() / 2];
+        if (benchmark.bytesPerOperation > 0) {
+            result.bytesPerSecond = benchmark.bytesPerOperation * 1e9 / result.nsPerOperation;
+        }
+        return result;
+    }
+
+    // ---------- 被测的热点路径 ----------
+
+    void addUploadBenchmarks(std::vector<Benchmark>& benchmarks){
+        // 暂存缓冲区创建、映射拷贝、设备缓冲区创建和一次传输提交，即MeshData上传网格的完整流程
+        const uint64_t sizes[] = {4ull << 10, 64ull << 10, 1ull << 20, 16ull << 20};
+        const char* names[] = {"upload/4KiB", "upload/64KiB", "upload/1MiB", "upload/16MiB"};
+        for (size_t i = 0; i < 4; i++) {
+            VkDeviceSize size = sizes[i];
+            benchmarks.push_back({"upload", names[i], size, [size](uint64_t iterations){
+                static std::vector<uint8_t> source;
+                source.resize(size, 0x5A);
+                VkDevice device = Device::VulkanDevice::getLogicalDevice();
+                for (uint64_t i = 0; i < iterations; i++) {
+                    VkBuffer stagingBuffer, buffer;
+                    VkDeviceMemory stagingBufferMemory, bufferMemory;
+                    Mesh::SimpleMesh::createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+                    void* data;
+                    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+                    memcpy(data, source.data(), static_cast<size_t>(size));
+                    vkUnmapMemory(device, stagingBufferMemory);
+                    Mesh::SimpleMesh::createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+                    Mesh::SimpleMesh::copyBuffer(stagingBuffer, buffer, size);
+                    vkDestroyBuffer(device, stagingBuffer, nullptr);
+                    vkFreeMemory(device, stagingBufferMemory, nullptr);
+                    vkDestroyBuffer(device, buffer, nullptr);
+                    vkFreeMemory(device, bufferMemory, nullptr);
+                }
+            }});
+        }
+    }
+
+    void addRecordBenchmarks(std::vector<Benchmark>& benchmarks){
+        // 每次操作录制一个绘制及其push constant，命令缓冲区的开始和结束分摊到一批绘制上
+        benchmarks.push_back({"record", "record/draw", 0, [](uint64_t iterations){
+            const uint64_t DRAWS_PER_BUFFER = 1024;
+            VkDevice device = Device::VulkanDevice::getLogicalDevice();
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = DrawSpace::CommondFactory::getCommandPool();
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = PipelineData::RenderPassFactory::GetRenderPass();
+            renderPassInfo.framebuffer = PipelineData::RenderPassFactory::getSwapChainFramebuffers()[0];
+            renderPassInfo.renderArea.extent = Presentation::SwapChain::getSwapChainExtent();
+            VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearColor;
+
+            bool bindless = Descriptor::BindlessHeap::isEnabled();
+            Descriptor::BindlessPushConstants pushConstants{};
+            VkShaderStageFlags pushStages = Descriptor::BindlessHeap::getPushConstantRange().stageFlags;
+            VkPipelineLayout layout = PipelineData::Pipeline::getPipelineLayout();
+            uint32_t indexCount = static_cast<uint32_t>(Mesh::SimpleMesh::getIndices().size());
+
+            for (uint64_t done = 0; done < iterations;) {
+                uint64_t batch = std::min(DRAWS_PER_BUFFER, iterations - done);
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineData::Pipeline::getGraphicPipeline());
+                VkBuffer vertexBuffers[] = {Mesh::SimpleMesh::getVertexBuffer()};
+                VkDeviceSize offsets[] = {0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, Mesh::SimpleMesh::getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+                for (uint64_t draw = 0; draw < batch; draw++) {
+                    if (bindless) {
+                        pushConstants.firstInstance = static_cast<uint32_t>(draw);
+                        vkCmdPushConstants(commandBuffer, layout, pushStages, 0, sizeof(pushConstants), &pushConstants);
+                    }
+                    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+                }
+                vkCmdEndRenderPass(commandBuffer);
+                vkEndCommandBuffer(commandBuffer);
+                vkResetCommandBuffer(commandBuffer, 0);
+                done += batch;
+            }
+            vkFreeCommandBuffers(device, DrawSpace::CommondFactory::getCommandPool(), 1, &commandBuffer);
+        }});
+    }
+
+    void addDeviceBenchmarks(std::vector<Benchmark>& benchmarks){
+        benchmarks.push_back({"memory", "memory/findMemoryType", 0, [](uint64_t iterations){
+            volatile uint32_t sink = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                sink = Mesh::SimpleMesh::findMemoryType(0xFFFFFFFF, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            }
+            (void)sink;
+        }});
+
+        std::string vertexShaderPath = std::string(Config::shaderDirectory) + "vert.spv";
+        benchmarks.push_back({"shader", "shader/readFile", 0, [vertexShaderPath](uint64_t iterations){
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::vector<char> code = PipelineData::ShaderFactory::readFile(vertexShaderPath);
+                if (code.empty()) {
+                    throw std::runtime_error("failed to read shader file!");
+                }
+            }
+        }});
+        // 与shader/readFile对比，嵌入的字节码只有一次复制；关闭嵌入的构建中没有这一项
+        if (ShaderRegistry::EmbeddedShaders::find("vert") != nullptr) {
+            benchmarks.push_back({"shader", "shader/embeddedCode", 0, [](uint64_t iterations){
+                for (uint64_t i = 0; i < iterations; i++) {
+                    std::vector<char> code = ShaderRegistry::EmbeddedShaders::getCode("vert");
+                    if (code.empty()) {
+                        throw std::runtime_error("failed to copy embedded shader!");
+                    }
+                }
+            }});
+        }
+        benchmarks.push_back({"shader", "shader/createShaderModule", 0, [vertexShaderPath](uint64_t iterations){
+            static std::vector<char> code = PipelineData::ShaderFactory::readFile(vertexShaderPath);
+            VkDevice device = Device::VulkanDevice::getLogicalDevice();
+            for (uint64_t i = 0; i < iterations; i++) {
+                VkShaderModule module = PipelineData::ShaderFactory::createShaderModule(code);
+                vkDestroyShaderModule(device, module, nullptr);
+            }
+        }});
+    }
+
+    void addCpuBenchmarks(std::vector<Benchmark>& benchmarks){
+        const uint32_t CULL_OBJECTS = 100000;
+        struct KernelCase{ const char* name; Culling::FrustumCuller::Kernel kernel; };
+        const KernelCase kernels[] = {
+            {"culling/scalar-100k", Culling::FrustumCuller::Kernel::Scalar},
+            {"culling/sse-100k", Culling::FrustumCuller::Kernel::Sse},
+            {"culling/avx2-100k", Culling::FrustumCuller::Kernel::Avx2},
+        };
+        for (const auto& kernelCase : kernels) {
+            Culling::FrustumCuller::Kernel kernel = kernelCase.kernel;
+            benchmarks.push_back({"culling", kernelCase.name, 0, [kernel, CULL_OBJECTS](uint64_t iterations){
+                // 对象集合只在第一次运行时生成，固定种子保证每次运行相同
+                if (Culling::FrustumCuller::getObjectCount() != CULL_OBJECTS) {
+                    Culling::FrustumCuller::clear();
+                    std::mt19937 random(7);
+                    for (uint32_t i = 0; i < CULL_OBJECTS; i++) {
+                        float x = (random() % 4000) / 1000.0f - 2.0f;
+                        float y = (random() % 4000) / 1000.0f - 2.0f;
+                        float z = (random() % 2000) / 1000.0f - 0.5f;
+                        Culling::FrustumCuller::addBox(glm::vec3(x, y, z), glm::vec3(x + 0.05f, y + 0.05f, z + 0.05f));
+                    }
+                }
+                Culling::FrustumCuller::setKernel(kernel);
+                for (uint64_t i = 0; i < iterations; i++) {
+                    Culling::FrustumCuller::cull(1);
+                }
+                Culling::FrustumCuller::setKernel(Culling::FrustumCuller::Kernel::Auto);
+            }});
+        }
+
+        const uint32_t SCENE_NODES = 10000;
+        benchmarks.push_back({"scene", "scene/update-10k", 0, [SCENE_NODES](uint64_t iterations){
+            // 两层层级：每个根节点带9个子节点，每次操作修改所有根节点并更新一帧
+            static std::vector<uint32_t> roots;
+            if (roots.empty()) {
+                for (uint32_t i = 0; i < SCENE_NODES / 10; i++) {
+                    uint32_t root = Scene::SceneGraph::createNode(Scene::INVALID_NODE, true);
+                    roots.push_back(root);
+                    for (uint32_t child = 0; child < 9; child++) {
+                        Scene::SceneGraph::createNode(root, true);
+                    }
+                }
+            }
+            for (uint64_t i = 0; i < iterations; i++) {
+                glm::mat4 transform(1.0f);
+                transform[3] = glm::vec4(static_cast<float>(i % 100) * 0.01f, 0.0f, 0.0f, 1.0f);
+                for (uint32_t root : roots) {
+                    Scene::SceneGraph::setLocalTransform(root, transform);
+                }
+                Scene::SceneGraph::update(static_cast<uint32_t>(i % Config::MAX_FRAMES_IN_FLIGHT));
+            }
+        }});
+
+        // 单线程转换一帧4K BGRA，吞吐量按输入字节计算
+        const uint32_t VIDEO_WIDTH = 3840;
+        const uint32_t VIDEO_HEIGHT = 2160;
+        struct ConverterCase{ const char* name; Video::ColorConverter::Kernel kernel; };
+        const ConverterCase converters[] = {
+            {"video/i420-scalar-4k", Video::ColorConverter::Kernel::Scalar},
+            {"video/i420-sse2-4k", Video::ColorConverter::Kernel::Sse2},
+            {"video/i420-avx2-4k", Video::ColorConverter::Kernel::Avx2},
+        };
+        for (const auto& converterCase : converters) {
+            Video::ColorConverter::Kernel kernel = converterCase.kernel;
+            benchmarks.push_back({"video", converterCase.name, static_cast<uint64_t>(VIDEO_WIDTH) * VIDEO_HEIGHT * 4,
+                                  [kernel, VIDEO_WIDTH, VIDEO_HEIGHT](uint64_t iterations){
+                static std::vector<uint8_t> pixels;
+                static std::vector<uint8_t> planes;
+                if (pixels.empty()) {
+                    pixels.resize(static_cast<size_t>(VIDEO_WIDTH) * VIDEO_HEIGHT * 4);
+                    std::mt19937 random(11);
+                    for (auto& value : pixels) {
+                        value = static_cast<uint8_t>(random());
+                    }
+                    planes.resize(static_cast<size_t>(VIDEO_WIDTH) * VIDEO_HEIGHT * 3 / 2);
+                }
+                uint8_t* yPlane = planes.data();
+                uint8_t* uPlane = yPlane + VIDEO_WIDTH * VIDEO_HEIGHT;
+                uint8_t* vPlane = uPlane + VIDEO_WIDTH * VIDEO_HEIGHT / 4;
+                Video::ColorConverter::setKernel(kernel);
+                for (uint64_t i = 0; i < iterations; i++) {
+                    Video::ColorConverter::convertRows(pixels.data(), VIDEO_WIDTH * 4, VIDEO_WIDTH, false, 0, VIDEO_HEIGHT / 2,
+                                                       yPlane, uPlane, vPlane);
+                }
+                Video::ColorConverter::setKernel(Video::ColorConverter::Kernel::Auto);
+            }});
+        }
+
+        // 4K RGBA与带少量噪声的副本比较并输出掩码，吞吐量按两幅图的字节计算
+        struct DiffCase{ const char* name; ImageDiff::Comparator::Kernel kernel; };
+        const DiffCase diffs[] = {
+            {"imagediff/scalar-4k", ImageDiff::Comparator::Kernel::Scalar},
+            {"imagediff/avx2-4k", ImageDiff::Comparator::Kernel::Avx2},
+        };
+        for (const auto& diffCase : diffs) {
+            ImageDiff::Comparator::Kernel kernel = diffCase.kernel;
+            benchmarks.push_back({"imagediff", diffCase.name, static_cast<uint64_t>(VIDEO_WIDTH) * VIDEO_HEIGHT * 8,
+                                  [kernel, VIDEO_WIDTH, VIDEO_HEIGHT](uint64_t iterations){
+                static ImageDiff::Image reference;
+                static ImageDiff::Image actual;
+                static std::vector<uint8_t> mask;
+                if (reference.pixels.empty()) {
+                    reference.width = actual.width = VIDEO_WIDTH;
+                    reference.height = actual.height = VIDEO_HEIGHT;
+                    reference.pixels.resize(static_cast<size_t>(VIDEO_WIDTH) * VIDEO_HEIGHT * 4);
+                    std::mt19937 random(13);
+                    for (auto& value : reference.pixels) {
+                        value = static_cast<uint8_t>(random());
+                    }
+                    actual.pixels = reference.pixels;
+                    for (size_t i = 0; i < actual.pixels.size(); i += 97) {
+                        actual.pixels[i] = static_cast<uint8_t>(actual.pixels[i] + random() % 5);
+                    }
+                }
+                ImageDiff::Comparator::setKernel(kernel);
+                for (uint64_t i = 0; i < iterations; i++) {
+                    ImageDiff::Comparator::compare(reference, actual, 2, &mask);
+                }
+                ImageDiff::Comparator::setKernel(ImageDiff::Comparator::Kernel::Auto);
+            }});
+        }
+    }
+
+    // ---------- 输出与基线比较 ----------
+
+    void writeResults(FILE* file, const std::vector<Result>& results){
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(Device::VulkanDevice::getPhysicalDevice(), &properties);
+        std::string deviceName = properties.deviceName;
+        std::replace(deviceName.begin(), deviceName.end(), '"', '\'');
+
+        // 每个结果占一行，基线模式按行读取
+        fprintf(file, "{\n  \"device\": \"%s\",\n  \"benchmarks\": [\n", deviceName.c_str());
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            fprintf(file, "    {\"subsystem\": \"%s\", \"name\": \"%s\", \"iterations\": %llu, \"nsPerOp\": %.3f, \"bytesPerSecond\": %.0f}%s\n",
+                    result.subsystem.c_str(), result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+                    result.nsPerOperation, result.bytesPerSecond, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+
+    // 只解析本程序写出的格式：名字和耗时在同一行
+    std::map<std::string, double> readBaseline(const char* path){
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            throw std::runtime_error("failed to open baseline file!");
+        }
+        std::map<std::string, double> baseline;
+        char line[1024];
+        while (fgets(line, sizeof(line), file)) {
+            const char* name = strstr(line, "\"name\": \"");
+            const char* time = strstr(line, "\"nsPerOp\": ");
+            if (!name || !time) {
+                continue;
+            }
+            name += strlen("\"name\": \"");
+            const char* nameEnd = strchr(name, '"');
+            if (!nameEnd) {
+                continue;
+            }
+            baseline[std::string(name, nameEnd)] = std::strtod(time + strlen("\"nsPerOp\": "), nullptr);
+        }
+        fclose(file);
+        return baseline;
+    }
+
+    // 打印每个基准和每个子系统（几何平均）相对基线的变化，有回归时返回false
+    bool compareWithBaseline(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold){
+        bool passed = true;
+        std::map<std::string, std::pair<double, uint32_t>> subsystems;  // 对数比值之和, 个数
+        fprintf(stderr, "%-32s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+        for (const Result& result : results) {
+            auto found = baseline.find(result.name);
+            if (found == baseline.end() || found->second <= 0.0) {
+                fprintf(stderr, "%-32s %14s %14.1f %9s\n", result.name.c_str(), "-", result.nsPerOperation, "new");
+                continue;
+            }
+            double change = (result.nsPerOperation / found->second - 1.0) * 100.0;
+            bool regressed = change > threshold;
+            passed = passed && !regressed;
+            fprintf(stderr, "%-32s %14.1f %14.1f %+8.1f%%%s\n", result.name.c_str(), found->second, result.nsPerOperation,
+                    change, regressed ? "  REGRESSION" : "");
+            auto& subsystem = subsystems[result.subsystem];
+            subsystem.first += std::log(result.nsPerOperation / found->second);
+            subsystem.second++;
+        }
+        for (const auto& entry : subsystems) {
+            double change = (std::exp(entry.second.first / entry.second.second) - 1.0) * 100.0;
+            fprintf(stderr, "subsystem %-22s %+8.1f%%%s\n", entry.first.c_str(), change, change > threshold ? "  REGRESSION" : "");
+        }
+        return passed;
+    }
+}
+
+int main(int argc, char** argv){
+    MicroOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    bool passed = true;
+    try {
+        Bench::Runtime::DoInit(320, 240);
+
+        std::vector<Benchmark> benchmarks;
+        addUploadBenchmarks(benchmarks);
+        addRecordBenchmarks(benchmarks);
+        addDeviceBenchmarks(benchmarks);
+        addCpuBenchmarks(benchmarks);
+
+        std::vector<Result> results;
+        for (const Benchmark& benchmark : benchmarks) {
+            if (options.filter && benchmark.name.find(options.filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(measure(benchmark, options));
+            fprintf(stderr, "%-32s %12.1f ns/op\n", results.back().name.c_str(), results.back().nsPerOperation);
+        }
+
+        FILE* file = options.output ? fopen(options.output, "w") : stdout;
+        if (!file) {
+            throw std::runtime_error("failed to open benchmark output file!");
+        }
+        writeResults(file, results);
+        if (file != stdout) {
+            fclose(file);
+        }
+
+        if (options.baseline) {
+            passed = compareWithBaseline(results, readBaseline(options.baseline), options.threshold);
+        }
+
+        Culling::FrustumCuller::clear();
+        Bench::Runtime::cleanup();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
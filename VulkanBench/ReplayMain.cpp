@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Device.h"
+#include "Draw.h"
+#include "GpuProfiler.h"
+#include "Capture.h"
+#include "BenchRuntime.h"
+
+
+namespace{
+    struct ReplayOptions{
+        const char* capture = nullptr;
+        uint32_t loops = 1;          // 捕获的帧整体重放的次数
+        uint32_t warmupFrames = 10;  // 不计入统计
+        const char* output = nullptr;
+    };
+
+    void printUsage(){
+        std::cerr << "usage: VulkanReplay CAPTURE [--loops N] [--warmup N] [--output FILE]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char** argv, ReplayOptions& options){
+        for (int i = 1; i < argc; i++) {
+            const char* name = argv[i];
+            if (name[0] != '-') {
+                options.capture = name;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (strcmp(name, "--output") == 0) options.output = value;
+            else if (strcmp(name, "--loops") == 0) options.loops = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else if (strcmp(name, "--warmup") == 0) options.warmupFrames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            else return false;
+        }
+        return options.capture != nullptr && options.loops > 0;
+    }
+}
+
+int main(int argc, char** argv){
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    try {
+        Capture::Replayer::load(options.capture);
+        VkExtent2D extent = Capture::Replayer::getExtent();
+        Bench::Runtime::DoInit(extent.width, extent.height);
+
+        Capture::Replayer::createResources();
+        DrawSpace::CommondFactory::setSceneRecorder(Capture::Replayer::record);
+
+        // 预热帧也按捕获顺序播放，测量从第一帧重新开始，保证每次运行的输入完全相同
+        uint32_t captureFrames = Capture::Replayer::getFrameCount();
+        uint32_t warmupFrames = (options.warmupFrames + captureFrames - 1) / captureFrames * captureFrames;
+        uint32_t measuredFrames = captureFrames * options.loops;
+
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> frameTimes;
+        std::vector<double> gpuTimes;
+        uint64_t drawCount = 0;
+        uint64_t triangleCount = 0;
+        uint64_t lastGpuFrame = 0;
+        Clock::time_point measureStart = Clock::now();
+        for (uint32_t frame = 0; frame < warmupFrames + measuredFrames; frame++) {
+            if (frame == warmupFrames) {
+                measureStart = Clock::now();
+            }
+            Clock::time_point frameStart = Clock::now();
+            DrawSpace::CommondFactory::drawFrame();
+            if (frame < warmupFrames) {
+                continue;
+            }
+
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+            drawCount += Capture::Replayer::getLastDrawCount();
+            triangleCount += Capture::Replayer::getLastTriangleCount();
+            const auto& timings = Profiling::GpuProfiler::getFrameTimings();
+            uint64_t gpuFrame = Profiling::GpuProfiler::getTimingsFrameNumber();
+            if (!timings.empty() && gpuFrame != lastGpuFrame) {
+                gpuTimes.push_back(timings[0].milliseconds);
+                lastGpuFrame = gpuFrame;
+            }
+        }
+        vkDeviceWaitIdle(Device::VulkanDevice::getLogicalDevice());
+        double seconds = std::chrono::duration<double>(Clock::now() - measureStart).count();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(Device::VulkanDevice::getPhysicalDevice(), &properties);
+        std::string deviceName = properties.deviceName;
+        std::replace(deviceName.begin(), deviceName.end(), '"', '\'');
+        std::string captureName = options.capture;
+        std::replace(captureName.begin(), captureName.end(), '"', '\'');
+
+        FILE* file = options.output ? fopen(options.output, "w") : stdout;
+        if (!file) {
+            throw std::runtime_error("failed to open replay output file!");
+        }
+        fprintf(file, "{\n");
+        fprintf(file, "  \"device\": \"%s\",\n", deviceName.c_str());
+        fprintf(file, "  \"capture\": {\"file\": \"%s\", \"frames\": %u},\n", captureName.c_str(), captureFrames);
+        fprintf(file, "  \"extent\": {\"width\": %u, \"height\": %u},\n", extent.width, extent.height);
+        fprintf(file, "  \"frames\": %u,\n  \"warmupFrames\": %u,\n  \"seconds\": %.4f,\n", measuredFrames, warmupFrames, seconds);
+        fprintf(file, "  \"framesPerSecond\": %.2f,\n", measuredFrames / seconds);
+        fprintf(file, "  \"drawsPerFrame\": %.1f,\n", static_cast<double>(drawCount) / measuredFrames);
+        fprintf(file, "  \"trianglesPerSecond\": %.0f,\n", triangleCount / seconds);
+        Bench::writeSummary(file, "frameTimeMs", Bench::summarize(frameTimes), false);
+        Bench::writeSummary(file, "gpuFrameTimeMs", Bench::summarize(gpuTimes), true);
+        fprintf(file, "}\n");
+        if (file != stdout) {
+            fclose(file);
+        }
+
+        Capture::Replayer::cleanup();
+        Bench::Runtime::cleanup();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+#include "SyntheticScene.h"
+#include "Device.h"
+#include "MeshData.h"
+#include "PipelineData.h"
+#include "Descriptor.h"
+#include "Bindless.h"
+#include "Culling.h"
+#include "Scene.h"
+#include "PipelineStats.h"
+#include "Capture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+
+namespace Bench{
+    SceneParameters SyntheticScene::parameters;
+    std::vector<SyntheticScene::MeshRange> SyntheticScene::meshes;
+    std::vector<SyntheticScene::Instance> SyntheticScene::instances;
+    std::vector<PipelineData::PipelineState> SyntheticScene::pipelineStates;
+    VkBuffer SyntheticScene::vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory SyntheticScene::vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer SyntheticScene::indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory SyntheticScene::indexBufferMemory = VK_NULL_HANDLE;
+    uint32_t SyntheticScene::lastDrawCount = 0;
+    uint64_t SyntheticScene::lastTriangleCount = 0;
+
+    namespace{
+        const uint32_t MIN_SIDES = 3;
+        const uint32_t MAX_SIDES = 16;
+        const float PI = 3.14159265358979f;
+        // 实例节点在原点附近摆动的幅度
+        const float MOTION_RADIUS = 0.2f;
+
+        // std::mt19937的输出序列由标准规定，分布函数则不是，自己换算保证各平台结果一致
+        float uniform(std::mt19937& random, float low, float high){
+            return low + (high - low) * static_cast<float>(random() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        std::mt19937 makeRandom(uint32_t seed, uint32_t stream){
+            std::seed_seq sequence{seed, stream};
+            return std::mt19937(sequence);
+        }
+    }
+
+    void SyntheticScene::create(const SceneParameters& sceneParameters){
+        if (sceneParameters.meshCount == 0 || sceneParameters.instanceCount == 0 || sceneParameters.pipelineCount == 0) {
+            throw std::runtime_error("synthetic scene needs at least one mesh, instance and pipeline!");
+        }
+        parameters = sceneParameters;
+        createMeshes(parameters.meshCount);
+        createPipelines(parameters.pipelineCount);
+        createInstances(parameters.instanceCount);
+    }
+
+    void SyntheticScene::createMeshes(uint32_t meshCount){
+        // 每个网格是一个随机中心、半径和边数的正多边形，按扇形三角化
+        std::mt19937 random = makeRandom(parameters.seed, 0);
+        std::vector<Mesh::SimpleMesh::Vertex> vertices;
+        std::vector<uint16_t> indices;
+        meshes.resize(meshCount);
+        for (auto& mesh : meshes) {
+            uint32_t sides = MIN_SIDES + random() % (MAX_SIDES - MIN_SIDES + 1);
+            glm::vec2 center = {uniform(random, -0.8f, 0.8f), uniform(random, -0.8f, 0.8f)};
+            float radius = uniform(random, 0.02f, 0.08f);
+            glm::vec3 color(uniform(random, 0.2f, 1.0f), uniform(random, 0.2f, 1.0f), uniform(random, 0.2f, 1.0f));
+
+            mesh.firstIndex = static_cast<uint32_t>(indices.size());
+            mesh.indexCount = sides * 3;
+            mesh.vertexOffset = static_cast<int32_t>(vertices.size());
+            mesh.minCorner = {center.x - radius, center.y - radius};
+            mesh.maxCorner = {center.x + radius, center.y + radius};
+
+            vertices.push_back({center, color});
+            for (uint32_t side = 0; side < sides; side++) {
+                // 角度递增在y轴向下的屏幕坐标中是顺时针，与管线的正面朝向一致
+                float angle = 2.0f * PI * side / sides;
+                vertices.push_back({{center.x + radius * std::cos(angle), center.y + radius * std::sin(angle)}, color});
+                indices.push_back(0);
+                indices.push_back(static_cast<uint16_t>(1 + side));
+                indices.push_back(static_cast<uint16_t>(1 + (side + 1) % sides));
+            }
+        }
+
+        Mesh::SimpleMesh::uploadBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+        Mesh::SimpleMesh::uploadBuffer(indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+    }
+
+    void SyntheticScene::createPipelines(uint32_t pipelineCount){
+        // 状态依次组合混合、剔除、线框模式和正面朝向，超过16个之后状态重复，从缓存中得到同一个管线
+        pipelineStates.resize(pipelineCount);
+        for (uint32_t i = 0; i < pipelineCount; i++) {
+            pipelineStates[i].blendEnable = (i & 1) != 0;
+            pipelineStates[i].cullMode = (i & 2) != 0 ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+            pipelineStates[i].polygonMode = (i & 4) != 0 ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+            pipelineStates[i].frontFace = (i & 8) != 0 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+        }
+        // 在所有核心上后台创建，与生成网格和实例重叠；第一帧只等待它实际绑定的管线
+        PipelineData::PipelineStateCache::prewarmAsync(pipelineStates);
+    }
+
+    void SyntheticScene::createInstances(uint32_t instanceCount){
+        std::mt19937 random = makeRandom(parameters.seed, 1);
+        instances.resize(instanceCount);
+        for (auto& instance : instances) {
+            instance.mesh = random() % parameters.meshCount;
+            instance.pipeline = random() % parameters.pipelineCount;
+            instance.origin = {uniform(random, -0.3f, 0.3f), uniform(random, -0.3f, 0.3f)};
+            instance.phase = uniform(random, 0.0f, 2.0f * PI);
+            instance.node = Scene::SceneGraph::createNode(Scene::INVALID_NODE, true);
+            const MeshRange& mesh = meshes[instance.mesh];
+            instance.cullIndex = Culling::FrustumCuller::addBox(glm::vec3(mesh.minCorner.x, mesh.minCorner.y, 0.0f),
+                                                                glm::vec3(mesh.maxCorner.x, mesh.maxCorner.y, 0.0f));
+        }
+        std::sort(instances.begin(), instances.end(), [](const Instance& a, const Instance& b){
+            return a.pipeline != b.pipeline ? a.pipeline < b.pipeline : a.mesh < b.mesh;
+        });
+        update(0);
+    }
+
+    void SyntheticScene::update(uint64_t frameNumber){
+        if (!parameters.animate && frameNumber != 0) {
+            return;
+        }
+        float time = frameNumber / 60.0f;
+        for (const auto& instance : instances) {
+            glm::vec2 offset = {instance.origin.x + MOTION_RADIUS * std::cos(time + instance.phase),
+                                instance.origin.y + MOTION_RADIUS * std::sin(time + instance.phase)};
+            glm::mat4 transform(1.0f);
+            transform[3] = glm::vec4(offset.x, offset.y, 0.0f, 1.0f);
+            Scene::SceneGraph::setLocalTransform(instance.node, transform);
+        }
+    }
+
+    void SyntheticScene::record(VkCommandBuffer commandBuffer){
+        Capture::cmdBindVertexBuffer(commandBuffer, vertexBuffer, 0);
+        Capture::cmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+        bool bindless = Descriptor::BindlessHeap::isEnabled();
+        VkPipelineLayout layout = PipelineData::Pipeline::getPipelineLayout();
+        VkShaderStageFlags pushStages = Descriptor::BindlessHeap::getPushConstantRange().stageFlags;
+        Descriptor::BindlessPushConstants pushConstants{};
+        pushConstants.instanceBufferIndex = Scene::InstanceStream::getCurrentBufferIndex();
+        pushConstants.textureIndex = Descriptor::BindlessHeap::INVALID_INDEX;
+        pushConstants.samplerIndex = Descriptor::BindlessHeap::INVALID_INDEX;
+
+        uint32_t boundPipeline = UINT32_MAX;
+        uint32_t drawCount = 0;
+        uint64_t triangleCount = 0;
+        for (const auto& instance : instances) {
+            if (!Culling::FrustumCuller::isVisible(instance.cullIndex)) {
+                continue;
+            }
+            if (instance.pipeline != boundPipeline) {
+                Capture::cmdBindPipeline(commandBuffer, PipelineData::PipelineStateCache::get(pipelineStates[instance.pipeline]));
+                boundPipeline = instance.pipeline;
+            }
+            if (bindless) {
+                pushConstants.firstInstance = Scene::SceneGraph::getInstanceIndex(instance.node);
+                Capture::cmdPushConstants(commandBuffer, layout, pushStages, 0, sizeof(pushConstants), &pushConstants);
+            }
+            const MeshRange& mesh = meshes[instance.mesh];
+            Profiling::PipelineStatistics::beginDraw(commandBuffer);
+            Capture::cmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, 0);
+            Profiling::PipelineStatistics::endDraw(commandBuffer);
+            drawCount++;
+            triangleCount += mesh.indexCount / 3;
+        }
+        lastDrawCount = drawCount;
+        lastTriangleCount = triangleCount;
+    }
+
+    uint32_t SyntheticScene::getLastDrawCount(){
+        return lastDrawCount;
+    }
+
+    uint64_t SyntheticScene::getLastTriangleCount(){
+        return lastTriangleCount;
+    }
+
+    void SyntheticScene::cleanup(){
+        // 管线变体由PipelineData::PipelineStateCache统一销毁
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        vkDestroyBuffer(device, indexBuffer, nullptr);
+        vkFreeMemory(device, indexBufferMemory, nullptr);
+        vkDestroyBuffer(device, vertexBuffer, nullptr);
+        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        indexBuffer = VK_NULL_HANDLE;
+        vertexBuffer = VK_NULL_HANDLE;
+        meshes.clear();
+        instances.clear();
+        pipelineStates.clear();
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace PipelineData{
+    struct PipelineState;
+}
+
+namespace Bench{
+    // 相同的参数总是生成相同的场景
+    struct SceneParameters{
+        uint32_t meshCount = 64;
+        uint32_t instanceCount = 4096;
+        uint32_t pipelineCount = 4;
+        uint32_t seed = 1;
+        bool animate = true;  // 每帧移动所有实例的场景图节点，计入场景更新和实例数据上传的开销
+    };
+
+    // 程序生成的场景：N个随机多边形网格共用一对顶点/索引缓冲区，M个实例各引用一个网格和K个管线变体之一
+    class SyntheticScene{
+        SyntheticScene();
+        SyntheticScene(const SyntheticScene&)=delete;
+        SyntheticScene(const SyntheticScene&&)=delete;
+        SyntheticScene& operator=(const SyntheticScene&)=delete;
+
+        static void createMeshes(uint32_t meshCount);
+        static void createInstances(uint32_t instanceCount);
+        static void createPipelines(uint32_t pipelineCount);
+    public:
+        static void create(const SceneParameters& parameters);
+        // 按帧号计算实例节点的变换，与实际耗时无关，保证每次运行的工作量一致；
+        // 顶点着色器不读取实例变换，网格画在生成时的位置，剔除包围盒也保持在那里不动
+        static void update(uint64_t frameNumber);
+        // 作为DrawSpace::CommondFactory的场景录制函数，按管线和网格排序录制可见实例
+        static void record(VkCommandBuffer commandBuffer);
+
+        static uint32_t getLastDrawCount();
+        static uint64_t getLastTriangleCount();
+        static void cleanup();
+
+    private:
+        struct MeshRange{
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            glm::vec2 minCorner;
+            glm::vec2 maxCorner;
+        };
+
+        struct Instance{
+            uint32_t mesh;
+            uint32_t pipeline;
+            uint32_t node;       // 场景图节点句柄
+            uint32_t cullIndex;  // 剔除模块中的对象索引
+            glm::vec2 origin;
+            float phase;
+        };
+
+        static SceneParameters parameters;
+        static std::vector<MeshRange> meshes;
+        static std::vector<Instance> instances;  // 按管线、网格排序，录制时减少状态切换
+        static std::vector<PipelineData::PipelineState> pipelineStates;  // 录制时从管线缓存取出，热重载后自动换成新管线
+
+        static VkBuffer vertexBuffer;
+        static VkDeviceMemory vertexBufferMemory;
+        static VkBuffer indexBuffer;
+        static VkDeviceMemory indexBufferMemory;
+
+        static uint32_t lastDrawCount;
+        static uint64_t lastTriangleCount;
+    };
+}
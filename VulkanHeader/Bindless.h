@@ -0,0 +1,63 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <vector>
+
+namespace Descriptor{
+    // 着色器通过push constant中的32位索引访问bindless数组中的资源
+    struct BindlessPushConstants{
+        uint32_t instanceBufferIndex;  // 实例数据所在的存储缓冲区索引
+        uint32_t firstInstance;
+        uint32_t textureIndex;
+        uint32_t samplerIndex;
+    };
+
+    class BindlessHeap{
+        BindlessHeap();
+        BindlessHeap(const BindlessHeap&)=delete;
+        BindlessHeap(const BindlessHeap&&)=delete;
+        BindlessHeap& operator=(const BindlessHeap&)=delete;
+    public:
+        // 与着色器中的set = 0, binding = 0/1/2一一对应
+        enum Binding : uint32_t{
+            SampledImages = 0,
+            StorageBuffers = 1,
+            Samplers = 2
+        };
+        static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        static void createHeap();
+        static bool isEnabled();
+        static VkDescriptorSetLayout getLayout();
+        static VkPushConstantRange getPushConstantRange();
+        // 着色器在set 0声明的绑定必须是堆中已有的数组，类型相同，定长数组不能超过堆的大小
+        static bool matchesBinding(const VkDescriptorSetLayoutBinding& binding);
+
+        // 注册资源后返回其在对应数组中的索引，数组使用UPDATE_AFTER_BIND，注册时不需要等待GPU
+        static uint32_t registerSampledImage(VkImageView imageView, VkImageLayout imageLayout);
+        static uint32_t registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+        static uint32_t registerSampler(VkSampler sampler);
+        // 调用者需保证使用该索引的帧已经执行完毕
+        static void release(Binding binding, uint32_t index);
+
+        // 每个命令缓冲区只绑定一次整个数组集合
+        static void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+        static void cleanup();
+
+    private:
+        struct IndexAllocator{
+            uint32_t capacity = 0;
+            uint32_t next = 0;
+            std::vector<uint32_t> freeIndices;
+
+            uint32_t acquire();
+        };
+
+        static VkDescriptorPool pool;
+        static VkDescriptorSetLayout layout;
+        static VkDescriptorSet descriptorSet;
+        static IndexAllocator allocators[3];
+    };
+}
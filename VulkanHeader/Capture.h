@@ -0,0 +1,146 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace PipelineData{
+    struct PipelineState;
+}
+
+namespace Capture{
+    // 设置了Config::captureOutputPath时开始捕获，资源创建在初始化阶段就会被记录
+    void DoInit();
+    void cleanup();
+
+    // 文件头之后是一串[类型 u32][长度 u32][数据]的块，数值按主机字节序（小端）存放
+    constexpr uint32_t FILE_MAGIC = 0x50434B56;  // "VKCP"
+    constexpr uint32_t FILE_VERSION = 3;
+
+    enum class Chunk : uint32_t{
+        ShaderCode = 1,     // u32 顶点字节码长度，顶点字节码，片元字节码；之后的管线都使用这组着色器
+        Buffer,             // u32 缓冲区id，u32 usage，缓冲区内容
+        Pipeline,           // u32 管线id，u32 topology，u32 polygonMode，u32 cullMode，u32 frontFace，u32 blendEnable，
+                            // 顶点和片元阶段各一段{u32 常量数，{u32 constant_id，u32 值}[常量数]}
+        FrameBegin,         // u64 帧序号
+        InstanceData,       // u32 槽位总数，之后若干段{u32 起始槽位，u32 数量，mat4[数量]}，只包含与上一帧不同的槽位
+        BindPipeline,       // u32 管线id
+        BindVertexBuffer,   // u32 缓冲区id，u64 偏移
+        BindIndexBuffer,    // u32 缓冲区id，u64 偏移，u32 索引类型
+        PushConstants,      // u32 stageFlags，u32 偏移，数据
+        DrawIndexed,        // u32 indexCount，u32 instanceCount，u32 firstIndex，i32 vertexOffset，u32 firstInstance
+        FrameEnd
+    };
+
+    struct FileHeader{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;       // 捕获时的交换链大小，回放使用相同分辨率
+        uint32_t height;
+        uint32_t frameCount;  // 结束捕获时回写
+    };
+
+    // 把MeshData、PipelineData和Draw发出的资源创建与render pass内的命令写入紧凑的二进制文件
+    class Recorder{
+        Recorder();
+        Recorder(const Recorder&)=delete;
+        Recorder(const Recorder&&)=delete;
+        Recorder& operator=(const Recorder&)=delete;
+    public:
+        // 捕获初始化时创建的全部资源，以及之后的frameCount帧
+        static void begin(const char* path, uint32_t frameCount);
+        static void end();
+        static bool isActive();
+
+        static void recordShaderCode(const std::vector<char>& vertCode, const std::vector<char>& fragCode);
+        static void recordBuffer(VkBuffer buffer, VkBufferUsageFlags usage, const void* data, VkDeviceSize size);
+        static void recordPipeline(VkPipeline pipeline, const PipelineData::PipelineState& state);
+
+        // 在录制命令缓冲区的开头和结尾调用，instanceData是该帧实例数据段
+        static void beginFrame(VkExtent2D extent, const glm::mat4* instanceData, uint32_t slotCount);
+        static void endFrame();
+
+        // 以下命令只在帧内写入文件，句柄换成创建时分配的id
+        static void writeBindPipeline(VkPipeline pipeline);
+        static void writeBindVertexBuffer(VkBuffer buffer, VkDeviceSize offset);
+        static void writeBindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+        static void writePushConstants(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values);
+        static void writeDrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+    private:
+        static void writeChunk(Chunk type);  // 写出payload中的数据
+        static bool isRecordingFrame();
+
+        static FILE* file;
+        static FileHeader header;
+        static uint32_t remainingFrames;
+        static bool inFrame;
+        static uint64_t frameNumber;
+        static uint32_t nextResourceId;
+        static std::unordered_map<VkBuffer, uint32_t> bufferIds;
+        static std::unordered_map<VkPipeline, uint32_t> pipelineIds;
+        static std::vector<char> lastVertCode;
+        static std::vector<char> lastFragCode;
+        static std::vector<glm::mat4> lastInstances;  // 上一帧写入的实例数据，用于只记录变化的槽位
+        static std::vector<uint8_t> payload;           // 复用的块数据缓冲
+    };
+
+    // 录制命令的同时写入捕获文件，未捕获时与直接调用vkCmd*相同
+    void cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline);
+    void cmdBindVertexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset);
+    void cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+    void cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                          uint32_t offset, uint32_t size, const void* values);
+    void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+                        uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+
+    // 读取捕获文件，重建资源后逐帧重放命令，不需要原程序的场景逻辑
+    class Replayer{
+        Replayer();
+        Replayer(const Replayer&)=delete;
+        Replayer(const Replayer&&)=delete;
+        Replayer& operator=(const Replayer&)=delete;
+    public:
+        static void load(const char* path);
+        static VkExtent2D getExtent();
+        static uint32_t getFrameCount();
+
+        // 引擎初始化之后调用，按捕获顺序上传文件中所有的缓冲区并创建管线
+        static void createResources();
+        // 作为场景录制函数使用，每次调用重放下一帧，播放到最后一帧后从头开始
+        static void record(VkCommandBuffer commandBuffer);
+        static uint32_t getLastDrawCount();
+        static uint64_t getLastTriangleCount();
+        static void cleanup();
+
+    private:
+        struct ChunkView{
+            Chunk type;
+            const uint8_t* data;
+            uint32_t size;
+        };
+        struct FrameRange{
+            size_t firstChunk;
+            size_t lastChunk;  // 不包含
+        };
+
+        static std::vector<uint8_t> fileData;
+        static FileHeader header;
+        static std::vector<ChunkView> chunks;
+        static std::vector<FrameRange> frames;
+        static uint32_t nextFrame;
+        static std::unordered_map<uint32_t, VkBuffer> buffers;
+        static std::vector<VkDeviceMemory> bufferMemories;
+        // 捕获中途热重载时旧的管线会被销毁，按状态保存，录制时从PipelineStateCache取当前一代的管线
+        static std::unordered_map<uint32_t, PipelineData::PipelineState> pipelineStates;
+        static std::vector<glm::mat4> instances;
+        static uint32_t lastDrawCount;
+        static uint64_t lastTriangleCount;
+    };
+}
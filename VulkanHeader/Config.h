@@ -18,6 +18,52 @@ namespace Config{
     
     extern const int MAX_FRAMES_IN_FLIGHT;
 
+    // 低延迟模式：推迟输入采样和命令录制，直到GPU即将可以处理该帧
+    extern bool enableLowLatencyMode;
+
+    // 呈现策略的目标，决定呈现模式和交换链图像数量
+    enum class PresentGoal{
+        LowLatency,     // 输入到显示的延迟最低
+        PowerSaving,    // 跟随垂直同步，尽量少渲染
+        MaxThroughput   // 帧率最高，允许撕裂
+    };
+    extern PresentGoal presentGoal;
+
+    // 无窗口模式：使用VK_EXT_headless_surface，渲染固定帧数后退出
+    extern bool headless;
+    extern uint32_t headlessFrameCount;
+    extern VkExtent2D headlessExtent;  // 无窗口时surface没有固定大小，使用该分辨率
+
+    // 着色器字节码所在目录，以'/'结尾
+    extern const char* shaderDirectory;
+    // 优先使用构建时嵌入的着色器，不读取着色器目录；设置了VULKAN_SHADER_DIR时默认关闭
+    extern bool useEmbeddedShaders;
+    // GLSL编译结果的缓存目录，不存在时自动创建
+    extern const char* shaderCacheDirectory;
+    // 有窗口时监视着色器目录，字节码更新后重建默认管线
+    extern bool enableShaderHotReload;
+
+    // 每次绘制包一对管线统计和遮挡查询，退出时打印瓶颈分析；基准测试默认关闭，避免查询影响帧时间
+    extern bool enablePipelineStatistics;
+
+    // VULKAN_ENABLE_TRACING构建下CPU插桩结果的导出路径
+    extern const char* traceOutputPath;
+
+    // 命令流捕获文件的路径，为空时不捕获；捕获初始化的资源和之后的captureFrameCount帧
+    extern const char* captureOutputPath;
+    extern uint32_t captureFrameCount;
+
+    // 回读的帧写入的视频文件，以.y4m结尾时写Y4M，否则写裸I420；为空时不输出
+    extern const char* videoOutputPath;
+    extern uint32_t videoFrameRate;  // 写入Y4M文件头的帧率
+
+    // 回读的第screenshotFrame帧（从0开始）保存为PPM截图，为空时不截图
+    extern const char* screenshotPath;
+    extern uint32_t screenshotFrame;
+
+    // 从环境变量读取上面的运行时配置，需在创建窗口前调用
+    void loadEnvironmentOverrides();
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
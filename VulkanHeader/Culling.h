@@ -0,0 +1,65 @@
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace Culling{
+    // 平面方程ax+by+cz+d=0，法线指向视锥体内部
+    struct Frustum{
+        glm::vec4 planes[6];
+
+        // 从观察投影矩阵中提取六个平面，深度范围按vulkan的[0,1]处理
+        static Frustum fromMatrix(const glm::mat4& viewProjection);
+    };
+
+    class FrustumCuller{
+        FrustumCuller();
+        FrustumCuller(const FrustumCuller&)=delete;
+        FrustumCuller(const FrustumCuller&&)=delete;
+        FrustumCuller& operator=(const FrustumCuller&)=delete;
+
+        static void cullRange(const Frustum& frustum, uint32_t begin, uint32_t end, uint32_t* visible, uint32_t& visibleCount);
+    public:
+        // 一次处理的对象个数，SoA数组按该值补齐
+        static const uint32_t BLOCK_SIZE = 8;
+
+        // 默认按CPU支持情况自动选择，基准测试时可以强制指定某个实现
+        enum class Kernel{
+            Auto,
+            Scalar,
+            Sse,
+            Avx2
+        };
+        static void setKernel(Kernel kernel);
+
+        // 包围球和AABB都存为中心+半长+半径，测试时取两者中更紧的一个
+        static uint32_t addSphere(glm::vec3 center, float radius);
+        static uint32_t addBox(glm::vec3 minCorner, glm::vec3 maxCorner);
+        static void updateSphere(uint32_t index, glm::vec3 center, float radius);
+        static void updateBox(uint32_t index, glm::vec3 minCorner, glm::vec3 maxCorner);
+        static uint32_t getObjectCount();
+        static void clear();
+
+        static void setViewProjection(const glm::mat4& viewProjection);
+        // 对所有对象做视锥剔除，结果为按对象索引升序排列的紧凑可见列表
+        // 剔除被切成threadCount个任务交给任务系统执行，为0时按对象数量自动决定，对象较少时只在当前线程执行
+        static const std::vector<uint32_t>& cull(uint32_t threadCount = 0);
+        static const std::vector<uint32_t>& getVisible();
+        static bool isVisible(uint32_t index);
+
+    private:
+        // 结构体数组（SoA）布局，每个分量连续存放，便于一次加载8个对象
+        static std::vector<float> centerX;
+        static std::vector<float> centerY;
+        static std::vector<float> centerZ;
+        static std::vector<float> extentX;
+        static std::vector<float> extentY;
+        static std::vector<float> extentZ;
+        static std::vector<float> radius;
+        static uint32_t objectCount;
+
+        static Frustum frustum;
+        static std::vector<uint32_t> visibleObjects;
+        static std::vector<uint32_t> scratch;
+    };
+}
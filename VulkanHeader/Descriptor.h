@@ -0,0 +1,81 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <mutex>
+
+namespace Descriptor{
+    void DoInit();
+    void cleanup();
+
+    // 描述一个绑定点上写入的资源，用于更新描述符集
+    struct DescriptorBinding{
+        uint32_t binding;
+        uint32_t arrayElement;
+        VkDescriptorType type;
+        VkDescriptorBufferInfo bufferInfo;
+        VkDescriptorImageInfo imageInfo;
+    };
+
+    // 把绑定列表写入描述符集，可以在任意线程调用，不同线程不能同时写入同一个描述符集
+    void writeDescriptorSet(VkDescriptorSet descriptorSet, const std::vector<DescriptorBinding>& bindings);
+
+    class LayoutCache{
+        LayoutCache();
+        LayoutCache(const LayoutCache&)=delete;
+        LayoutCache(const LayoutCache&&)=delete;
+        LayoutCache& operator=(const LayoutCache&)=delete;
+    public:
+        // 相同绑定列表（与顺序无关）的布局只创建一次，之后直接返回缓存的句柄，可以在任意线程调用
+        // bindingFlags非空时与bindings一一对应，用于描述符索引的UPDATE_AFTER_BIND等标志
+        static VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0,
+                                               const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
+        static void cleanup();
+
+    private:
+        struct LayoutKey{
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            std::vector<VkDescriptorBindingFlags> bindingFlags;
+            VkDescriptorSetLayoutCreateFlags flags;
+
+            bool operator==(const LayoutKey& other) const;
+        };
+        struct LayoutKeyHash{
+            size_t operator()(const LayoutKey& key) const;
+        };
+
+        static std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+        static std::mutex cacheLock;
+    };
+
+    // 由着色器反射得到的管线布局在所有相同接口的管线之间共用
+    class PipelineLayoutCache{
+        PipelineLayoutCache();
+        PipelineLayoutCache(const PipelineLayoutCache&)=delete;
+        PipelineLayoutCache(const PipelineLayoutCache&&)=delete;
+        PipelineLayoutCache& operator=(const PipelineLayoutCache&)=delete;
+    public:
+        // 相同的集合布局列表和push constant范围只创建一次，可以在任意线程调用
+        static VkPipelineLayout getLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                          const std::vector<VkPushConstantRange>& pushConstantRanges);
+        static void cleanup();
+
+    private:
+        struct LayoutKey{
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            std::vector<VkPushConstantRange> pushConstantRanges;
+
+            bool operator==(const LayoutKey& other) const;
+        };
+        struct LayoutKeyHash{
+            size_t operator()(const LayoutKey& key) const;
+        };
+
+        static std::unordered_map<LayoutKey, VkPipelineLayout, LayoutKeyHash> layouts;
+        static std::mutex cacheLock;
+    };
+}
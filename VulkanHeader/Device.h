@@ -25,6 +25,7 @@ namespace Device{
 
         static bool isDeviceSuitable(VkPhysicalDevice device);
         static bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        static bool isExtensionSupported(VkPhysicalDevice device, const char* extensionName);
     public:
         static void CreateSurface();
         static void pickPhysicalDevice();
@@ -36,6 +37,7 @@ namespace Device{
         static VkPhysicalDevice& getPhysicalDevice();
         static VkQueue getGraphicsQueue();
         static VkQueue getPresentQueue();
+        static bool isBindlessSupported();
         static void cleanup();
 
     private:
@@ -45,5 +47,6 @@ namespace Device{
         static VkPhysicalDevice physicalDevice;  // 逻辑设备,主机上支持的vk设备版本
         static VkDevice device; // 逻辑设备,用来实例化一个物理设备实例
         static VkSurfaceKHR surface;
+        static bool bindlessSupported; // 是否启用了描述符索引（bindless）所需的特性
     };
 }
\ No newline at end of file
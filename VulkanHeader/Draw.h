@@ -3,17 +3,21 @@
 #include <vulkan/vulkan.h>
 #endif
 
+#include <functional>
 #include <vector>
 
 
 namespace DrawSpace{
     class CommondFactory{
         static void createSyncObjects();
+        static void recordDefaultScene(VkCommandBuffer commandBuffer);
     public:
         static void createCommandPool();
         static void createCommandBuffers();
         static void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
         static void drawFrame();
+        // 替换默认网格的绘制，在render pass内、视口和bindless描述符集设置之后调用
+        static void setSceneRecorder(std::function<void(VkCommandBuffer)> recorder);
         static void cleanup();
         static void DoInit();
 
@@ -24,6 +28,7 @@ namespace DrawSpace{
         static std::vector<VkCommandBuffer> commandBuffers;
         static std::vector<VkSemaphore> imageAvailableSemaphores;
         static std::vector<VkSemaphore> renderFinishedSemaphores;
-        static std::vector<VkFence> inFlightFences;
+        static std::vector<uint64_t> frameTimelineValues;  // 每帧最后一次提交在图形队列时间线上的值
+        static std::function<void(VkCommandBuffer)> sceneRecorder;
     };
 }
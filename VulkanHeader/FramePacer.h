@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Pacing{
+    struct Percentiles{
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+    };
+
+    // 固定长度的环形样本窗口，单位为毫秒
+    class RollingWindow{
+    public:
+        explicit RollingWindow(uint32_t capacity = 240);
+        void add(double sample);
+        void resize(uint32_t capacity);
+        uint32_t size() const;
+        Percentiles compute() const;
+
+    private:
+        std::vector<double> samples;
+        uint32_t next;
+        uint32_t count;
+    };
+
+    class FramePacer{
+        FramePacer();
+        FramePacer(const FramePacer&)=delete;
+        FramePacer(const FramePacer&&)=delete;
+        FramePacer& operator=(const FramePacer&)=delete;
+
+        using Clock = std::chrono::steady_clock;
+    public:
+        enum class Metric{
+            CpuTime,          // 从开始处理输入到提交呈现的CPU耗时
+            FenceWait,        // 等待帧资源可用的时间
+            PresentInterval,  // 相邻两次呈现之间的间隔
+            ModeledLatency,   // 每帧的CPU耗时加上(排队帧数+1)乘以同一帧的呈现间隔，是模型估算而不是测量值
+            Count
+        };
+
+        // 帧循环的各个阶段依次调用
+        static void beginFenceWait();
+        static void endFenceWait();
+        // 低延迟模式下先睡眠到预计GPU即将空闲的时刻，再采样输入，之后立即录制
+        static void waitForLatencyTarget();
+        static void endFrame();
+
+        // 当前帧使用的资源槽位，范围[0, MAX_FRAMES_IN_FLIGHT)
+        static uint32_t getFrameIndex();
+        static uint64_t getFrameNumber();
+
+        static void setLatencyMode(bool enabled);
+        static bool isLatencyModeEnabled();
+        static void setInputSampler(std::function<void()> sampler);
+        // 呈现队列中排在新帧前面的帧数，由呈现策略在创建交换链时设置
+        static void setQueuedFrames(uint32_t frames);
+        static void setWindowSize(uint32_t frameCount);
+        static Percentiles getPercentiles(Metric metric);
+
+    private:
+        static uint32_t frameIndex;
+        static uint64_t frameNumber;
+        static bool latencyMode;
+        static uint32_t queuedFrames;
+        static std::function<void()> inputSampler;
+        static RollingWindow windows[static_cast<int>(Metric::Count)];
+        static Clock::time_point fenceWaitStart;
+        static Clock::time_point workStart;
+        static Clock::time_point lastPresent;
+    };
+}
@@ -0,0 +1,79 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <string>
+#include <vector>
+
+namespace Profiling{
+    void DoInit();
+    void cleanup();
+
+    // 一个计时区间的结果，子区间按录制顺序排列
+    struct ScopeTiming{
+        std::string name;
+        double milliseconds = 0.0;
+        std::vector<ScopeTiming> children;
+    };
+
+    // 每个在途帧一个时间戳查询池；帧的时间线值完成后才回读，回读不会等待GPU
+    class GpuProfiler{
+        GpuProfiler();
+        GpuProfiler(const GpuProfiler&)=delete;
+        GpuProfiler(const GpuProfiler&&)=delete;
+        GpuProfiler& operator=(const GpuProfiler&)=delete;
+
+        static void readBack(uint32_t frameIndex);
+    public:
+        static void createQueryPools();
+        static bool isEnabled();
+
+        // 在命令缓冲区开头、任何区间之前调用：取回该槽位上一次的结果并重置查询池
+        static void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        // name需要在整个帧期间有效，通常为字符串字面量；区间可以嵌套
+        static void beginScope(VkCommandBuffer commandBuffer, const char* name);
+        static void endScope(VkCommandBuffer commandBuffer);
+
+        // 最近一次回读的帧的计时树，以及该帧的帧号
+        static const std::vector<ScopeTiming>& getFrameTimings();
+        static uint64_t getTimingsFrameNumber();
+        static void cleanup();
+
+    private:
+        struct ScopeRecord{
+            const char* name;
+            uint32_t beginQuery;
+            uint32_t endQuery;
+            uint32_t parent;
+        };
+
+        struct FrameQueries{
+            VkQueryPool pool = VK_NULL_HANDLE;
+            std::vector<ScopeRecord> scopes;
+            uint32_t queryCount = 0;
+            uint64_t frameNumber = 0;
+        };
+
+        static std::vector<FrameQueries> frames;
+        static uint32_t currentFrame;
+        static std::vector<uint32_t> scopeStack;
+        static double timestampPeriod;  // 每个时间戳单位对应的纳秒数
+        static uint64_t timestampMask;
+        static std::vector<uint64_t> results;
+        static std::vector<ScopeTiming> frameTimings;
+        static uint64_t timingsFrameNumber;
+    };
+
+    // 作用域结束时自动关闭计时区间
+    class GpuScope{
+    public:
+        GpuScope(VkCommandBuffer commandBuffer, const char* name);
+        ~GpuScope();
+        GpuScope(const GpuScope&)=delete;
+        GpuScope& operator=(const GpuScope&)=delete;
+
+    private:
+        VkCommandBuffer commandBuffer;
+    };
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ImageDiff{
+    // 8位RGBA图像，按行紧密排列
+    struct Image{
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    // 读取二进制PPM（P6，最大值255），alpha补为255
+    Image readPpm(const std::string& path);
+    // 写二进制PPM，丢弃alpha
+    void writePpm(const std::string& path, const Image& image);
+    // 写二进制PGM（P5），用于输出不匹配掩码
+    void writePgm(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& gray);
+    // 从回读的BGRA或RGBA像素构造图像，rowPitch为源数据每行字节数
+    Image fromPixels(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba);
+
+    struct DiffResult{
+        uint64_t pixelCount = 0;
+        uint64_t mismatchCount = 0;        // 任一通道差值超过容差的像素数
+        uint32_t maxError = 0;             // 所有通道中最大的绝对差
+        uint32_t channelMaxError[4] = {};  // 按R、G、B、A分别统计的最大绝对差
+        double meanAbsoluteError = 0.0;    // 所有通道绝对差的平均值
+        double psnr = 0.0;                 // 按全部通道的均方误差计算，两幅图完全相同时为无穷大
+    };
+
+    // 逐通道比较两幅图，统计量一次遍历得到
+    class Comparator{
+        Comparator();
+        Comparator(const Comparator&)=delete;
+        Comparator(const Comparator&&)=delete;
+        Comparator& operator=(const Comparator&)=delete;
+    public:
+        // 默认按CPU支持情况自动选择，基准测试时可以强制指定某个实现
+        enum class Kernel{
+            Auto,
+            Scalar,
+            Avx2
+        };
+        static void setKernel(Kernel kernel);
+
+        // 两幅图尺寸必须相同；mask不为空时写入每个像素一个字节，不匹配为255，否则为0
+        static DiffResult compare(const Image& reference, const Image& actual, uint8_t tolerance,
+                                  std::vector<uint8_t>* mask = nullptr);
+    };
+}
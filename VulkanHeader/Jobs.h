@@ -0,0 +1,102 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Jobs{
+    void DoInit();
+    void cleanup();
+
+    struct Job;
+    using JobFunction = std::function<void()>;
+    // parallelFor的回调，处理[begin, end)区间
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // 计数器记录还未完成的任务数，归零时把依赖它的任务放入队列；
+    // 任务抛出的第一个异常保存在计数器上，等计数器归零后由wait重新抛出
+    class Counter{
+        friend class JobSystem;
+    public:
+        Counter();
+        Counter(const Counter&)=delete;
+        Counter& operator=(const Counter&)=delete;
+        bool isDone() const;
+
+    private:
+        void increment();
+        void decrement();
+        bool addContinuation(Job* job);
+        void setException(std::exception_ptr thrown);
+
+        std::atomic<uint32_t> value;
+        mutable std::mutex continuationLock;
+        std::vector<Job*> continuations;
+        mutable std::exception_ptr exception;  // 由continuationLock保护，wait取出后清空
+    };
+
+    // Chase-Lev双端队列：所属线程在底部压入和弹出，其它线程从顶部窃取
+    class WorkStealingDeque{
+    public:
+        explicit WorkStealingDeque(uint32_t capacity);
+        WorkStealingDeque(const WorkStealingDeque&)=delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&)=delete;
+
+        bool push(Job* job);    // 只能由所属线程调用，队列满时返回false
+        Job* pop();             // 只能由所属线程调用
+        Job* steal();           // 任意线程调用
+
+    private:
+        std::vector<std::atomic<Job*>> buffer;
+        int64_t mask;
+        alignas(64) std::atomic<int64_t> top;
+        alignas(64) std::atomic<int64_t> bottom;
+    };
+
+    class JobSystem{
+        JobSystem();
+        JobSystem(const JobSystem&)=delete;
+        JobSystem(const JobSystem&&)=delete;
+        JobSystem& operator=(const JobSystem&)=delete;
+
+        static void workerLoop(uint32_t workerIndex);
+        static void schedule(Job* job);
+        static Job* findJob();
+        static void execute(Job* job);
+        static void pinCurrentThread(uint32_t core);
+        friend class Counter;
+    public:
+        static constexpr uint32_t INVALID_WORKER = 0xFFFFFFFF;
+
+        // 必须在主线程调用，主线程作为0号工作线程参与执行；threadCount为0时每个核心一个线程
+        static void start(uint32_t threadCount = 0, bool pinThreads = false);
+        static void stop();
+        static bool isRunning();
+        static uint32_t getWorkerCount();
+        static uint32_t getWorkerIndex();
+
+        // counter在任务完成后减一；dependency不为空时，等它归零后任务才会被执行
+        static void run(JobFunction function, Counter* counter = nullptr, Counter* dependency = nullptr);
+        // 等待期间当前线程继续执行队列中的任务，不会阻塞工作线程；
+        // 计数器归零后重新抛出任务中的第一个异常，同一个异常只会抛给一个等待者
+        static void wait(const Counter& counter);
+        // 把[0, count)按grainSize切块分发，返回时所有块都已执行完毕，某一块抛出的异常在此之后抛出；
+        // 未启动时直接在当前线程执行
+        static void parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function);
+
+    private:
+        static std::vector<std::thread> threads;
+        static std::vector<WorkStealingDeque*> deques;
+        static std::mutex globalLock;
+        static std::vector<Job*> globalQueue;  // 非工作线程提交的任务
+        static std::mutex sleepLock;
+        static std::condition_variable wakeCondition;
+        static std::atomic<uint32_t> queuedJobs;
+        static std::atomic<uint32_t> sleepingWorkers;
+        static std::atomic<bool> running;
+        static std::atomic<bool> stopping;
+    };
+}
@@ -45,8 +45,12 @@ namespace Mesh{
         };
         static void createVertexBuffer();
         static void createIndexBuffer();
+        static void registerCullBounds();
+        static void createSceneNode();
         static void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
         static void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+        // 经暂存缓冲区把数据上传到仅GPU可访问的缓冲区，usage不需要包含TRANSFER_DST
+        static void uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
         static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
         static void cleanup();
@@ -59,6 +63,12 @@ namespace Mesh{
         static const std::vector<uint16_t>& getIndices(){
             return indices;
         }
+        static uint32_t getCullIndex(){
+            return cullIndex;
+        }
+        static uint32_t getSceneNode(){
+            return sceneNode;
+        }
 
     private:
         static const std::vector<Vertex> vertices;
@@ -68,5 +78,7 @@ namespace Mesh{
         static VkDeviceMemory vertexBufferMemory;
         static VkBuffer indexBuffer;
         static VkDeviceMemory indexBufferMemory;
+        static uint32_t cullIndex; // 网格包围盒在剔除模块中的对象索引
+        static uint32_t sceneNode; // 网格在场景图中的节点句柄
     };
 }
\ No newline at end of file
@@ -5,9 +5,14 @@
 
 #include <vector>
 #include <string>
-#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
+namespace Jobs{
+    class Counter;
+}
 
 namespace PipelineData{
     void DoInit();
@@ -15,8 +20,11 @@ namespace PipelineData{
 
     class ShaderFactory{
     public:
-        static std::unique_ptr<VkPipelineShaderStageCreateInfo[]> getDefaultShaderInfo();
-        static std::function<void()> destroyShader;
+        // 默认着色器的字节码：Config::useEmbeddedShaders且构建时嵌入了vert/frag时直接从只读数据复制，
+        // 否则从着色器目录加载；不修改静态状态，可以在其它线程调用
+        static void loadDefaultShaderCode(std::vector<char>& vertCode, std::vector<char>& fragCode);
+        // 有shaderc且着色器目录下有shader.vert/shader.frag时经缓存编译GLSL，否则读取预编译的vert.spv/frag.spv
+        static void loadShaderCodeFromDirectory(std::vector<char>& vertCode, std::vector<char>& fragCode);
         static std::vector<char> readFile(std::string);
         static VkShaderModule createShaderModule(const std::vector<char>& code);
     };
@@ -34,13 +42,114 @@ namespace PipelineData{
         static VkRenderPass renderPass;
     };
 
+    // 着色器中layout(constant_id = id)声明的常量，bool、int、uint和float都占32位
+    struct SpecializationConstant{
+        uint32_t id;
+        uint32_t value;
+    };
+
+    // 管线之间可以变化的固定功能状态和特化常量，布局、render pass和着色器模块所有管线共用；
+    // 可以比较和哈希，作为PipelineStateCache的键
+    struct PipelineState{
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+        bool blendEnable = false;
+        // 按id排序；同一个SPIR-V模块换一组常量就是一个新的变体，驱动按常量值消除死代码。
+        // 着色器中没有声明的id不影响管线，没有设置的常量使用着色器中的默认值
+        std::vector<SpecializationConstant> vertexConstants;
+        std::vector<SpecializationConstant> fragmentConstants;
+
+        // 设置顶点或片元阶段的常量，已有同一个id时覆盖；其它阶段抛出异常
+        PipelineState& specialize(VkShaderStageFlagBits stage, uint32_t id, uint32_t value);
+        PipelineState& specialize(VkShaderStageFlagBits stage, uint32_t id, int32_t value);
+        PipelineState& specialize(VkShaderStageFlagBits stage, uint32_t id, float value);
+        PipelineState& specialize(VkShaderStageFlagBits stage, uint32_t id, bool value);
+
+        bool operator==(const PipelineState& other) const;
+        bool operator!=(const PipelineState& other) const;
+    };
+
+    struct PipelineStateHash{
+        size_t operator()(const PipelineState& state) const;
+    };
+
+    // 一对着色器模块，以及从它们的SPIR-V反射出的顶点输入和管线布局
+    struct ShaderProgram{
+        VkShaderModule vertModule = VK_NULL_HANDLE;
+        VkShaderModule fragModule = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;  // 由Descriptor::PipelineLayoutCache持有，接口相同的着色器共用
+        VkVertexInputBindingDescription vertexBinding{};
+        std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    };
+
     class Pipeline{
     public:
+        // 创建管线缓存，并在后台开始创建默认状态的管线
         static void createGraphicsPipeline();
+        // 按状态依次创建管线，只读取着色器程序、管线缓存和render pass，可以在任意线程调用；失败时抛出异常
+        static void createPipelines(const ShaderProgram& program, const std::vector<PipelineState>& states, VkPipeline* pipelines);
+        // 从PipelineStateCache取出每个状态的管线，相同的状态得到同一个管线
+        static std::vector<VkPipeline> createVariants(const std::vector<PipelineState>& states);
         static void cleanup();
+        // 默认状态的管线
         static VkPipeline getGraphicPipeline();
+        // 当前着色器的管线布局，热重载后可能变化
+        static VkPipelineLayout getPipelineLayout();
+    private:
+        static VkPipelineCache pipelineCache;  // 所有线程共用，由驱动保证线程安全
+    };
+
+    // 一组着色器模块和用它们创建的管线，着色器变化时整体替换
+    struct PipelineGeneration{
+        std::vector<char> vertCode;
+        std::vector<char> fragCode;
+        ShaderProgram program;
+        std::unordered_map<PipelineState, VkPipeline, PipelineStateHash> pipelines;
+    };
+
+    // 状态到管线的并发缓存：某个状态第一次被请求时才创建管线，之后一直复用，直到cleanup或换代
+    class PipelineStateCache{
+        PipelineStateCache();
+        PipelineStateCache(const PipelineStateCache&)=delete;
+        PipelineStateCache(const PipelineStateCache&&)=delete;
+        PipelineStateCache& operator=(const PipelineStateCache&)=delete;
+
+        // 调用时不能持有任何锁：加载字节码时可能编译GLSL，等待期间会执行其它任务
+        static void ensureShaderModules();
+        // 状态不存在时用当前一代的着色器创建并加入缓存，返回缓存中的管线；record为true时写入捕获文件
+        static VkPipeline createState(const PipelineState& state, bool record);
+        // 调用时持有swapLock的独占锁
+        static void replaceCurrent(PipelineGeneration generation);
+    public:
+        // 可以在任意线程调用；多个线程同时请求同一个还没有的状态时只保留一个结果，
+        // 状态正在后台创建时只等待它自己
+        static VkPipeline get(const PipelineState& state);
+        // 把列表中还没有的状态分给所有工作线程并行创建，全部完成后返回；加载时调用，避免第一次绘制时才创建
+        static void prewarm(const std::vector<PipelineState>& states);
+        // 与prewarm相同但立即返回，渲染只在get用到某个状态时等待它；捕获时退化为prewarm
+        static void prewarmAsync(const std::vector<PipelineState>& states);
+        // 当前一代的管线布局，着色器还没加载时先加载
+        static VkPipelineLayout getLayout();
+        // 用新的字节码重新创建当前缓存的所有状态，不影响正在使用的一代，可以在其它线程调用；
+        // 这之后才第一次被请求的状态不在新的一代中，换代后按需重新创建
+        static PipelineGeneration rebuild(const std::vector<char>& vertCode, const std::vector<char>& fragCode);
+        // 在帧边界调用，换上新的一代；旧的管线和着色器模块在已提交的帧执行完后销毁。
+        // 后台正在创建管线时等待它们完成
+        static void swap(PipelineGeneration generation);
+        // 与swap相同但不等待：后台正在创建管线时返回false，generation保持不变，调用者下一帧再试
+        static bool trySwap(PipelineGeneration& generation);
+        // 立即销毁一代，调用者需保证GPU没有在使用它
+        static void destroy(PipelineGeneration& generation);
+        static size_t size();
+        static void cleanup();
+
     private:
-        static VkPipelineLayout pipelineLayout;
-        static VkPipeline graphicsPipeline;
+        static PipelineGeneration current;
+        // 后台正在创建的状态，任务结束时移除
+        static std::unordered_map<PipelineState, std::shared_ptr<Jobs::Counter>, PipelineStateHash> inFlight;
+        static std::shared_mutex swapLock;  // 查找和创建持有共享锁，换代持有独占锁
+        static std::mutex mapLock;          // 保护current和inFlight的内容
     };
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <vector>
+
+namespace Profiling{
+    // 一帧内所有被统计的绘制的计数之和
+    struct PipelineCounters{
+        uint64_t inputVertices = 0;
+        uint64_t inputPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;  // 裁剪后输出到光栅化的图元数
+        uint64_t fragmentShaderInvocations = 0;
+        uint64_t samplesPassed = 0;       // 通过深度/模板测试的采样数
+        uint32_t drawCount = 0;
+        bool truncated = false;           // 绘制数超过查询池容量，只统计了前面的绘制
+    };
+
+    // 每个在途帧一个管线统计查询池和一个遮挡查询池，每次绘制各占一个查询；
+    // 与时间戳一样在槽位的帧完成后回读，不等待GPU。某一帧的绘制数超过容量时该帧标记为截断，
+    // 查询池在该槽位下一次使用前扩大。每次绘制的查询会影响帧时间，由Config::enablePipelineStatistics控制
+    class PipelineStatistics{
+        PipelineStatistics();
+        PipelineStatistics(const PipelineStatistics&)=delete;
+        PipelineStatistics(const PipelineStatistics&&)=delete;
+        PipelineStatistics& operator=(const PipelineStatistics&)=delete;
+
+        static void readBack(uint32_t frameIndex);
+        struct FrameQueries;
+        static void createPools(FrameQueries& frame, uint32_t capacity);
+        static void destroyPools(FrameQueries& frame);
+    public:
+        static void createQueryPools();
+        static bool isEnabled();
+
+        // 在render pass之外调用：汇总该槽位上一次的结果并重置查询池
+        static void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        // 包住一次绘制命令，两者必须在同一个subpass内
+        static void beginDraw(VkCommandBuffer commandBuffer);
+        static void endDraw(VkCommandBuffer commandBuffer);
+
+        static const PipelineCounters& getFrameCounters();
+        // 根据计数估计瓶颈：顶点、填充率还是过度绘制
+        static void printReport();
+        static void cleanup();
+
+    private:
+        struct FrameQueries{
+            VkQueryPool statisticsPool = VK_NULL_HANDLE;
+            VkQueryPool occlusionPool = VK_NULL_HANDLE;
+            uint32_t capacity = 0;
+            uint32_t drawCount = 0;  // 这一帧请求统计的绘制数，可能超过capacity
+        };
+
+        static std::vector<FrameQueries> frames;
+        static uint32_t currentFrame;
+        static bool statisticsSupported;
+        static bool occlusionPrecise;  // 不支持精确遮挡查询时只能得到是否有采样通过
+        static std::vector<uint64_t> results;
+        static PipelineCounters frameCounters;
+    };
+}
@@ -7,16 +7,22 @@
 
 namespace Presentation{
     class SwapChain{
-        static void createSwapChain();
+        static void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
         static void createImageViews();
     public:
         static void DoInit();
         static void cleanup();
+        // 以当前交换链作为oldSwapchain重建，旧对象交给延迟销毁队列，不等待设备空闲
         static void recreateSwapChain();
+        static void requestRecreate();
+        static bool isRecreateRequested();
         static VkSwapchainKHR getSwapChain();
         static VkFormat getSwapChainImageFormat();
         static VkExtent2D getSwapChainExtent();
         static std::vector<VkImageView> getSwapChainImageViews();
+        static VkImage getSwapChainImage(uint32_t imageIndex);
+        // 交换链图像能否作为复制源，不支持时无法回读渲染结果
+        static bool isTransferSource();
 
     private:
         static VkFormat swapChainImageFormat;
@@ -24,5 +30,7 @@ namespace Presentation{
         static VkExtent2D swapChainExtent;
         static VkSwapchainKHR swapChain;
         static std::vector<VkImage> swapChainImages;
+        static bool transferSource;
+        static bool recreateRequested;  // 窗口大小改变后置位，在下一次呈现后重建
     };
 }
\ No newline at end of file
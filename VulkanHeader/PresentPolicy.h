@@ -0,0 +1,43 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <vector>
+
+namespace Presentation{
+    struct PresentSelection{
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        uint32_t imageCount = 0;
+    };
+
+    // 延迟模型而不是测量值：每帧输入采样到提交的CPU耗时，加上排在它前面等待显示的帧数和扫描输出各乘以该帧的帧间隔；
+    // 没有测量图像实际显示的时刻
+    struct LatencyReport{
+        PresentSelection selection;
+        uint32_t queuedFrames = 0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+    };
+
+    class PresentPolicy{
+        PresentPolicy();
+        PresentPolicy(const PresentPolicy&)=delete;
+        PresentPolicy(const PresentPolicy&&)=delete;
+        PresentPolicy& operator=(const PresentPolicy&)=delete;
+
+        static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availableModes);
+        static uint32_t chooseImageCount(VkPresentModeKHR presentMode, const VkSurfaceCapabilitiesKHR& capabilities);
+        static uint32_t countQueuedFrames(const PresentSelection& presentSelection);
+    public:
+        // 根据Config::presentGoal选择呈现模式和图像数量，并记录下来用于延迟报告
+        static PresentSelection select(const VkSurfaceCapabilitiesKHR& capabilities, const std::vector<VkPresentModeKHR>& availableModes);
+        static PresentSelection getSelection();
+        static LatencyReport estimateLatency();
+        static void printReport();
+
+    private:
+        static PresentSelection selection;
+    };
+}
@@ -0,0 +1,79 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Jobs{
+    class Counter;
+}
+
+namespace Readback{
+    void DoInit();
+    void cleanup();
+
+    // 回读得到的一帧图像，数据在回调期间有效，回调可以用FrameReadback::retain延长
+    struct Frame{
+        const uint8_t* data;
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowPitch;     // 每行字节数，紧密排列时等于width * 4
+        VkFormat format;       // 与交换链格式一致，通常是B8G8R8A8
+        uint64_t frameNumber;  // 从开启回读起的帧序号
+        uint32_t slot;         // 所在的回读缓冲区
+    };
+
+    // 主机可见、带缓存的缓冲区组成环，帧末尾把交换链图像复制进下一个缓冲区，
+    // 该帧的时间线值完成后（一到两帧之后）再交给回调，录制和提交都不等待GPU。
+    // 环比在途帧多RETAINED_SLOTS个缓冲区，回调交给后台的处理可以在之后几帧内完成而不阻塞渲染
+    class FrameReadback{
+        FrameReadback();
+        FrameReadback(const FrameReadback&)=delete;
+        FrameReadback(const FrameReadback&&)=delete;
+        FrameReadback& operator=(const FrameReadback&)=delete;
+
+        static void ensureCapacity(uint32_t slotIndex, VkDeviceSize size);
+        // 等待回调保留该缓冲区的任务全部完成
+        static void release(uint32_t slotIndex);
+    public:
+        static constexpr uint32_t RETAINED_SLOTS = 2;
+
+        static void createRing();
+        // 注册了回调后才开始回读，每一帧按注册顺序交给所有回调；交换链图像不能作为复制源时回调不会被调用
+        static void addCallback(std::function<void(const Frame&)> callback);
+        static void clearCallbacks();
+        static bool isEnabled();
+        // 在回调中调用：frame.data在counter归零前保持有效，缓冲区要复用时才等待
+        static void retain(const Frame& frame, std::shared_ptr<Jobs::Counter> counter);
+
+        // 在render pass结束之后调用，图像处于PRESENT_SRC布局，复制后恢复原布局
+        static void recordCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, VkExtent2D extent, VkFormat format);
+        // 该槽位上一次提交的帧执行完毕后调用，把它的回读结果交给回调
+        static void collect(uint32_t frameIndex);
+        // 设备空闲后调用，按帧顺序交出所有还未交付的结果
+        static void collectAll();
+        static void cleanup();
+
+    private:
+        struct Slot{
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mapped = nullptr;
+            VkDeviceSize capacity = 0;
+            bool pending = false;
+            Frame frame{};
+            std::vector<std::shared_ptr<Jobs::Counter>> retainers;
+        };
+
+        static std::vector<Slot> slots;
+        static std::vector<uint32_t> frameSlots;  // 每个在途帧复制到的缓冲区
+        static uint32_t nextSlot;
+        static std::vector<std::function<void(const Frame&)>> callbacks;
+        static VkMemoryPropertyFlags memoryProperties;
+        static uint64_t frameNumber;
+    };
+}
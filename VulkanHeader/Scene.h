@@ -0,0 +1,100 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace Scene{
+    void DoInit();
+    void cleanup();
+
+    const uint32_t INVALID_NODE = 0xFFFFFFFF;
+    const uint32_t INVALID_INSTANCE = 0xFFFFFFFF;
+
+    // 每帧一段持久映射的主机可见存储缓冲区，节点的世界矩阵直接写入，着色器按实例索引读取
+    class InstanceStream{
+        InstanceStream();
+        InstanceStream(const InstanceStream&)=delete;
+        InstanceStream(const InstanceStream&&)=delete;
+        InstanceStream& operator=(const InstanceStream&)=delete;
+    public:
+        static void createStream(uint32_t capacity);
+        static uint32_t acquireSlot();
+        static void releaseSlot(uint32_t slot);
+
+        static void setCurrentFrame(uint32_t frameIndex);
+        static glm::mat4* getFrameData(uint32_t frameIndex);
+        // 当前帧数据所在的bindless存储缓冲区索引，未启用bindless时为INVALID_INDEX
+        static uint32_t getCurrentBufferIndex();
+        // 分配过的最大槽位数，只增不减
+        static uint32_t getSlotCount();
+        static uint32_t getCapacity();
+        static void cleanup();
+
+    private:
+        static VkBuffer buffer;
+        static VkDeviceMemory bufferMemory;
+        static void* mappedData;
+        static VkDeviceSize frameStride;  // 每帧数据段的大小，按存储缓冲区偏移对齐
+        static uint32_t capacity;
+        static uint32_t nextSlot;
+        static uint32_t currentFrame;
+        static std::vector<uint32_t> freeSlots;
+        static std::vector<uint32_t> bufferIndices;
+    };
+
+    // 父子层级变换，节点按深度排序存放在扁平数组中，同一层的节点可以并行更新
+    class SceneGraph{
+        SceneGraph();
+        SceneGraph(const SceneGraph&)=delete;
+        SceneGraph(const SceneGraph&&)=delete;
+        SceneGraph& operator=(const SceneGraph&)=delete;
+
+        static void rebuildLayout();
+        static void collectUpdates();
+        static void updateRange(uint32_t begin, uint32_t end, glm::mat4* frameData);
+        static void updateDenseRange(uint32_t begin, uint32_t end, glm::mat4* frameData);
+        static void uploadPending(glm::mat4* frameData);
+        static void markPending(uint32_t index, bool written);
+    public:
+        // 返回稳定的节点句柄，父节点必须先于子节点创建；renderable的节点会分配一个实例槽位
+        static uint32_t createNode(uint32_t parent = INVALID_NODE, bool renderable = false);
+        static void setLocalTransform(uint32_t node, const glm::mat4& transform);
+        static const glm::mat4& getLocalTransform(uint32_t node);
+        static const glm::mat4& getWorldTransform(uint32_t node);
+        static uint32_t getInstanceIndex(uint32_t node);
+        static uint32_t getNodeCount();
+        static void clear();
+
+        // 只重新计算被修改的子树，并把变化的世界矩阵写入该帧的实例数据；
+        // 每帧的开销与修改过的节点及其后代的数量成正比，与场景总节点数无关
+        static void update(uint32_t frameIndex);
+
+    private:
+        // 按句柄索引
+        static std::vector<uint32_t> handleToIndex;
+        static std::vector<uint32_t> handleParent;
+        static std::vector<uint32_t> handleDepth;
+        static std::vector<std::vector<uint32_t>> handleChildren;
+
+        // 按深度排序后的位置索引
+        static std::vector<uint32_t> parentIndex;
+        static std::vector<uint32_t> indexToHandle;
+        static std::vector<uint32_t> instanceSlot;
+        static std::vector<glm::mat4> localTransforms;
+        static std::vector<glm::mat4> worldTransforms;
+        static std::vector<uint8_t> dirty;          // 节点已在本次更新的处理范围内
+        static std::vector<uint8_t> pendingFrames;  // 世界矩阵变化后还有几帧的实例数据没有写入
+        static std::vector<uint32_t> levelOffsets;  // 第i层节点位于[levelOffsets[i], levelOffsets[i+1])
+        static bool layoutDirty;
+
+        static std::vector<uint32_t> dirtyNodes;      // 自上次更新以来直接修改过的节点句柄
+        static std::vector<uint32_t> updateList;      // 本次需要重新计算的节点句柄，按深度分段
+        static std::vector<uint32_t> updateLevels;    // 第i层的节点位于updateList[updateLevels[i], updateLevels[i+1])
+        static std::vector<uint32_t> pendingUploads;  // pendingFrames不为零的节点句柄
+    };
+}
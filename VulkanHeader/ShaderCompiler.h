@@ -0,0 +1,49 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ShaderCompiler{
+    // 带shaderc构建时创建编译器，之后可以在任意线程编译
+    void DoInit();
+    void cleanup();
+
+    enum class Stage{
+        Vertex,
+        Fragment
+    };
+
+    struct CompileRequest{
+        std::string path;  // GLSL源文件，#include按包含它的文件所在目录解析
+        Stage stage;
+        std::vector<std::pair<std::string, std::string>> defines;
+    };
+
+    // 按内容寻址的SPIR-V磁盘缓存：键是源码、递归展开的所有#include文件、宏定义、
+    // 编译选项和编译器版本的128位哈希，命中时完全跳过编译
+    class SpirvCache{
+        SpirvCache();
+        SpirvCache(const SpirvCache&)=delete;
+        SpirvCache(const SpirvCache&&)=delete;
+        SpirvCache& operator=(const SpirvCache&)=delete;
+
+        static std::vector<char> compileSource(const CompileRequest& request);
+    public:
+        // 没有链接shaderc时返回false，此时只能使用预编译的.spv文件
+        static bool isAvailable();
+        // 计算缓存键，源文件或其包含的文件读取失败时抛出异常
+        static std::string computeKey(const CompileRequest& request);
+        // 先查缓存，未命中时编译并写入缓存；编译错误时抛出带编译器输出的异常
+        static std::vector<char> compile(const CompileRequest& request);
+        // 交给任务系统并行编译，结果与requests一一对应
+        static std::vector<std::vector<char>> compileAll(const std::vector<CompileRequest>& requests);
+
+        static uint64_t getHitCount();
+        static uint64_t getMissCount();
+
+    private:
+        static std::atomic<uint64_t> hitCount;
+        static std::atomic<uint64_t> missCount;
+    };
+}
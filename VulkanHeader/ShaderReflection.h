@@ -0,0 +1,50 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
+namespace ShaderReflection{
+    // 顶点着色器的一个输入位置，矩阵和数组按列或元素展开成连续的位置
+    struct VertexInput{
+        uint32_t location;
+        VkFormat format;
+        uint32_t size;  // 字节数
+    };
+
+    // 着色器声明的一个描述符绑定，stageFlags在合并多个阶段时累加
+    struct ResourceBinding{
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count;  // 数组元素个数，不定长数组为0
+        VkShaderStageFlags stageFlags;
+    };
+
+    struct ModuleInfo{
+        VkShaderStageFlagBits stage;
+        std::vector<VertexInput> inputs;        // 只有顶点阶段填写，按location排序，不含内建变量
+        std::vector<ResourceBinding> bindings;  // 按set和binding排序
+        VkPushConstantRange pushConstants;      // 没有push constant块时size为0
+    };
+
+    // 解析SPIR-V字节码中第一个入口点的接口；字节码格式错误或有不支持的输入类型时抛出异常
+    ModuleInfo reflect(const std::vector<char>& code);
+
+    // 由顶点着色器的输入生成一个交错的顶点缓冲区绑定，属性按location顺序紧密排列
+    struct VertexInputLayout{
+        VkVertexInputBindingDescription binding;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+    };
+    VertexInputLayout makeVertexInput(const ModuleInfo& vertexModule);
+
+    // 合并各阶段的描述符绑定和push constant，sets[i]是set i的绑定列表，中间没有用到的set为空
+    struct LayoutDescription{
+        std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+        VkPushConstantRange pushConstants;  // 各阶段的范围合并成一个，size为0时没有push constant
+    };
+    // 同一个绑定点在不同阶段的类型或数量不同时抛出异常
+    LayoutDescription mergeLayouts(const std::vector<const ModuleInfo*>& modules);
+}
@@ -0,0 +1,28 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ShaderRegistry{
+    // 构建时由cmake/EmbedShaders.cmake嵌入的SPIR-V，数据在只读段中，按4字节对齐
+    struct EmbeddedShader{
+        const char* name;  // 去掉.spv后缀的文件名，如"vert"
+        const uint32_t* code;
+        uint32_t wordCount;
+    };
+
+    // 按名字查找嵌入的着色器，不读取任何文件，可以在任意线程调用；
+    // 关闭VULKAN_EMBED_SHADERS构建时没有任何着色器
+    class EmbeddedShaders{
+        EmbeddedShaders();
+        EmbeddedShaders(const EmbeddedShaders&)=delete;
+        EmbeddedShaders(const EmbeddedShaders&&)=delete;
+        EmbeddedShaders& operator=(const EmbeddedShaders&)=delete;
+    public:
+        // 找不到时返回nullptr
+        static const EmbeddedShader* find(const std::string& name);
+        // 复制一份字节码，找不到时抛出异常
+        static std::vector<char> getCode(const std::string& name);
+        static size_t getCount();
+    };
+}
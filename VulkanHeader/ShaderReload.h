@@ -0,0 +1,50 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PipelineData{
+    struct PipelineGeneration;
+}
+
+namespace ShaderReload{
+    // 开启Config::enableShaderHotReload且不是无窗口模式时监视着色器目录
+    void DoInit();
+    void cleanup();
+
+    // 用inotify监视着色器目录，字节码或GLSL源码写完后由监视线程重新编译，并重建管线缓存中的所有管线；
+    // 新的一代在下一帧开始时换上，主循环从不等待编译
+    class ShaderWatcher{
+        ShaderWatcher();
+        ShaderWatcher(const ShaderWatcher&)=delete;
+        ShaderWatcher(const ShaderWatcher&&)=delete;
+        ShaderWatcher& operator=(const ShaderWatcher&)=delete;
+
+        static void watchLoop();
+        static void rebuild();
+    public:
+        // 目录不存在或inotify不可用时只打印警告，不影响运行
+        static void start(const std::string& directory);
+        static void stop();
+        // 每帧录制前在主线程调用，有编译好的新管线时整体换上
+        static void applyPending();
+        static uint64_t getReloadCount();
+
+    private:
+        // 连续保存多个文件时合并为一次重建的等待时间
+        static constexpr int DEBOUNCE_MILLISECONDS = 100;
+
+        static std::string directory;
+        static int inotifyFd;
+        static int wakeFd;
+        static std::thread watcher;
+
+        static std::mutex pendingLock;
+        static std::atomic<bool> hasPending;
+        static std::unique_ptr<PipelineData::PipelineGeneration> pendingGeneration;
+        static uint64_t reloadCount;
+    };
+}
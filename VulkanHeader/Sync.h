@@ -0,0 +1,102 @@
+#ifndef VulkanHeader
+#define VulkanHeader
+#include <vulkan/vulkan.h>
+#endif
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Sync{
+    void DoInit();
+    void cleanup();
+
+    enum QueueType : uint32_t{
+        Graphics = 0,
+        Compute = 1,
+        Transfer = 2,
+        QueueTypeCount = 3
+    };
+
+    // 提交时需要等待的信号量，二值信号量的value被忽略
+    struct SemaphoreWait{
+        VkSemaphore semaphore;
+        uint64_t value;
+        VkPipelineStageFlags stage;
+    };
+
+    // 每个队列一个单调递增的时间线信号量，每次提交把它推进到新的值；
+    // 任何模块都可以记下提交返回的值，之后查询或等待它，而不用为每次提交创建fence
+    class Timeline{
+        Timeline();
+        Timeline(const Timeline&)=delete;
+        Timeline(const Timeline&&)=delete;
+        Timeline& operator=(const Timeline&)=delete;
+    public:
+        static void createTimelines();
+
+        static VkQueue getQueue(QueueType type);
+        static VkSemaphore getSemaphore(QueueType type);
+        // 生成一个等待type队列到达value的等待项，用于跨队列依赖
+        static SemaphoreWait waitFor(QueueType type, uint64_t value, VkPipelineStageFlags stage);
+
+        // 提交命令缓冲区并把队列的时间线推进一步，返回本次提交完成时的值
+        static uint64_t submit(QueueType type, const std::vector<VkCommandBuffer>& commandBuffers,
+                               const std::vector<SemaphoreWait>& waits = {},
+                               const std::vector<VkSemaphore>& binarySignals = {});
+
+        static uint64_t getLastSubmittedValue(QueueType type);
+        static uint64_t getCompletedValue(QueueType type);
+        static bool isComplete(QueueType type, uint64_t value);
+        // 超时返回false
+        static bool wait(QueueType type, uint64_t value, uint64_t timeout = UINT64_MAX);
+        // 等待所有队列上已经提交的工作完成
+        static void waitIdle();
+        static void cleanup();
+
+    private:
+        struct QueueTimeline{
+            VkQueue queue = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            // 两个值都会被其他线程无锁读取；lastSubmitted只在submitLock内写入
+            std::atomic<uint64_t> lastSubmitted{0};
+            std::atomic<uint64_t> completed{0};  // 最近一次查询到的完成值，只通过CAS增大
+            std::mutex submitLock;               // 同一个VkQueue的提交需要外部同步
+        };
+
+        // 把completed推进到value，已经更大时保持不变，返回推进后的值
+        static uint64_t advanceCompleted(QueueTimeline& timeline, uint64_t value);
+
+        static QueueTimeline timelines[QueueTypeCount];
+        // 没有独立队列的类型共用图形队列及其时间线
+        static uint32_t timelineIndex[QueueTypeCount];
+    };
+
+    // 延迟销毁队列：对象在队列的时间线到达指定值之后才被销毁，替代vkDeviceWaitIdle后立即销毁
+    class DeletionQueue{
+        DeletionQueue();
+        DeletionQueue(const DeletionQueue&)=delete;
+        DeletionQueue(const DeletionQueue&&)=delete;
+        DeletionQueue& operator=(const DeletionQueue&)=delete;
+    public:
+        // 在type队列目前已提交的工作全部完成后执行deleter
+        static void retire(QueueType type, std::function<void()> deleter);
+        static void retire(QueueType type, uint64_t value, std::function<void()> deleter);
+        // 每帧调用一次，执行已经安全的销毁操作
+        static void collect();
+        // 关闭时调用，调用者需保证GPU已经空闲
+        static void flush();
+
+    private:
+        struct PendingDeletion{
+            QueueType type;
+            uint64_t value;
+            std::function<void()> deleter;
+        };
+
+        static std::mutex lock;
+        static std::deque<PendingDeletion> pending;
+    };
+}
@@ -0,0 +1,84 @@
+#include <cstdint>
+
+// CPU插桩：用TRACE_SCOPE标记一个作用域，结束时记录名字、线程和起止时间；
+// 未定义VULKAN_ENABLE_TRACING时所有宏展开为空，不产生任何代码
+#ifdef VULKAN_ENABLE_TRACING
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// name必须在程序结束前有效，通常为字符串字面量
+#define TRACE_SCOPE(name) Tracing::ScopedEvent TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
+// 记录一次调用，事件名就是调用表达式本身
+#define TRACE_CALL(call) do { TRACE_SCOPE(#call); call; } while (0)
+#define TRACE_THREAD_NAME(name) Tracing::Tracer::setThreadName(name)
+#define TRACE_WRITE(path) Tracing::Tracer::writeChromeTrace(path)
+
+namespace Tracing{
+    struct Event{
+        const char* name;
+        uint64_t begin;  // 相对进程启动的纳秒数
+        uint64_t end;
+    };
+
+    // 每个线程一个只追加的缓冲区：只有所属线程写入，写完一个事件后用release发布计数，
+    // 导出时按acquire读取计数，读写双方都不需要加锁
+    struct ThreadBuffer{
+        static constexpr uint32_t CAPACITY = 1 << 16;
+
+        std::unique_ptr<Event[]> events{new Event[CAPACITY]};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> dropped{0};
+        uint32_t threadId = 0;
+        std::string threadName;
+    };
+
+    class Tracer{
+        Tracer();
+        Tracer(const Tracer&)=delete;
+        Tracer(const Tracer&&)=delete;
+        Tracer& operator=(const Tracer&)=delete;
+
+        static ThreadBuffer& registerThread();
+    public:
+        static uint64_t now();
+        static void record(const char* name, uint64_t begin, uint64_t end);
+        static void setThreadName(const std::string& name);
+        // 导出为Chrome trace_event格式的JSON，可以直接用Perfetto或chrome://tracing打开
+        static bool writeChromeTrace(const char* path);
+
+    private:
+        static thread_local ThreadBuffer* threadBuffer;
+        // 缓冲区属于Tracer而不是线程，线程退出后其事件仍能导出
+        static std::mutex registryLock;
+        static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    class ScopedEvent{
+    public:
+        explicit ScopedEvent(const char* name) : name(name), begin(Tracer::now()) {}
+        ~ScopedEvent() { Tracer::record(name, begin, Tracer::now()); }
+        ScopedEvent(const ScopedEvent&)=delete;
+        ScopedEvent& operator=(const ScopedEvent&)=delete;
+
+    private:
+        const char* name;
+        uint64_t begin;
+    };
+}
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_FUNCTION() ((void)0)
+#define TRACE_CALL(call) call
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_WRITE(path) ((void)0)
+
+#endif
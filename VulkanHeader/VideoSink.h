@@ -0,0 +1,99 @@
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Jobs{
+    class Counter;
+}
+
+namespace Video{
+    // 设置了Config::videoOutputPath时把回读的每一帧写入视频文件
+    void DoInit();
+    void cleanup();
+
+    // 8位BGRA/RGBA转换为I420：BT.709有限范围，色度取2x2像素的平均值（中心采样，对应Y4M的C420jpeg）
+    class ColorConverter{
+        ColorConverter();
+        ColorConverter(const ColorConverter&)=delete;
+        ColorConverter(const ColorConverter&&)=delete;
+        ColorConverter& operator=(const ColorConverter&)=delete;
+    public:
+        // 默认按CPU支持情况自动选择，基准测试时可以强制指定某个实现
+        enum class Kernel{
+            Auto,
+            Scalar,
+            Sse2,
+            Avx2
+        };
+        static void setKernel(Kernel kernel);
+
+        // 转换第[rowPairBegin, rowPairEnd)个行对，width和高度都必须是偶数
+        static void convertRows(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, bool rgba,
+                                uint32_t rowPairBegin, uint32_t rowPairEnd,
+                                uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane);
+        // 按行对切块交给任务系统并行转换，返回时已全部完成
+        static void convert(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba,
+                            uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane);
+        // 与convert相同但立即返回，counter归零时转换完成；任务系统没有启动时在当前线程完成
+        static void convertAsync(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba,
+                                 uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane, Jobs::Counter* counter);
+    };
+
+    enum class Container{
+        Y4M,  // YUV4MPEG2文件头加每帧的FRAME标记
+        Raw   // 只有连续的I420帧，分辨率和帧率由使用者另行指定
+    };
+
+    // 不编码的视频输出：颜色转换交给任务系统在后台进行，写线程等每一帧转换完成后按顺序写入文件，
+    // 提交帧的渲染线程只在帧缓冲全部被占用时等待
+    class VideoSink{
+        VideoSink();
+        VideoSink(const VideoSink&)=delete;
+        VideoSink(const VideoSink&&)=delete;
+        VideoSink& operator=(const VideoSink&)=delete;
+
+        static void writerLoop();
+    public:
+        // 帧缓冲的数量，写文件落后时submit会等待空闲的缓冲
+        static constexpr uint32_t BUFFER_COUNT = 3;
+
+        static void open(const char* path, Container container, uint32_t frameRate);
+        static bool isOpen();
+        // 第一帧决定视频分辨率，奇数的宽高裁掉最后一列或一行；之后分辨率不同的帧被丢弃。
+        // pixels在返回的计数器归零前必须保持有效，帧被丢弃时返回空指针
+        static std::shared_ptr<Jobs::Counter> submit(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba);
+        // 等待排队的帧全部写完后关闭文件
+        static void close();
+
+        static uint64_t getFrameCount();
+        static uint64_t getDroppedCount();
+        static uint64_t getStallCount();  // submit等待空闲缓冲的次数
+
+    private:
+        static FILE* file;
+        static Container container;
+        static uint32_t frameRate;
+        static uint32_t width;
+        static uint32_t height;
+        static std::vector<std::vector<uint8_t>> buffers;
+        static std::vector<uint32_t> freeBuffers;
+        struct QueuedFrame{
+            uint32_t buffer;
+            std::shared_ptr<Jobs::Counter> converted;
+        };
+
+        static std::deque<QueuedFrame> writeQueue;
+        static std::mutex queueLock;
+        static std::condition_variable queueCondition;
+        static std::thread writer;
+        static bool stopping;
+        static uint64_t frameCount;
+        static uint64_t droppedCount;
+        static uint64_t stallCount;
+    };
+}
@@ -20,29 +20,70 @@
 #include "Draw.h"
 #include "PipelineData.h"
 #include "Config.h"
+#include "Descriptor.h"
+#include "Scene.h"
+#include "Jobs.h"
+#include "Sync.h"
+#include "PresentPolicy.h"
+#include "GpuProfiler.h"
+#include "PipelineStats.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "Readback.h"
+#include "VideoSink.h"
+#include "ShaderReload.h"
+#include "ShaderCompiler.h"
 
 
 int main(){
     
     try {
         int error_code = 0;
-        Init::GlfwWindow::initWindow(error_code);
+        Config::loadEnvironmentOverrides();
+        TRACE_CALL(Jobs::DoInit());
+        TRACE_CALL(ShaderCompiler::DoInit());
+        TRACE_CALL(Capture::DoInit());
+        TRACE_CALL(Init::GlfwWindow::initWindow(error_code));
         VkResult vk_error_code;
-        Init::Instance::CreateInstance(vk_error_code);
-        Config::setupDebugMessenger();
-        Device::DoInit();
-        Presentation::SwapChain::DoInit();
-        PipelineData::DoInit();
-        DrawSpace::CommondFactory::DoInit();
+        TRACE_CALL(Init::Instance::CreateInstance(vk_error_code));
+        TRACE_CALL(Config::setupDebugMessenger());
+        TRACE_CALL(Device::DoInit());
+        TRACE_CALL(Sync::DoInit());
+        TRACE_CALL(Profiling::DoInit());
+        TRACE_CALL(Readback::DoInit());
+        TRACE_CALL(Video::DoInit());
+        TRACE_CALL(Descriptor::DoInit());
+        TRACE_CALL(Scene::DoInit());
+        TRACE_CALL(Presentation::SwapChain::DoInit());
+        TRACE_CALL(PipelineData::DoInit());
+        TRACE_CALL(DrawSpace::CommondFactory::DoInit());
+        TRACE_CALL(ShaderReload::DoInit());
 
         Init::GlfwWindow::loop();
+        // 退出前等待GPU完成所有工作，之后才能销毁资源
+        vkDeviceWaitIdle(Device::VulkanDevice::getLogicalDevice());
+        Readback::FrameReadback::collectAll();
+        Video::cleanup();
+        Presentation::PresentPolicy::printReport();
+        Profiling::PipelineStatistics::printReport();
+        Capture::cleanup();
+        ShaderReload::cleanup();
         
         Presentation::SwapChain::cleanup();
         PipelineData::cleanup();
         DrawSpace::CommondFactory::cleanup();
+        Scene::cleanup();
+        Descriptor::cleanup();
+        Readback::cleanup();
+        Profiling::cleanup();
+        Sync::cleanup();
         Device::VulkanDevice::cleanup();
         Init::Instance::cleanup();
         Init::GlfwWindow::cleanup();
+        ShaderCompiler::cleanup();
+        Jobs::cleanup();
+        // 导出启动和每帧的CPU耗时，未开启VULKAN_ENABLE_TRACING时不做任何事
+        TRACE_WRITE(Config::traceOutputPath);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
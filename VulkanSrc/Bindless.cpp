@@ -0,0 +1,206 @@
+#include "Bindless.h"
+#include "Descriptor.h"
+#include "Device.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Descriptor{
+    VkDescriptorPool BindlessHeap::pool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout BindlessHeap::layout = VK_NULL_HANDLE;
+    VkDescriptorSet BindlessHeap::descriptorSet = VK_NULL_HANDLE;
+    BindlessHeap::IndexAllocator BindlessHeap::allocators[3];
+
+    namespace{
+        // 期望的数组大小，实际大小会被设备的UPDATE_AFTER_BIND限制截断
+        const uint32_t MAX_SAMPLED_IMAGES = 16384;
+        const uint32_t MAX_STORAGE_BUFFERS = 4096;
+        const uint32_t MAX_SAMPLERS = 256;
+        // 片段着色器的颜色附件也计入每个阶段的资源总数，给它们留出余量
+        const uint32_t RESERVED_STAGE_RESOURCES = 8;
+
+        const VkDescriptorType bindingTypes[3] = {
+            VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_SAMPLER
+        };
+    }
+
+    uint32_t BindlessHeap::IndexAllocator::acquire(){
+        if (!freeIndices.empty()) {
+            uint32_t index = freeIndices.back();
+            freeIndices.pop_back();
+            return index;
+        }
+        if (next >= capacity) {
+            throw std::runtime_error("bindless descriptor array is full!");
+        }
+        return next++;
+    }
+
+    void BindlessHeap::createHeap(){
+        if (!Device::VulkanDevice::isBindlessSupported()) {
+            return;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(Device::VulkanDevice::getPhysicalDevice(), &properties2);
+
+        allocators[SampledImages].capacity = std::min({MAX_SAMPLED_IMAGES,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+        allocators[StorageBuffers].capacity = std::min({MAX_STORAGE_BUFFERS,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+            indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers});
+        allocators[Samplers].capacity = std::min({MAX_SAMPLERS,
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+
+        // 三个数组对所有图形阶段可见，图像和存储缓冲区在每个阶段还共享maxPerStageUpdateAfterBindResources，
+        // 超出时按比例缩小两个数组（采样器不计入这个总数）
+        uint32_t stageBudget = indexingProperties.maxPerStageUpdateAfterBindResources > RESERVED_STAGE_RESOURCES ?
+                               indexingProperties.maxPerStageUpdateAfterBindResources - RESERVED_STAGE_RESOURCES : 0;
+        uint64_t stageTotal = static_cast<uint64_t>(allocators[SampledImages].capacity) + allocators[StorageBuffers].capacity;
+        if (stageTotal > stageBudget) {
+            allocators[StorageBuffers].capacity = static_cast<uint32_t>(stageBudget * allocators[StorageBuffers].capacity / stageTotal);
+            allocators[SampledImages].capacity = stageBudget - allocators[StorageBuffers].capacity;
+        }
+        for (const IndexAllocator& allocator : allocators) {
+            if (allocator.capacity == 0) {
+                throw std::runtime_error("failed to fit bindless descriptor arrays into the device update-after-bind limits!");
+            }
+        }
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+        std::vector<VkDescriptorBindingFlags> bindingFlags(3);
+        for (uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = bindingTypes[i];
+            bindings[i].descriptorCount = allocators[i].capacity;
+            bindings[i].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+            // 部分绑定：未写入的元素只要不被访问就是合法的；绑定后更新：命令缓冲区录制后仍可写入新的资源
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        }
+        layout = LayoutCache::getLayout(bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, bindingFlags);
+
+        VkDescriptorPoolSize poolSizes[3];
+        for (uint32_t i = 0; i < 3; i++) {
+            poolSizes[i].type = bindingTypes[i];
+            poolSizes[i].descriptorCount = allocators[i].capacity;
+        }
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 3;
+        poolInfo.pPoolSizes = poolSizes;
+
+        if (vkCreateDescriptorPool(Device::VulkanDevice::getLogicalDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        if (vkAllocateDescriptorSets(Device::VulkanDevice::getLogicalDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+        }
+    }
+
+    bool BindlessHeap::isEnabled(){
+        return descriptorSet != VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetLayout BindlessHeap::getLayout(){
+        return layout;
+    }
+
+    VkPushConstantRange BindlessHeap::getPushConstantRange(){
+        VkPushConstantRange range{};
+        range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        range.offset = 0;
+        range.size = sizeof(BindlessPushConstants);
+        return range;
+    }
+
+    bool BindlessHeap::matchesBinding(const VkDescriptorSetLayoutBinding& binding){
+        if (binding.binding >= 3 || binding.descriptorType != bindingTypes[binding.binding]) {
+            return false;
+        }
+        // 不定长数组的descriptorCount为0，按堆的实际大小访问
+        return binding.descriptorCount <= allocators[binding.binding].capacity;
+    }
+
+    uint32_t BindlessHeap::registerSampledImage(VkImageView imageView, VkImageLayout imageLayout){
+        uint32_t index = allocators[SampledImages].acquire();
+
+        DescriptorBinding binding{};
+        binding.binding = SampledImages;
+        binding.arrayElement = index;
+        binding.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        binding.imageInfo.imageView = imageView;
+        binding.imageInfo.imageLayout = imageLayout;
+        writeDescriptorSet(descriptorSet, {binding});
+        return index;
+    }
+
+    uint32_t BindlessHeap::registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range){
+        uint32_t index = allocators[StorageBuffers].acquire();
+
+        DescriptorBinding binding{};
+        binding.binding = StorageBuffers;
+        binding.arrayElement = index;
+        binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.bufferInfo.buffer = buffer;
+        binding.bufferInfo.offset = offset;
+        binding.bufferInfo.range = range;
+        writeDescriptorSet(descriptorSet, {binding});
+        return index;
+    }
+
+    uint32_t BindlessHeap::registerSampler(VkSampler sampler){
+        uint32_t index = allocators[Samplers].acquire();
+
+        DescriptorBinding binding{};
+        binding.binding = Samplers;
+        binding.arrayElement = index;
+        binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        binding.imageInfo.sampler = sampler;
+        writeDescriptorSet(descriptorSet, {binding});
+        return index;
+    }
+
+    void BindlessHeap::release(Binding binding, uint32_t index){
+        if (index != INVALID_INDEX) {
+            allocators[binding].freeIndices.push_back(index);
+        }
+    }
+
+    void BindlessHeap::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout){
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    }
+
+    void BindlessHeap::cleanup(){
+        if (pool != VK_NULL_HANDLE) {
+            // 布局由LayoutCache持有，这里只销毁池，集合随池一起释放
+            vkDestroyDescriptorPool(Device::VulkanDevice::getLogicalDevice(), pool, nullptr);
+        }
+        pool = VK_NULL_HANDLE;
+        layout = VK_NULL_HANDLE;
+        descriptorSet = VK_NULL_HANDLE;
+        for (auto& allocator : allocators) {
+            allocator = IndexAllocator{};
+        }
+    }
+}
@@ -0,0 +1,547 @@
+#include "Capture.h"
+#include "Config.h"
+#include "Device.h"
+#include "MeshData.h"
+#include "PipelineData.h"
+#include "Bindless.h"
+#include "Scene.h"
+#include "FramePacer.h"
+#include "PipelineStats.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+
+namespace Capture{
+    void DoInit(){
+        if (Config::captureOutputPath != nullptr) {
+            Recorder::begin(Config::captureOutputPath, Config::captureFrameCount);
+        }
+    }
+    void cleanup(){
+        Recorder::end();
+    }
+
+    namespace{
+        constexpr uint32_t INVALID_ID = 0xFFFFFFFF;
+
+        template<typename T>
+        void append(std::vector<uint8_t>& bytes, const T& value){
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(&value);
+            bytes.insert(bytes.end(), begin, begin + sizeof(T));
+        }
+
+        void appendBytes(std::vector<uint8_t>& bytes, const void* data, size_t size){
+            const uint8_t* begin = static_cast<const uint8_t*>(data);
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+
+        // 块数据没有对齐保证，逐个字段复制出来
+        template<typename T>
+        T read(const uint8_t*& cursor, const uint8_t* end){
+            if (static_cast<size_t>(end - cursor) < sizeof(T)) {
+                throw std::runtime_error("capture chunk is truncated!");
+            }
+            T value;
+            memcpy(&value, cursor, sizeof(T));
+            cursor += sizeof(T);
+            return value;
+        }
+
+        template<typename Handle>
+        uint32_t findId(const std::unordered_map<Handle, uint32_t>& ids, Handle handle){
+            auto it = ids.find(handle);
+            return it != ids.end() ? it->second : INVALID_ID;
+        }
+
+        template<typename Handle>
+        Handle findHandle(const std::unordered_map<uint32_t, Handle>& handles, uint32_t id){
+            auto it = handles.find(id);
+            if (it == handles.end()) {
+                throw std::runtime_error("capture references a resource that was not captured!");
+            }
+            return it->second;
+        }
+    }
+
+    FILE* Recorder::file = nullptr;
+    FileHeader Recorder::header{};
+    uint32_t Recorder::remainingFrames = 0;
+    bool Recorder::inFrame = false;
+    uint64_t Recorder::frameNumber = 0;
+    uint32_t Recorder::nextResourceId = 0;
+    std::unordered_map<VkBuffer, uint32_t> Recorder::bufferIds;
+    std::unordered_map<VkPipeline, uint32_t> Recorder::pipelineIds;
+    std::vector<char> Recorder::lastVertCode;
+    std::vector<char> Recorder::lastFragCode;
+    std::vector<glm::mat4> Recorder::lastInstances;
+    std::vector<uint8_t> Recorder::payload;
+
+    void Recorder::begin(const char* path, uint32_t frameCount){
+        end();
+        file = fopen(path, "wb");
+        if (!file) {
+            throw std::runtime_error("failed to open capture file!");
+        }
+        header = {FILE_MAGIC, FILE_VERSION, 0, 0, 0};
+        // 先写占位的文件头，帧数和分辨率在结束时回写
+        fwrite(&header, sizeof(header), 1, file);
+        remainingFrames = frameCount;
+        inFrame = false;
+        frameNumber = 0;
+        nextResourceId = 0;
+    }
+
+    void Recorder::end(){
+        if (!file) {
+            return;
+        }
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        fclose(file);
+        file = nullptr;
+        inFrame = false;
+        bufferIds.clear();
+        pipelineIds.clear();
+        lastVertCode.clear();
+        lastFragCode.clear();
+        lastInstances.clear();
+        payload.clear();
+    }
+
+    bool Recorder::isActive(){
+        return file != nullptr;
+    }
+
+    bool Recorder::isRecordingFrame(){
+        return file != nullptr && inFrame;
+    }
+
+    void Recorder::writeChunk(Chunk type){
+        uint32_t chunkHeader[2] = {static_cast<uint32_t>(type), static_cast<uint32_t>(payload.size())};
+        fwrite(chunkHeader, sizeof(chunkHeader), 1, file);
+        if (!payload.empty()) {
+            fwrite(payload.data(), 1, payload.size(), file);
+        }
+        payload.clear();
+    }
+
+    void Recorder::recordShaderCode(const std::vector<char>& vertCode, const std::vector<char>& fragCode){
+        // 所有管线目前共用同一组着色器，只在字节码变化时写入
+        if (!file || (vertCode == lastVertCode && fragCode == lastFragCode)) {
+            return;
+        }
+        lastVertCode = vertCode;
+        lastFragCode = fragCode;
+        append(payload, static_cast<uint32_t>(vertCode.size()));
+        appendBytes(payload, vertCode.data(), vertCode.size());
+        appendBytes(payload, fragCode.data(), fragCode.size());
+        writeChunk(Chunk::ShaderCode);
+    }
+
+    void Recorder::recordBuffer(VkBuffer buffer, VkBufferUsageFlags usage, const void* data, VkDeviceSize size){
+        if (!file) {
+            return;
+        }
+        uint32_t id = nextResourceId++;
+        bufferIds[buffer] = id;  // 句柄被销毁后复用时覆盖旧的映射
+        append(payload, id);
+        append(payload, static_cast<uint32_t>(usage));
+        appendBytes(payload, data, static_cast<size_t>(size));
+        writeChunk(Chunk::Buffer);
+    }
+
+    void Recorder::recordPipeline(VkPipeline pipeline, const PipelineData::PipelineState& state){
+        if (!file) {
+            return;
+        }
+        uint32_t id = nextResourceId++;
+        pipelineIds[pipeline] = id;
+        append(payload, id);
+        append(payload, static_cast<uint32_t>(state.topology));
+        append(payload, static_cast<uint32_t>(state.polygonMode));
+        append(payload, static_cast<uint32_t>(state.cullMode));
+        append(payload, static_cast<uint32_t>(state.frontFace));
+        append(payload, static_cast<uint32_t>(state.blendEnable ? 1 : 0));
+        for (const auto* constants : {&state.vertexConstants, &state.fragmentConstants}) {
+            append(payload, static_cast<uint32_t>(constants->size()));
+            for (const PipelineData::SpecializationConstant& constant : *constants) {
+                append(payload, constant.id);
+                append(payload, constant.value);
+            }
+        }
+        writeChunk(Chunk::Pipeline);
+    }
+
+    void Recorder::beginFrame(VkExtent2D extent, const glm::mat4* instanceData, uint32_t slotCount){
+        if (!file || remainingFrames == 0) {
+            return;
+        }
+        if (header.frameCount == 0) {
+            header.width = extent.width;
+            header.height = extent.height;
+        }
+        inFrame = true;
+        append(payload, frameNumber++);
+        writeChunk(Chunk::FrameBegin);
+
+        if (instanceData == nullptr) {
+            return;
+        }
+        // 只记录与上一帧不同的连续槽位段，静止的场景几乎不占空间
+        uint32_t previousCount = static_cast<uint32_t>(lastInstances.size());
+        lastInstances.resize(slotCount);
+        append(payload, slotCount);
+        bool changed = slotCount != previousCount;
+        auto differs = [&](uint32_t i){
+            return i >= previousCount || memcmp(&lastInstances[i], &instanceData[i], sizeof(glm::mat4)) != 0;
+        };
+        uint32_t slot = 0;
+        while (slot < slotCount) {
+            if (!differs(slot)) {
+                slot++;
+                continue;
+            }
+            uint32_t first = slot;
+            while (slot < slotCount && differs(slot)) {
+                slot++;
+            }
+            uint32_t count = slot - first;
+            append(payload, first);
+            append(payload, count);
+            appendBytes(payload, instanceData + first, sizeof(glm::mat4) * count);
+            memcpy(&lastInstances[first], instanceData + first, sizeof(glm::mat4) * count);
+            changed = true;
+        }
+        if (changed) {
+            writeChunk(Chunk::InstanceData);
+        } else {
+            payload.clear();
+        }
+    }
+
+    void Recorder::endFrame(){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        writeChunk(Chunk::FrameEnd);
+        inFrame = false;
+        header.frameCount++;
+        if (--remainingFrames == 0) {
+            end();
+        }
+    }
+
+    void Recorder::writeBindPipeline(VkPipeline pipeline){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        append(payload, findId(pipelineIds, pipeline));
+        writeChunk(Chunk::BindPipeline);
+    }
+
+    void Recorder::writeBindVertexBuffer(VkBuffer buffer, VkDeviceSize offset){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        append(payload, findId(bufferIds, buffer));
+        append(payload, static_cast<uint64_t>(offset));
+        writeChunk(Chunk::BindVertexBuffer);
+    }
+
+    void Recorder::writeBindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        append(payload, findId(bufferIds, buffer));
+        append(payload, static_cast<uint64_t>(offset));
+        append(payload, static_cast<uint32_t>(indexType));
+        writeChunk(Chunk::BindIndexBuffer);
+    }
+
+    void Recorder::writePushConstants(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        append(payload, static_cast<uint32_t>(stageFlags));
+        append(payload, offset);
+        appendBytes(payload, values, size);
+        writeChunk(Chunk::PushConstants);
+    }
+
+    void Recorder::writeDrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance){
+        if (!isRecordingFrame()) {
+            return;
+        }
+        append(payload, indexCount);
+        append(payload, instanceCount);
+        append(payload, firstIndex);
+        append(payload, vertexOffset);
+        append(payload, firstInstance);
+        writeChunk(Chunk::DrawIndexed);
+    }
+
+    void cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline){
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        Recorder::writeBindPipeline(pipeline);
+    }
+
+    void cmdBindVertexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset){
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer, &offset);
+        Recorder::writeBindVertexBuffer(buffer, offset);
+    }
+
+    void cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType){
+        vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+        Recorder::writeBindIndexBuffer(buffer, offset, indexType);
+    }
+
+    void cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                          uint32_t offset, uint32_t size, const void* values){
+        vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, values);
+        Recorder::writePushConstants(stageFlags, offset, size, values);
+    }
+
+    void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+                        uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance){
+        vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+        Recorder::writeDrawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    }
+
+    std::vector<uint8_t> Replayer::fileData;
+    FileHeader Replayer::header{};
+    std::vector<Replayer::ChunkView> Replayer::chunks;
+    std::vector<Replayer::FrameRange> Replayer::frames;
+    uint32_t Replayer::nextFrame = 0;
+    std::unordered_map<uint32_t, VkBuffer> Replayer::buffers;
+    std::vector<VkDeviceMemory> Replayer::bufferMemories;
+    std::unordered_map<uint32_t, PipelineData::PipelineState> Replayer::pipelineStates;
+    std::vector<glm::mat4> Replayer::instances;
+    uint32_t Replayer::lastDrawCount = 0;
+    uint64_t Replayer::lastTriangleCount = 0;
+
+    void Replayer::load(const char* path){
+        std::ifstream file{path, std::ios::binary};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open capture file!");
+        }
+        fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+
+        const uint8_t* cursor = fileData.data();
+        const uint8_t* end = cursor + fileData.size();
+        header = read<FileHeader>(cursor, end);
+        if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+            throw std::runtime_error("invalid capture file!");
+        }
+
+        // 只建立块索引，数据留在文件缓冲中按需解析
+        chunks.clear();
+        frames.clear();
+        size_t frameStart = 0;
+        bool inFrame = false;
+        while (cursor < end) {
+            Chunk type = static_cast<Chunk>(read<uint32_t>(cursor, end));
+            uint32_t size = read<uint32_t>(cursor, end);
+            if (static_cast<size_t>(end - cursor) < size) {
+                throw std::runtime_error("capture chunk is truncated!");
+            }
+            if (type == Chunk::FrameBegin) {
+                frameStart = chunks.size() + 1;
+                inFrame = true;
+            } else if (type == Chunk::FrameEnd && inFrame) {
+                frames.push_back({frameStart, chunks.size()});
+                inFrame = false;
+            }
+            chunks.push_back({type, cursor, size});
+            cursor += size;
+        }
+        // 捕获中途退出时最后一帧不完整，直接丢弃
+        if (frames.empty()) {
+            throw std::runtime_error("capture file contains no frames!");
+        }
+        nextFrame = 0;
+    }
+
+    VkExtent2D Replayer::getExtent(){
+        return {header.width, header.height};
+    }
+
+    uint32_t Replayer::getFrameCount(){
+        return static_cast<uint32_t>(frames.size());
+    }
+
+    void Replayer::createResources(){
+        // 连续的管线块攒成一批预先创建，与捕获时的批次一致
+        std::vector<PipelineData::PipelineState> pendingStates;
+        auto flushPipelines = [&](){
+            PipelineData::PipelineStateCache::prewarm(pendingStates);
+            pendingStates.clear();
+        };
+
+        for (const ChunkView& chunk : chunks) {
+            const uint8_t* cursor = chunk.data;
+            const uint8_t* end = chunk.data + chunk.size;
+            if (chunk.type == Chunk::ShaderCode) {
+                flushPipelines();
+                uint32_t vertSize = read<uint32_t>(cursor, end);
+                if (vertSize > static_cast<size_t>(end - cursor)) {
+                    throw std::runtime_error("capture chunk is truncated!");
+                }
+                std::vector<char> vertCode(cursor, cursor + vertSize);
+                std::vector<char> fragCode(cursor + vertSize, end);
+                // 缓存中已有的管线（包括默认管线）换成捕获的着色器，之后的管线也用它创建；
+                // 旧的一代会被销毁，所以只记录状态，录制时再从缓存取出当前的管线
+                PipelineData::PipelineStateCache::swap(PipelineData::PipelineStateCache::rebuild(vertCode, fragCode));
+            } else if (chunk.type == Chunk::Buffer) {
+                uint32_t id = read<uint32_t>(cursor, end);
+                VkBufferUsageFlags usage = read<uint32_t>(cursor, end);
+                VkBuffer buffer;
+                VkDeviceMemory bufferMemory;
+                Mesh::SimpleMesh::uploadBuffer(cursor, static_cast<VkDeviceSize>(end - cursor), usage, buffer, bufferMemory);
+                buffers[id] = buffer;
+                bufferMemories.push_back(bufferMemory);
+            } else if (chunk.type == Chunk::Pipeline) {
+                uint32_t id = read<uint32_t>(cursor, end);
+                PipelineData::PipelineState state;
+                state.topology = static_cast<VkPrimitiveTopology>(read<uint32_t>(cursor, end));
+                state.polygonMode = static_cast<VkPolygonMode>(read<uint32_t>(cursor, end));
+                state.cullMode = read<uint32_t>(cursor, end);
+                state.frontFace = static_cast<VkFrontFace>(read<uint32_t>(cursor, end));
+                state.blendEnable = read<uint32_t>(cursor, end) != 0;
+                for (VkShaderStageFlagBits stage : {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT}) {
+                    uint32_t count = read<uint32_t>(cursor, end);
+                    for (uint32_t i = 0; i < count; i++) {
+                        uint32_t constantId = read<uint32_t>(cursor, end);
+                        state.specialize(stage, constantId, read<uint32_t>(cursor, end));
+                    }
+                }
+                pendingStates.push_back(state);
+                pipelineStates[id] = std::move(state);
+            }
+        }
+        flushPipelines();
+    }
+
+    void Replayer::record(VkCommandBuffer commandBuffer){
+        if (frames.empty()) {
+            return;
+        }
+        // 实例数据按帧差量存放，从头播放时清空重新累积
+        if (nextFrame == 0) {
+            instances.clear();
+        }
+        const FrameRange& frame = frames[nextFrame];
+        nextFrame = (nextFrame + 1) % static_cast<uint32_t>(frames.size());
+
+        bool bindless = Descriptor::BindlessHeap::isEnabled();
+        VkPipelineLayout layout = PipelineData::Pipeline::getPipelineLayout();
+        uint32_t drawCount = 0;
+        uint64_t triangleCount = 0;
+        for (size_t i = frame.firstChunk; i < frame.lastChunk; i++) {
+            const ChunkView& chunk = chunks[i];
+            const uint8_t* cursor = chunk.data;
+            const uint8_t* end = chunk.data + chunk.size;
+            switch (chunk.type) {
+            case Chunk::InstanceData: {
+                uint32_t slotCount = read<uint32_t>(cursor, end);
+                if (slotCount > Scene::InstanceStream::getCapacity()) {
+                    throw std::runtime_error("capture uses more instances than the instance buffer holds!");
+                }
+                instances.resize(slotCount);
+                while (cursor < end) {
+                    uint32_t first = read<uint32_t>(cursor, end);
+                    uint32_t count = read<uint32_t>(cursor, end);
+                    if (first + count > slotCount || static_cast<size_t>(end - cursor) < sizeof(glm::mat4) * count) {
+                        throw std::runtime_error("capture chunk is truncated!");
+                    }
+                    memcpy(&instances[first], cursor, sizeof(glm::mat4) * count);
+                    cursor += sizeof(glm::mat4) * count;
+                }
+                break;
+            }
+            case Chunk::BindPipeline:
+                cmdBindPipeline(commandBuffer, PipelineData::PipelineStateCache::get(findHandle(pipelineStates, read<uint32_t>(cursor, end))));
+                break;
+            case Chunk::BindVertexBuffer: {
+                VkBuffer buffer = findHandle(buffers, read<uint32_t>(cursor, end));
+                cmdBindVertexBuffer(commandBuffer, buffer, read<uint64_t>(cursor, end));
+                break;
+            }
+            case Chunk::BindIndexBuffer: {
+                VkBuffer buffer = findHandle(buffers, read<uint32_t>(cursor, end));
+                VkDeviceSize offset = read<uint64_t>(cursor, end);
+                cmdBindIndexBuffer(commandBuffer, buffer, offset, static_cast<VkIndexType>(read<uint32_t>(cursor, end)));
+                break;
+            }
+            case Chunk::PushConstants: {
+                // 未启用bindless的管线布局没有push constant范围
+                if (!bindless) {
+                    break;
+                }
+                VkShaderStageFlags stageFlags = read<uint32_t>(cursor, end);
+                uint32_t offset = read<uint32_t>(cursor, end);
+                std::vector<uint8_t> values(cursor, end);
+                // 实例缓冲区的bindless索引在回放进程中重新分配，替换成当前帧的索引
+                if (offset == 0 && values.size() >= sizeof(Descriptor::BindlessPushConstants)) {
+                    uint32_t bufferIndex = Scene::InstanceStream::getCurrentBufferIndex();
+                    memcpy(values.data() + offsetof(Descriptor::BindlessPushConstants, instanceBufferIndex), &bufferIndex, sizeof(bufferIndex));
+                }
+                cmdPushConstants(commandBuffer, layout, stageFlags, offset, static_cast<uint32_t>(values.size()), values.data());
+                break;
+            }
+            case Chunk::DrawIndexed: {
+                uint32_t indexCount = read<uint32_t>(cursor, end);
+                uint32_t instanceCount = read<uint32_t>(cursor, end);
+                uint32_t firstIndex = read<uint32_t>(cursor, end);
+                int32_t vertexOffset = read<int32_t>(cursor, end);
+                uint32_t firstInstance = read<uint32_t>(cursor, end);
+                Profiling::PipelineStatistics::beginDraw(commandBuffer);
+                cmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+                Profiling::PipelineStatistics::endDraw(commandBuffer);
+                drawCount++;
+                triangleCount += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // 每个帧槽位的数据段都要写入完整状态，不能只写这一帧的差量
+        glm::mat4* frameData = Scene::InstanceStream::getFrameData(Pacing::FramePacer::getFrameIndex());
+        if (frameData != nullptr && !instances.empty()) {
+            memcpy(frameData, instances.data(), sizeof(glm::mat4) * instances.size());
+        }
+        lastDrawCount = drawCount;
+        lastTriangleCount = triangleCount;
+    }
+
+    uint32_t Replayer::getLastDrawCount(){
+        return lastDrawCount;
+    }
+
+    uint64_t Replayer::getLastTriangleCount(){
+        return lastTriangleCount;
+    }
+
+    void Replayer::cleanup(){
+        // 管线由PipelineData::PipelineStateCache统一销毁
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        for (auto& entry : buffers) {
+            vkDestroyBuffer(device, entry.second, nullptr);
+        }
+        for (VkDeviceMemory memory : bufferMemories) {
+            vkFreeMemory(device, memory, nullptr);
+        }
+        buffers.clear();
+        bufferMemories.clear();
+        pipelineStates.clear();
+        instances.clear();
+        chunks.clear();
+        frames.clear();
+        fileData.clear();
+    }
+}
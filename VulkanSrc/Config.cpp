@@ -1,6 +1,9 @@
 #include "Config.h"
+#include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <iostream>
+#include <stdexcept>
 #include <Instance.h>
 
 
@@ -41,6 +44,129 @@ namespace Config{
     
     const int MAX_FRAMES_IN_FLIGHT = 2;
 
+    bool enableLowLatencyMode = false;
+
+    PresentGoal presentGoal = PresentGoal::LowLatency;
+
+    bool headless = false;
+    uint32_t headlessFrameCount = 300;
+    VkExtent2D headlessExtent = {static_cast<uint32_t>(AreaWidthHeigh::Width), static_cast<uint32_t>(AreaWidthHeigh::Height)};
+
+    const char* shaderDirectory = "../Shader/";
+    bool useEmbeddedShaders = true;
+    const char* shaderCacheDirectory = "shader_cache/";
+    bool enableShaderHotReload = true;
+
+    bool enablePipelineStatistics = true;
+
+    const char* traceOutputPath = "vulkan_trace.json";
+
+    const char* captureOutputPath = nullptr;
+    uint32_t captureFrameCount = 60;
+
+    const char* videoOutputPath = nullptr;
+    uint32_t videoFrameRate = 60;
+
+    const char* screenshotPath = nullptr;
+    uint32_t screenshotFrame = 0;
+
+    void loadEnvironmentOverrides()
+    {
+        // VULKAN_PRESENT_GOAL=latency|power|throughput
+        if (const char* goal = std::getenv("VULKAN_PRESENT_GOAL"))
+        {
+            if (strcmp(goal, "latency") == 0)
+                presentGoal = PresentGoal::LowLatency;
+            else if (strcmp(goal, "power") == 0)
+                presentGoal = PresentGoal::PowerSaving;
+            else if (strcmp(goal, "throughput") == 0)
+                presentGoal = PresentGoal::MaxThroughput;
+            else
+                throw std::runtime_error("unknown VULKAN_PRESENT_GOAL value!");
+        }
+        // VULKAN_HEADLESS=<帧数>，不为0时启用无窗口模式
+        if (const char* frames = std::getenv("VULKAN_HEADLESS"))
+        {
+            headlessFrameCount = static_cast<uint32_t>(std::strtoul(frames, nullptr, 10));
+            headless = headlessFrameCount != 0;
+        }
+        // VULKAN_HEADLESS_EXTENT=<宽>x<高>
+        if (const char* extent = std::getenv("VULKAN_HEADLESS_EXTENT"))
+        {
+            unsigned width = 0, height = 0;
+            if (sscanf(extent, "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+                throw std::runtime_error("invalid VULKAN_HEADLESS_EXTENT value!");
+            headlessExtent = {width, height};
+        }
+        // VULKAN_SHADER_DIR=<目录>/
+        if (const char* directory = std::getenv("VULKAN_SHADER_DIR"))
+        {
+            shaderDirectory = directory;
+            useEmbeddedShaders = false;
+        }
+        // VULKAN_EMBEDDED_SHADERS=0|1，在VULKAN_SHADER_DIR之后处理，可以覆盖它
+        if (const char* embedded = std::getenv("VULKAN_EMBEDDED_SHADERS"))
+        {
+            useEmbeddedShaders = strcmp(embedded, "0") != 0;
+        }
+        // VULKAN_SHADER_CACHE_DIR=<目录>/
+        if (const char* directory = std::getenv("VULKAN_SHADER_CACHE_DIR"))
+        {
+            shaderCacheDirectory = directory;
+        }
+        // VULKAN_SHADER_HOT_RELOAD=0|1
+        if (const char* reload = std::getenv("VULKAN_SHADER_HOT_RELOAD"))
+        {
+            enableShaderHotReload = strcmp(reload, "0") != 0;
+        }
+        // VULKAN_PIPELINE_STATS=0|1
+        if (const char* statistics = std::getenv("VULKAN_PIPELINE_STATS"))
+        {
+            enablePipelineStatistics = strcmp(statistics, "0") != 0;
+        }
+        // VULKAN_TRACE_FILE=<路径>
+        if (const char* path = std::getenv("VULKAN_TRACE_FILE"))
+        {
+            traceOutputPath = path;
+        }
+        // VULKAN_CAPTURE_FILE=<路径>，VULKAN_CAPTURE_FRAMES=<帧数>
+        if (const char* path = std::getenv("VULKAN_CAPTURE_FILE"))
+        {
+            captureOutputPath = path;
+        }
+        if (const char* frames = std::getenv("VULKAN_CAPTURE_FRAMES"))
+        {
+            captureFrameCount = static_cast<uint32_t>(std::strtoul(frames, nullptr, 10));
+            if (captureFrameCount == 0)
+                throw std::runtime_error("invalid VULKAN_CAPTURE_FRAMES value!");
+        }
+        // VULKAN_VIDEO_FILE=<路径>，VULKAN_VIDEO_FPS=<帧率>
+        if (const char* path = std::getenv("VULKAN_VIDEO_FILE"))
+        {
+            videoOutputPath = path;
+        }
+        if (const char* rate = std::getenv("VULKAN_VIDEO_FPS"))
+        {
+            videoFrameRate = static_cast<uint32_t>(std::strtoul(rate, nullptr, 10));
+            if (videoFrameRate == 0)
+                throw std::runtime_error("invalid VULKAN_VIDEO_FPS value!");
+        }
+        // VULKAN_SCREENSHOT_FILE=<路径>，VULKAN_SCREENSHOT_FRAME=<帧序号>
+        if (const char* path = std::getenv("VULKAN_SCREENSHOT_FILE"))
+        {
+            screenshotPath = path;
+        }
+        if (const char* frame = std::getenv("VULKAN_SCREENSHOT_FRAME"))
+        {
+            screenshotFrame = static_cast<uint32_t>(std::strtoul(frame, nullptr, 10));
+        }
+        // VULKAN_VALIDATION=0|1，没有安装验证层的机器（如CI）上用0关闭
+        if (const char* validation = std::getenv("VULKAN_VALIDATION"))
+        {
+            enableValidationLayers = strcmp(validation, "0") != 0;
+        }
+    }
+
     
     bool checkValidationLayerSupport()
     {
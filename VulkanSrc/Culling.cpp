@@ -0,0 +1,319 @@
+#include "Culling.h"
+#include "Jobs.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULLING_X86
+#endif
+
+
+namespace Culling{
+    std::vector<float> FrustumCuller::centerX;
+    std::vector<float> FrustumCuller::centerY;
+    std::vector<float> FrustumCuller::centerZ;
+    std::vector<float> FrustumCuller::extentX;
+    std::vector<float> FrustumCuller::extentY;
+    std::vector<float> FrustumCuller::extentZ;
+    std::vector<float> FrustumCuller::radius;
+    uint32_t FrustumCuller::objectCount = 0;
+    Frustum FrustumCuller::frustum = Frustum::fromMatrix(glm::mat4(1.0f));
+    std::vector<uint32_t> FrustumCuller::visibleObjects;
+    std::vector<uint32_t> FrustumCuller::scratch;
+
+    namespace{
+        // 补齐用的对象半径为极大的负数，任何平面测试都不会通过
+        const float PADDING_RADIUS = -1e30f;
+        // 单个任务至少处理的对象数，少于该值时分发任务的开销大于剔除本身
+        const uint32_t MIN_OBJECTS_PER_JOB = 64 * 1024;
+
+        struct SoaView{
+            const float* centerX;
+            const float* centerY;
+            const float* centerZ;
+            const float* extentX;
+            const float* extentY;
+            const float* extentZ;
+            const float* radius;
+        };
+
+        // 把一个块的可见掩码展开成对象索引，写入紧凑列表
+        inline void appendVisible(uint32_t mask, uint32_t base, uint32_t* visible, uint32_t& visibleCount){
+            while (mask != 0) {
+                visible[visibleCount++] = base + static_cast<uint32_t>(__builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        void cullRangeScalar(const Frustum& frustum, const SoaView& soa, uint32_t begin, uint32_t end, uint32_t* visible, uint32_t& visibleCount){
+            for (uint32_t base = begin; base < end; base += FrustumCuller::BLOCK_SIZE) {
+                uint32_t mask = 0;
+                for (uint32_t lane = 0; lane < FrustumCuller::BLOCK_SIZE; lane++) {
+                    uint32_t i = base + lane;
+                    bool inside = true;
+                    for (const auto& plane : frustum.planes) {
+                        float distance = plane.x * soa.centerX[i] + plane.y * soa.centerY[i] + plane.z * soa.centerZ[i] + plane.w;
+                        // 包围盒在平面法线方向上的投影半径，与包围球半径取较小值
+                        float projected = std::fabs(plane.x) * soa.extentX[i] + std::fabs(plane.y) * soa.extentY[i] + std::fabs(plane.z) * soa.extentZ[i];
+                        if (distance + std::min(projected, soa.radius[i]) < 0.0f) {
+                            inside = false;
+                            break;
+                        }
+                    }
+                    mask |= static_cast<uint32_t>(inside) << lane;
+                }
+                appendVisible(mask, base, visible, visibleCount);
+            }
+        }
+
+#ifdef CULLING_X86
+        // SSE2是x86-64的基线指令集，8个对象拆成两组4宽的寄存器处理
+        void cullRangeSse(const Frustum& frustum, const SoaView& soa, uint32_t begin, uint32_t end, uint32_t* visible, uint32_t& visibleCount){
+            __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+            const __m128 signMask = _mm_set1_ps(-0.0f);
+            for (int p = 0; p < 6; p++) {
+                planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+                planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+                planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+                planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+                absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+                absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+                absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+            }
+            const __m128 zero = _mm_setzero_ps();
+
+            for (uint32_t base = begin; base < end; base += FrustumCuller::BLOCK_SIZE) {
+                uint32_t mask = 0;
+                for (uint32_t half = 0; half < 2; half++) {
+                    uint32_t i = base + half * 4;
+                    __m128 cx = _mm_loadu_ps(soa.centerX + i);
+                    __m128 cy = _mm_loadu_ps(soa.centerY + i);
+                    __m128 cz = _mm_loadu_ps(soa.centerZ + i);
+                    __m128 ex = _mm_loadu_ps(soa.extentX + i);
+                    __m128 ey = _mm_loadu_ps(soa.extentY + i);
+                    __m128 ez = _mm_loadu_ps(soa.extentZ + i);
+                    __m128 r = _mm_loadu_ps(soa.radius + i);
+
+                    __m128 inside = _mm_cmpeq_ps(zero, zero);
+                    for (int p = 0; p < 6; p++) {
+                        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                                     _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                        __m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+                        projected = _mm_min_ps(projected, r);
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, projected), zero));
+                    }
+                    mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (half * 4);
+                }
+                appendVisible(mask, base, visible, visibleCount);
+            }
+        }
+
+        // AVX2+FMA一次处理完整的8个对象，运行时检测CPU支持后才会调用
+        __attribute__((target("avx2,fma")))
+        void cullRangeAvx2(const Frustum& frustum, const SoaView& soa, uint32_t begin, uint32_t end, uint32_t* visible, uint32_t& visibleCount){
+            __m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+            const __m256 signMask = _mm256_set1_ps(-0.0f);
+            for (int p = 0; p < 6; p++) {
+                planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+                planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+                planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+                planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+                absX[p] = _mm256_andnot_ps(signMask, planeX[p]);
+                absY[p] = _mm256_andnot_ps(signMask, planeY[p]);
+                absZ[p] = _mm256_andnot_ps(signMask, planeZ[p]);
+            }
+            const __m256 zero = _mm256_setzero_ps();
+
+            for (uint32_t base = begin; base < end; base += FrustumCuller::BLOCK_SIZE) {
+                __m256 cx = _mm256_loadu_ps(soa.centerX + base);
+                __m256 cy = _mm256_loadu_ps(soa.centerY + base);
+                __m256 cz = _mm256_loadu_ps(soa.centerZ + base);
+                __m256 ex = _mm256_loadu_ps(soa.extentX + base);
+                __m256 ey = _mm256_loadu_ps(soa.extentY + base);
+                __m256 ez = _mm256_loadu_ps(soa.extentZ + base);
+                __m256 r = _mm256_loadu_ps(soa.radius + base);
+
+                __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+                for (int p = 0; p < 6; p++) {
+                    __m256 distance = _mm256_fmadd_ps(planeX[p], cx, _mm256_fmadd_ps(planeY[p], cy, _mm256_fmadd_ps(planeZ[p], cz, planeW[p])));
+                    __m256 projected = _mm256_fmadd_ps(absX[p], ex, _mm256_fmadd_ps(absY[p], ey, _mm256_mul_ps(absZ[p], ez)));
+                    projected = _mm256_min_ps(projected, r);
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, projected), zero, _CMP_GE_OQ));
+                }
+                appendVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), base, visible, visibleCount);
+            }
+        }
+#endif
+
+        using CullRangeFunc = void (*)(const Frustum&, const SoaView&, uint32_t, uint32_t, uint32_t*, uint32_t&);
+
+        CullRangeFunc selectKernel(FrustumCuller::Kernel kernel){
+#ifdef CULLING_X86
+            __builtin_cpu_init();
+            bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            switch (kernel) {
+                case FrustumCuller::Kernel::Scalar:
+                    return cullRangeScalar;
+                case FrustumCuller::Kernel::Sse:
+                    return cullRangeSse;
+                default:
+                    // 强制AVX2但CPU不支持时退回SSE
+                    return avx2 ? cullRangeAvx2 : cullRangeSse;
+            }
+#else
+            return cullRangeScalar;
+#endif
+        }
+
+        CullRangeFunc activeKernel = selectKernel(FrustumCuller::Kernel::Auto);
+
+        glm::vec4 normalizePlane(glm::vec4 plane){
+            float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+            return glm::vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+        }
+
+        void pushPadding(std::vector<float>& values, float value){
+            values.insert(values.end(), FrustumCuller::BLOCK_SIZE, value);
+        }
+    }
+
+    Frustum Frustum::fromMatrix(const glm::mat4& m){
+        // glm为列主序，m[列][行]，按行取出矩阵后用Gribb-Hartmann方法组合出平面
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = normalizePlane(row3 + row0); // 左
+        frustum.planes[1] = normalizePlane(row3 - row0); // 右
+        frustum.planes[2] = normalizePlane(row3 + row1); // 下
+        frustum.planes[3] = normalizePlane(row3 - row1); // 上
+        frustum.planes[4] = normalizePlane(row2);        // 近，vulkan深度从0开始
+        frustum.planes[5] = normalizePlane(row3 - row2); // 远
+        return frustum;
+    }
+
+    uint32_t FrustumCuller::addSphere(glm::vec3 center, float sphereRadius){
+        // 数组末尾始终保留一个补齐块，新对象覆盖补齐块的第一个位置
+        if (objectCount % BLOCK_SIZE == 0) {
+            pushPadding(centerX, 0.0f);
+            pushPadding(centerY, 0.0f);
+            pushPadding(centerZ, 0.0f);
+            pushPadding(extentX, 0.0f);
+            pushPadding(extentY, 0.0f);
+            pushPadding(extentZ, 0.0f);
+            pushPadding(radius, PADDING_RADIUS);
+        }
+        uint32_t index = objectCount++;
+        updateSphere(index, center, sphereRadius);
+        return index;
+    }
+
+    uint32_t FrustumCuller::addBox(glm::vec3 minCorner, glm::vec3 maxCorner){
+        uint32_t index = addSphere(glm::vec3(0.0f, 0.0f, 0.0f), 0.0f);
+        updateBox(index, minCorner, maxCorner);
+        return index;
+    }
+
+    void FrustumCuller::updateSphere(uint32_t index, glm::vec3 center, float sphereRadius){
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        // 球的外接盒半长等于半径，取较小值后退化为纯球测试
+        extentX[index] = sphereRadius;
+        extentY[index] = sphereRadius;
+        extentZ[index] = sphereRadius;
+        radius[index] = sphereRadius;
+    }
+
+    void FrustumCuller::updateBox(uint32_t index, glm::vec3 minCorner, glm::vec3 maxCorner){
+        float hx = (maxCorner.x - minCorner.x) * 0.5f;
+        float hy = (maxCorner.y - minCorner.y) * 0.5f;
+        float hz = (maxCorner.z - minCorner.z) * 0.5f;
+        centerX[index] = minCorner.x + hx;
+        centerY[index] = minCorner.y + hy;
+        centerZ[index] = minCorner.z + hz;
+        extentX[index] = hx;
+        extentY[index] = hy;
+        extentZ[index] = hz;
+        // 盒的外接球半径不小于投影半径，取较小值后退化为纯AABB测试
+        radius[index] = std::sqrt(hx * hx + hy * hy + hz * hz);
+    }
+
+    uint32_t FrustumCuller::getObjectCount(){
+        return objectCount;
+    }
+
+    void FrustumCuller::clear(){
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        extentX.clear();
+        extentY.clear();
+        extentZ.clear();
+        radius.clear();
+        objectCount = 0;
+        visibleObjects.clear();
+    }
+
+    void FrustumCuller::setViewProjection(const glm::mat4& viewProjection){
+        frustum = Frustum::fromMatrix(viewProjection);
+    }
+
+    void FrustumCuller::setKernel(Kernel kernel){
+        activeKernel = selectKernel(kernel);
+    }
+
+    void FrustumCuller::cullRange(const Frustum& cullFrustum, uint32_t begin, uint32_t end, uint32_t* visible, uint32_t& visibleCount){
+        SoaView soa{centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), radius.data()};
+        activeKernel(cullFrustum, soa, begin, end, visible, visibleCount);
+    }
+
+    const std::vector<uint32_t>& FrustumCuller::cull(uint32_t threadCount){
+        uint32_t blockCount = (objectCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        uint32_t paddedCount = blockCount * BLOCK_SIZE;
+        // 每个任务先把结果写到自己区间的起始处，最后再拼接成连续的列表
+        if (scratch.size() < paddedCount) {
+            scratch.resize(paddedCount);
+        }
+        visibleObjects.clear();
+        if (blockCount == 0) {
+            return visibleObjects;
+        }
+
+        if (threadCount == 0) {
+            threadCount = std::min(Jobs::JobSystem::getWorkerCount(), (objectCount + MIN_OBJECTS_PER_JOB - 1) / MIN_OBJECTS_PER_JOB);
+        }
+        threadCount = std::max(1u, std::min(threadCount, blockCount));
+        uint32_t blocksPerThread = (blockCount + threadCount - 1) / threadCount;
+        std::vector<uint32_t> counts(threadCount, 0);
+
+        Jobs::JobSystem::parallelFor(threadCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk){
+            for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+                uint32_t begin = chunk * blocksPerThread * BLOCK_SIZE;
+                uint32_t end = std::min(paddedCount, begin + blocksPerThread * BLOCK_SIZE);
+                if (begin < end) {
+                    cullRange(frustum, begin, end, scratch.data() + begin, counts[chunk]);
+                }
+            }
+        });
+
+        for (uint32_t chunk = 0; chunk < threadCount; chunk++) {
+            const uint32_t* chunkBegin = scratch.data() + chunk * blocksPerThread * BLOCK_SIZE;
+            visibleObjects.insert(visibleObjects.end(), chunkBegin, chunkBegin + counts[chunk]);
+        }
+        return visibleObjects;
+    }
+
+    const std::vector<uint32_t>& FrustumCuller::getVisible(){
+        return visibleObjects;
+    }
+
+    bool FrustumCuller::isVisible(uint32_t index){
+        // 可见列表按索引升序生成，可以直接二分查找
+        return std::binary_search(visibleObjects.begin(), visibleObjects.end(), index);
+    }
+}
@@ -0,0 +1,224 @@
+#include "Descriptor.h"
+#include "Bindless.h"
+#include "Device.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+
+namespace Descriptor{
+    void DoInit(){
+        BindlessHeap::createHeap();
+    }
+
+    void cleanup(){
+        BindlessHeap::cleanup();
+        PipelineLayoutCache::cleanup();
+        LayoutCache::cleanup();
+    }
+
+    namespace{
+        inline void hashCombine(size_t& seed, size_t value){
+            seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+        }
+    }
+
+    void writeDescriptorSet(VkDescriptorSet descriptorSet, const std::vector<DescriptorBinding>& bindings){
+        std::vector<VkWriteDescriptorSet> writes;
+        writes.reserve(bindings.size());
+
+        for (const auto& binding : bindings) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = descriptorSet;
+            write.dstBinding = binding.binding;
+            write.dstArrayElement = binding.arrayElement;
+            write.descriptorCount = 1;
+            write.descriptorType = binding.type;
+            switch (binding.type) {
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                    write.pImageInfo = &binding.imageInfo;
+                    break;
+                default:
+                    write.pBufferInfo = &binding.bufferInfo;
+                    break;
+            }
+            writes.push_back(write);
+        }
+
+        vkUpdateDescriptorSets(Device::VulkanDevice::getLogicalDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    std::unordered_map<LayoutCache::LayoutKey, VkDescriptorSetLayout, LayoutCache::LayoutKeyHash> LayoutCache::layouts;
+    std::mutex LayoutCache::cacheLock;
+
+    bool LayoutCache::LayoutKey::operator==(const LayoutKey& other) const{
+        if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags) {
+            return false;
+        }
+        for (size_t i = 0; i < bindings.size(); i++) {
+            const auto& a = bindings[i];
+            const auto& b = other.bindings[i];
+            if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+                a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) {
+                return false;
+            }
+            if ((a.pImmutableSamplers == nullptr) != (b.pImmutableSamplers == nullptr)) {
+                return false;
+            }
+            if (a.pImmutableSamplers != nullptr && !std::equal(a.pImmutableSamplers, a.pImmutableSamplers + a.descriptorCount, b.pImmutableSamplers)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t LayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const{
+        size_t seed = std::hash<uint32_t>{}(key.flags);
+        for (const auto& binding : key.bindings) {
+            // 把绑定点，类型，数量和着色器阶段打包成一个64位值
+            uint64_t packed = static_cast<uint64_t>(binding.binding) |
+                (static_cast<uint64_t>(binding.descriptorType) << 16) |
+                (static_cast<uint64_t>(binding.descriptorCount) << 24) |
+                (static_cast<uint64_t>(binding.stageFlags) << 48);
+            hashCombine(seed, std::hash<uint64_t>{}(packed));
+            if (binding.pImmutableSamplers != nullptr) {
+                for (uint32_t i = 0; i < binding.descriptorCount; i++) {
+                    hashCombine(seed, std::hash<VkSampler>{}(binding.pImmutableSamplers[i]));
+                }
+            }
+        }
+        for (auto bindingFlag : key.bindingFlags) {
+            hashCombine(seed, std::hash<uint32_t>{}(bindingFlag));
+        }
+        return seed;
+    }
+
+    VkDescriptorSetLayout LayoutCache::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags,
+                                                 const std::vector<VkDescriptorBindingFlags>& bindingFlags){
+        if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+            throw std::runtime_error("descriptor binding flags do not match the binding list!");
+        }
+
+        // 按绑定点排序，使不同顺序的相同绑定列表命中同一个布局，绑定标志随之一起重排
+        std::vector<size_t> order(bindings.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&bindings](size_t a, size_t b){ return bindings[a].binding < bindings[b].binding; });
+
+        LayoutKey key{};
+        key.flags = flags;
+        key.bindings.reserve(bindings.size());
+        key.bindingFlags.reserve(bindingFlags.size());
+        for (size_t index : order) {
+            key.bindings.push_back(bindings[index]);
+            if (!bindingFlags.empty()) {
+                key.bindingFlags.push_back(bindingFlags[index]);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(cacheLock);
+        auto it = layouts.find(key);
+        if (it != layouts.end()) {
+            return it->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.flags = flags;
+        layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+        layoutInfo.pBindings = key.bindings.data();
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        if (!key.bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+            layoutInfo.pNext = &bindingFlagsInfo;
+        }
+
+        VkDescriptorSetLayout layout;
+        if (vkCreateDescriptorSetLayout(Device::VulkanDevice::getLogicalDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        layouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    void LayoutCache::cleanup(){
+        std::lock_guard<std::mutex> guard(cacheLock);
+        for (auto& entry : layouts) {
+            vkDestroyDescriptorSetLayout(Device::VulkanDevice::getLogicalDevice(), entry.second, nullptr);
+        }
+        layouts.clear();
+    }
+
+    std::unordered_map<PipelineLayoutCache::LayoutKey, VkPipelineLayout, PipelineLayoutCache::LayoutKeyHash> PipelineLayoutCache::layouts;
+    std::mutex PipelineLayoutCache::cacheLock;
+
+    bool PipelineLayoutCache::LayoutKey::operator==(const LayoutKey& other) const{
+        if (setLayouts != other.setLayouts || pushConstantRanges.size() != other.pushConstantRanges.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < pushConstantRanges.size(); i++) {
+            const auto& a = pushConstantRanges[i];
+            const auto& b = other.pushConstantRanges[i];
+            if (a.stageFlags != b.stageFlags || a.offset != b.offset || a.size != b.size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t PipelineLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const{
+        size_t seed = std::hash<size_t>{}(key.setLayouts.size());
+        for (VkDescriptorSetLayout setLayout : key.setLayouts) {
+            hashCombine(seed, std::hash<VkDescriptorSetLayout>{}(setLayout));
+        }
+        for (const auto& range : key.pushConstantRanges) {
+            uint64_t packed = static_cast<uint64_t>(range.offset) | (static_cast<uint64_t>(range.size) << 32);
+            hashCombine(seed, std::hash<uint64_t>{}(packed));
+            hashCombine(seed, std::hash<uint32_t>{}(range.stageFlags));
+        }
+        return seed;
+    }
+
+    VkPipelineLayout PipelineLayoutCache::getLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                    const std::vector<VkPushConstantRange>& pushConstantRanges){
+        // 集合布局已由LayoutCache去重，句柄相同即布局相同
+        LayoutKey key{setLayouts, pushConstantRanges};
+        std::lock_guard<std::mutex> guard(cacheLock);
+        auto it = layouts.find(key);
+        if (it != layouts.end()) {
+            return it->second;
+        }
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+        layoutInfo.pSetLayouts = key.setLayouts.data();
+        layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(key.pushConstantRanges.size());
+        layoutInfo.pPushConstantRanges = key.pushConstantRanges.data();
+
+        VkPipelineLayout layout;
+        if (vkCreatePipelineLayout(Device::VulkanDevice::getLogicalDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        layouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
+    void PipelineLayoutCache::cleanup(){
+        std::lock_guard<std::mutex> guard(cacheLock);
+        for (auto& entry : layouts) {
+            vkDestroyPipelineLayout(Device::VulkanDevice::getLogicalDevice(), entry.second, nullptr);
+        }
+        layouts.clear();
+    }
+}
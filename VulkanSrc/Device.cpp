@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <cstring>
 
 namespace Device
 {
@@ -15,6 +16,7 @@ namespace Device
     VkSurfaceKHR VulkanDevice::surface = VK_NULL_HANDLE;
     VkQueue VulkanDevice::graphicsQueue = VK_NULL_HANDLE;
     VkQueue VulkanDevice::presentQueue = VK_NULL_HANDLE;
+    bool VulkanDevice::bindlessSupported = false;
 
     void DoInit()
     {
@@ -66,6 +68,24 @@ namespace Device
         return requiredExtensions.empty();
     }
 
+    bool VulkanDevice::isExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto &extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, extensionName) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device)
     {
         QueueFamilyIndices indices;
@@ -106,6 +126,18 @@ namespace Device
 
     void VulkanDevice::CreateSurface()
     {
+        if (Config::headless)
+        {
+            // 无窗口模式下的surface不显示任何内容，但交换链的获取和呈现流程与窗口模式相同
+            auto createHeadlessSurface = (PFN_vkCreateHeadlessSurfaceEXT) vkGetInstanceProcAddr(Init::Instance::GetInstance(), "vkCreateHeadlessSurfaceEXT");
+            VkHeadlessSurfaceCreateInfoEXT createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+            if (createHeadlessSurface == nullptr || createHeadlessSurface(Init::Instance::GetInstance(), &createInfo, nullptr, &surface) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create headless surface!");
+            }
+            return;
+        }
         // surface是用于连接vulkan和window系统的中间层,可以用于vulkan呈现画面
         if (glfwCreateWindowSurface(Init::Instance::GetInstance(), Init::GlfwWindow::getGlfwWindow(), nullptr, &surface) != VK_SUCCESS)
         {
@@ -165,20 +197,94 @@ namespace Device
         }
 
         // 设置逻辑设备创建信息
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+        // 描述符索引和时间线信号量在1.2中成为核心功能，更低版本的设备需要对应的扩展
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        bool core12 = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+        bool indexingExtension = !core12 && isExtensionSupported(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        bool timelineExtension = !core12 && isExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+        // 扩展特性挂在VkPhysicalDeviceFeatures2的pNext链上一起查询，设备不支持的结构不能放进链里
+        VkPhysicalDeviceFeatures2 deviceFeatures2{};
+        deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        VkPhysicalDeviceTimelineSemaphoreFeatures supportedTimeline{};
+        supportedTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        if (core12 || timelineExtension)
+        {
+            supportedTimeline.pNext = deviceFeatures2.pNext;
+            deviceFeatures2.pNext = &supportedTimeline;
+        }
+        VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+        supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        if (core12 || indexingExtension)
+        {
+            supportedIndexing.pNext = deviceFeatures2.pNext;
+            deviceFeatures2.pNext = &supportedIndexing;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+
+        std::vector<const char *> enabledExtensions(Config::deviceExtensions.begin(), Config::deviceExtensions.end());
+
+        // bindless只需要部分绑定，运行时数组，非统一索引和绑定后更新这几项
+        bindlessSupported = (core12 || indexingExtension) &&
+                            supportedIndexing.runtimeDescriptorArray &&
+                            supportedIndexing.descriptorBindingPartiallyBound &&
+                            supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+                            supportedIndexing.descriptorBindingSampledImageUpdateAfterBind &&
+                            supportedIndexing.descriptorBindingStorageBufferUpdateAfterBind &&
+                            supportedIndexing.shaderSampledImageArrayNonUniformIndexing &&
+                            supportedIndexing.shaderStorageBufferArrayNonUniformIndexing;
+
+        VkPhysicalDeviceDescriptorIndexingFeatures enabledIndexing{};
+        enabledIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        if (bindlessSupported)
+        {
+            enabledIndexing.runtimeDescriptorArray = VK_TRUE;
+            enabledIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+            enabledIndexing.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            enabledIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            enabledIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            enabledIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            enabledIndexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+            if (indexingExtension)
+            {
+                enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            }
+        }
+
+        // 帧同步和资源回收都依赖时间线信号量
+        if (!(core12 || timelineExtension) || !supportedTimeline.timelineSemaphore)
+        {
+            throw std::runtime_error("timeline semaphores are not supported by the physical device!");
+        }
+        if (timelineExtension)
+        {
+            enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
+        VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimeline{};
+        enabledTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        enabledTimeline.timelineSemaphore = VK_TRUE;
+        enabledTimeline.pNext = bindlessSupported ? &enabledIndexing : nullptr;
+
+        // 核心特性沿用查询到的全部特性，扩展特性通过pNext链启用
+        VkPhysicalDeviceFeatures2 enabledFeatures2{};
+        enabledFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        enabledFeatures2.features = deviceFeatures2.features;
+        enabledFeatures2.pNext = &enabledTimeline;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &enabledFeatures2;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        // 使用VkPhysicalDeviceFeatures2时pEnabledFeatures必须为空
+        createInfo.pEnabledFeatures = nullptr;
 
         // 添加设备扩展，如：swapchain扩展
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(Config::deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = Config::deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // createInfo.enabledExtensionCount = 0;  这里复制粘贴代码的时候少删了，导致查了很久，不知道是什么问题
 
@@ -233,6 +339,10 @@ namespace Device
     {
         return presentQueue;
     }
+    bool VulkanDevice::isBindlessSupported()
+    {
+        return bindlessSupported;
+    }
     void VulkanDevice::cleanup()
     {
         vkDestroyDevice(device, nullptr);
@@ -4,6 +4,18 @@
 #include "Present.h"
 #include "Config.h"
 #include "MeshData.h"
+#include "Descriptor.h"
+#include "Bindless.h"
+#include "Culling.h"
+#include "Scene.h"
+#include "FramePacer.h"
+#include "Sync.h"
+#include "GpuProfiler.h"
+#include "PipelineStats.h"
+#include "Trace.h"
+#include "Capture.h"
+#include "Readback.h"
+#include "ShaderReload.h"
 
 #include <stdexcept>
 
@@ -14,6 +26,7 @@ namespace DrawSpace{
         Mesh::DoInit();
         createCommandBuffers();
         createSyncObjects();
+        Pacing::FramePacer::setLatencyMode(Config::enableLowLatencyMode);
     }
 
 
@@ -21,7 +34,8 @@ namespace DrawSpace{
     std::vector<VkCommandBuffer> CommondFactory::commandBuffers;
     std::vector<VkSemaphore> CommondFactory::imageAvailableSemaphores;
     std::vector<VkSemaphore> CommondFactory::renderFinishedSemaphores;
-    std::vector<VkFence> CommondFactory::inFlightFences;
+    std::vector<uint64_t> CommondFactory::frameTimelineValues;
+    std::function<void(VkCommandBuffer)> CommondFactory::sceneRecorder;
 
     VkCommandPool CommondFactory::getCommandPool(){
         return commandPool;
@@ -57,6 +71,7 @@ namespace DrawSpace{
     }
 
     void CommondFactory::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        TRACE_SCOPE("recordCommandBuffer");
         // 用于设置命令缓冲区的使用方法，当前命令缓冲区状态，如何继承主命令缓冲区的状态
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -64,7 +79,14 @@ namespace DrawSpace{
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
+        // 回读该槽位上一次的时间戳并重置查询池，必须在render pass之外
+        Profiling::GpuProfiler::beginFrame(commandBuffer, Pacing::FramePacer::getFrameIndex());
+        Profiling::PipelineStatistics::beginFrame(commandBuffer, Pacing::FramePacer::getFrameIndex());
+        Profiling::GpuProfiler::beginScope(commandBuffer, "frame");
         VkExtent2D swapChainExtent = Presentation::SwapChain::getSwapChainExtent();
+        // 捕获时记录帧边界和该帧实例数据的变化
+        Capture::Recorder::beginFrame(swapChainExtent, Scene::InstanceStream::getFrameData(Pacing::FramePacer::getFrameIndex()),
+                                      Scene::InstanceStream::getSlotCount());
         // 开始一个render pass实例，指定使用哪个render pass对象和framebuffer对象。
         // 遍历render pass中的每个subpass，记录该subpass的渲染命令。
         // 结束render pass实例，完成渲染过程。
@@ -82,8 +104,15 @@ namespace DrawSpace{
         renderPassInfo.pClearValues = &clearColor;
 
         // 传输vkCmd*命令，绘制图像
+        Profiling::GpuProfiler::beginScope(commandBuffer, "main pass");
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // 记录renderPass中第一个subpass的命令，指定了颜色附件
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineData::Pipeline::getGraphicPipeline());
+        Capture::cmdBindPipeline(commandBuffer, PipelineData::Pipeline::getGraphicPipeline());
+
+        // bindless模式下整个命令缓冲区只绑定一次描述符集，之后的绘制只更新push constant中的索引
+        bool bindless = Descriptor::BindlessHeap::isEnabled();
+        if (bindless) {
+            Descriptor::BindlessHeap::bind(commandBuffer, PipelineData::Pipeline::getPipelineLayout());
+        }
 
         // 视口定义了窗口中图像显示的区域
         VkViewport viewport{};
@@ -101,6 +130,31 @@ namespace DrawSpace{
         scissor.extent = swapChainExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
+        // 设置了场景录制函数时由它负责绑定管线和录制绘制命令
+        if (sceneRecorder) {
+            sceneRecorder(commandBuffer);
+        } else {
+            recordDefaultScene(commandBuffer);
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+        Profiling::GpuProfiler::endScope(commandBuffer);  // main pass
+        // 回读在render pass之外复制交换链图像，结果在该槽位下次使用时交给回调
+        if (Readback::FrameReadback::isEnabled()) {
+            Profiling::GpuScope readbackScope(commandBuffer, "readback");
+            Readback::FrameReadback::recordCopy(commandBuffer, Pacing::FramePacer::getFrameIndex(),
+                                                Presentation::SwapChain::getSwapChainImage(imageIndex), swapChainExtent,
+                                                Presentation::SwapChain::getSwapChainImageFormat());
+        }
+        Profiling::GpuProfiler::endScope(commandBuffer);  // frame
+        // 结束命令传输，下一步可以执行提交命令
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        Capture::Recorder::endFrame();
+    }
+
+    void CommondFactory::recordDefaultScene(VkCommandBuffer commandBuffer) {
         // vkCmdDraw函数接受以下几个参数：
 
         // commandBuffer，表示要记录命令的command buffer对象。
@@ -110,75 +164,94 @@ namespace DrawSpace{
         // firstInstance，表示从实例缓冲区中的哪个位置开始读取实例数据。实例缓冲区是一种存储每个实例的特定数据的缓冲区，例如变换矩阵或者颜色
         // vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-        VkBuffer vertexBuffers[] = {Mesh::SimpleMesh::getVertexBuffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        Capture::cmdBindVertexBuffer(commandBuffer, Mesh::SimpleMesh::getVertexBuffer(), 0);
 
-        vkCmdBindIndexBuffer(commandBuffer, Mesh::SimpleMesh::getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+        Capture::cmdBindIndexBuffer(commandBuffer, Mesh::SimpleMesh::getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
 
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(Mesh::SimpleMesh::getIndices().size()), 1, 0, 0, 0);
-
-        vkCmdEndRenderPass(commandBuffer);
-        // 结束命令传输，下一步可以执行提交命令
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+        if (Descriptor::BindlessHeap::isEnabled()) {
+            Descriptor::BindlessPushConstants pushConstants{};
+            pushConstants.instanceBufferIndex = Scene::InstanceStream::getCurrentBufferIndex();
+            pushConstants.firstInstance = Scene::SceneGraph::getInstanceIndex(Mesh::SimpleMesh::getSceneNode());
+            pushConstants.textureIndex = Descriptor::BindlessHeap::INVALID_INDEX;
+            pushConstants.samplerIndex = Descriptor::BindlessHeap::INVALID_INDEX;
+            Capture::cmdPushConstants(commandBuffer, PipelineData::Pipeline::getPipelineLayout(),
+                                      Descriptor::BindlessHeap::getPushConstantRange().stageFlags, 0, sizeof(pushConstants), &pushConstants);
         }
+        // 只为通过视锥剔除的网格录制绘制命令
+        if (Culling::FrustumCuller::isVisible(Mesh::SimpleMesh::getCullIndex())) {
+            Profiling::GpuScope meshScope(commandBuffer, "mesh");
+            Profiling::PipelineStatistics::beginDraw(commandBuffer);
+            Capture::cmdDrawIndexed(commandBuffer, static_cast<uint32_t>(Mesh::SimpleMesh::getIndices().size()), 1, 0, 0, 0);
+            Profiling::PipelineStatistics::endDraw(commandBuffer);
+        }
+    }
+
+    void CommondFactory::setSceneRecorder(std::function<void(VkCommandBuffer)> recorder) {
+        sceneRecorder = std::move(recorder);
     }
 
     void CommondFactory::createSyncObjects() {
         imageAvailableSemaphores.resize(Config::MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(Config::MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(Config::MAX_FRAMES_IN_FLIGHT);
+        // 时间线初始值为0，值为0的帧视为已经完成，第一次使用时不需要等待
+        frameTimelineValues.assign(Config::MAX_FRAMES_IN_FLIGHT, 0);
 
+        // 交换链的获取和呈现只接受二值信号量，帧之间的CPU等待改用图形队列的时间线
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
         for (size_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
             if (vkCreateSemaphore(Device::VulkanDevice::getLogicalDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(Device::VulkanDevice::getLogicalDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(Device::VulkanDevice::getLogicalDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                vkCreateSemaphore(Device::VulkanDevice::getLogicalDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
     }
 
     void CommondFactory::drawFrame() {
-        static u_int32_t currentFrame = 1;
-        // 等待上一帧的绘制命令是否完成，即当前命令缓冲区是否可用。可用的话就重置fence
-        vkWaitForFences(Device::VulkanDevice::getLogicalDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-        vkResetFences(Device::VulkanDevice::getLogicalDevice(), 1, &inFlightFences[currentFrame]);
+        TRACE_SCOPE("drawFrame");
+        uint32_t currentFrame = Pacing::FramePacer::getFrameIndex();
+        // 等待上次使用该槽位的帧在GPU上执行完毕，即当前命令缓冲区是否可用
+        Pacing::FramePacer::beginFenceWait();
+        Sync::Timeline::wait(Sync::Graphics, frameTimelineValues[currentFrame]);
+        Pacing::FramePacer::endFenceWait();
+        // 该槽位上次复制的图像已经可以读取
+        Readback::FrameReadback::collect(currentFrame);
+        // 销毁GPU已经不再使用的旧对象
+        Sync::DeletionQueue::collect();
+        // 热重载编译好的管线在录制前换上，本帧之后的命令都使用新管线
+        ShaderReload::ShaderWatcher::applyPending();
+
+        // 采样输入，低延迟模式下会先等到接近GPU空闲的时刻
+        Pacing::FramePacer::waitForLatencyTarget();
 
         // 获取交换链中下一个可用的图像，并在相应图像缓冲区中执行绘制操作
         uint32_t imageIndex;
-        vkAcquireNextImageKHR(Device::VulkanDevice::getLogicalDevice(), Presentation::SwapChain::getSwapChain(),
+        VkResult result = vkAcquireNextImageKHR(Device::VulkanDevice::getLogicalDevice(), Presentation::SwapChain::getSwapChain(),
                              UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // 交换链已经不能使用，信号量没有被点亮，重建后跳过这一帧
+            Presentation::SwapChain::recreateSwapChain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+
+        // 该帧的实例数据段已不再被GPU读取，更新场景变换并写入
+        Scene::SceneGraph::update(currentFrame);
+
+        // 录制前先剔除视锥外的对象
+        Culling::FrustumCuller::cull();
 
         // 重置命令缓冲区，并传输命令
         vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
         recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;  // 设置在哪个阶段等待信号量，当前值表示在颜色附件输出阶段等待从交换链中获取图像缓冲区
-
+        // 在颜色附件输出阶段等待从交换链中获取图像，执行完成后点亮呈现用的信号量，并推进图形队列的时间线
         VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;  // 设置执行完成后点亮的信号量
-        // 提交队列中的命令缓冲区，并设置fence用于命令执行结束后执行绘制下一帧
-        if (vkQueueSubmit(Device::VulkanDevice::getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
-        }
+        frameTimelineValues[currentFrame] = Sync::Timeline::submit(Sync::Graphics, {commandBuffers[currentFrame]},
+            {{imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
+            {renderFinishedSemaphores[currentFrame]});
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -192,9 +265,17 @@ namespace DrawSpace{
 
         presentInfo.pImageIndices = &imageIndex;
 
-        vkQueuePresentKHR(Device::VulkanDevice::getPresentQueue(), &presentInfo);
+        result = vkQueuePresentKHR(Device::VulkanDevice::getPresentQueue(), &presentInfo);
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+
+        Pacing::FramePacer::endFrame();
 
-        currentFrame = (currentFrame + 1) % Config::MAX_FRAMES_IN_FLIGHT;
+        // 呈现之后再重建，本帧已经提交的工作不受影响
+        if (result != VK_SUCCESS || Presentation::SwapChain::isRecreateRequested()) {
+            Presentation::SwapChain::recreateSwapChain();
+        }
     }
 
     void CommondFactory::cleanup(){
@@ -202,7 +283,6 @@ namespace DrawSpace{
         for (size_t i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(Device::VulkanDevice::getLogicalDevice(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(Device::VulkanDevice::getLogicalDevice(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(Device::VulkanDevice::getLogicalDevice(), inFlightFences[i], nullptr);
         }
         vkDestroyCommandPool(Device::VulkanDevice::getLogicalDevice(), commandPool, nullptr);
     }
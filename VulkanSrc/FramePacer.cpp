@@ -0,0 +1,152 @@
+#include "FramePacer.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <thread>
+
+
+namespace Pacing{
+    uint32_t FramePacer::frameIndex = 0;
+    uint64_t FramePacer::frameNumber = 0;
+    bool FramePacer::latencyMode = false;
+    uint32_t FramePacer::queuedFrames = 0;
+    std::function<void()> FramePacer::inputSampler;
+    RollingWindow FramePacer::windows[static_cast<int>(FramePacer::Metric::Count)];
+    FramePacer::Clock::time_point FramePacer::fenceWaitStart;
+    FramePacer::Clock::time_point FramePacer::workStart;
+    FramePacer::Clock::time_point FramePacer::lastPresent;
+
+    namespace{
+        // 预测有误差，提前这么多毫秒醒来，宁可GPU短暂空闲也不要错过呈现时机
+        const double LATENCY_SAFETY_MARGIN = 0.5;
+        // 睡眠精度不够，最后这段时间改为自旋等待
+        const double SPIN_THRESHOLD = 1.0;
+
+        double toMilliseconds(std::chrono::steady_clock::duration duration){
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+    }
+
+    RollingWindow::RollingWindow(uint32_t capacity) : samples(std::max(1u, capacity), 0.0), next(0), count(0) {}
+
+    void RollingWindow::add(double sample){
+        samples[next] = sample;
+        next = (next + 1) % samples.size();
+        count = std::min<uint32_t>(count + 1, static_cast<uint32_t>(samples.size()));
+    }
+
+    void RollingWindow::resize(uint32_t capacity){
+        samples.assign(std::max(1u, capacity), 0.0);
+        next = 0;
+        count = 0;
+    }
+
+    uint32_t RollingWindow::size() const{
+        return count;
+    }
+
+    Percentiles RollingWindow::compute() const{
+        Percentiles result;
+        if (count == 0) {
+            return result;
+        }
+        std::vector<double> sorted(samples.begin(), samples.begin() + count);
+        std::sort(sorted.begin(), sorted.end());
+        // 最近秩法
+        auto rank = [&](double percentile){
+            size_t index = static_cast<size_t>(percentile * count + 0.999999);
+            return sorted[std::min<size_t>(std::max<size_t>(index, 1), count) - 1];
+        };
+        result.p50 = rank(0.50);
+        result.p95 = rank(0.95);
+        result.p99 = rank(0.99);
+        return result;
+    }
+
+    void FramePacer::beginFenceWait(){
+        fenceWaitStart = Clock::now();
+    }
+
+    void FramePacer::endFenceWait(){
+        Clock::time_point now = Clock::now();
+        windows[static_cast<int>(Metric::FenceWait)].add(toMilliseconds(now - fenceWaitStart));
+        workStart = now;
+    }
+
+    void FramePacer::waitForLatencyTarget(){
+        RollingWindow& intervals = windows[static_cast<int>(Metric::PresentInterval)];
+        RollingWindow& cpuTimes = windows[static_cast<int>(Metric::CpuTime)];
+        if (latencyMode && intervals.size() > 0 && cpuTimes.size() > 0) {
+            // 上一帧呈现后再过一个典型帧间隔，GPU就能处理下一帧；减去较慢情况下的CPU耗时就是最晚的开始时刻
+            double interval = intervals.compute().p50;
+            double cpuTime = cpuTimes.compute().p95;
+            double delay = std::min(interval, std::max(0.0, interval - cpuTime - LATENCY_SAFETY_MARGIN));
+            Clock::time_point target = lastPresent + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::milli>(delay));
+
+            Clock::time_point now = Clock::now();
+            if (target > now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(SPIN_THRESHOLD))) {
+                std::this_thread::sleep_until(target - std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(SPIN_THRESHOLD)));
+            }
+            while (Clock::now() < target) {
+                std::this_thread::yield();
+            }
+            workStart = Clock::now();
+        }
+
+        if (inputSampler) {
+            inputSampler();
+        }
+    }
+
+    void FramePacer::endFrame(){
+        Clock::time_point now = Clock::now();
+        double cpuTime = toMilliseconds(now - workStart);
+        windows[static_cast<int>(Metric::CpuTime)].add(cpuTime);
+        if (frameNumber > 0) {
+            double interval = toMilliseconds(now - lastPresent);
+            windows[static_cast<int>(Metric::PresentInterval)].add(interval);
+            // 逐帧计算后再取百分位；分别取两个分布的百分位再相加得到的不是任何一帧的延迟
+            windows[static_cast<int>(Metric::ModeledLatency)].add(cpuTime + (queuedFrames + 1.0) * interval);
+        }
+        lastPresent = now;
+
+        frameNumber++;
+        frameIndex = (frameIndex + 1) % Config::MAX_FRAMES_IN_FLIGHT;
+    }
+
+    uint32_t FramePacer::getFrameIndex(){
+        return frameIndex;
+    }
+
+    uint64_t FramePacer::getFrameNumber(){
+        return frameNumber;
+    }
+
+    void FramePacer::setLatencyMode(bool enabled){
+        latencyMode = enabled;
+    }
+
+    bool FramePacer::isLatencyModeEnabled(){
+        return latencyMode;
+    }
+
+    void FramePacer::setInputSampler(std::function<void()> sampler){
+        inputSampler = std::move(sampler);
+    }
+
+    void FramePacer::setQueuedFrames(uint32_t frames){
+        queuedFrames = frames;
+    }
+
+    void FramePacer::setWindowSize(uint32_t frameCount){
+        for (auto& window : windows) {
+            window.resize(frameCount);
+        }
+    }
+
+    Percentiles FramePacer::getPercentiles(Metric metric){
+        return windows[static_cast<int>(metric)].compute();
+    }
+}
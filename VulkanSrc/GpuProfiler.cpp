@@ -0,0 +1,188 @@
+#include "GpuProfiler.h"
+#include "PipelineStats.h"
+#include "Device.h"
+#include "Config.h"
+#include "FramePacer.h"
+
+#include <stdexcept>
+
+
+namespace Profiling{
+    std::vector<GpuProfiler::FrameQueries> GpuProfiler::frames;
+    uint32_t GpuProfiler::currentFrame = 0;
+    std::vector<uint32_t> GpuProfiler::scopeStack;
+    double GpuProfiler::timestampPeriod = 1.0;
+    uint64_t GpuProfiler::timestampMask = ~0ull;
+    std::vector<uint64_t> GpuProfiler::results;
+    std::vector<ScopeTiming> GpuProfiler::frameTimings;
+    uint64_t GpuProfiler::timingsFrameNumber = 0;
+
+    namespace{
+        // 每个区间占用开始和结束两个查询
+        const uint32_t MAX_QUERIES_PER_FRAME = 512;
+        const uint32_t NO_PARENT = 0xFFFFFFFF;
+    }
+
+    void DoInit(){
+        GpuProfiler::createQueryPools();
+        PipelineStatistics::createQueryPools();
+    }
+
+    void cleanup(){
+        GpuProfiler::cleanup();
+        PipelineStatistics::cleanup();
+    }
+
+    void GpuProfiler::createQueryPools(){
+        VkPhysicalDevice physicalDevice = Device::VulkanDevice::getPhysicalDevice();
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        // 图形队列族的时间戳有效位数为0时不支持时间戳，分析器保持关闭
+        Device::QueueFamilyIndices indices = Device::VulkanDevice::findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        uint32_t validBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+        if (validBits == 0) {
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = MAX_QUERIES_PER_FRAME;
+
+        frames.resize(Config::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : frames) {
+            if (vkCreateQueryPool(Device::VulkanDevice::getLogicalDevice(), &poolInfo, nullptr, &frame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+        }
+        results.resize(MAX_QUERIES_PER_FRAME);
+    }
+
+    bool GpuProfiler::isEnabled(){
+        return !frames.empty();
+    }
+
+    void GpuProfiler::readBack(uint32_t frameIndex){
+        FrameQueries& frame = frames[frameIndex];
+        if (frame.queryCount == 0) {
+            return;
+        }
+        // 调用时该槽位的帧已经在时间线上完成，不带WAIT标志也能拿到全部结果
+        VkResult result = vkGetQueryPoolResults(Device::VulkanDevice::getLogicalDevice(), frame.pool, 0, frame.queryCount,
+                                                sizeof(uint64_t) * frame.queryCount, results.data(), sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return;
+        }
+
+        // 父区间总是先于子区间记录，按顺序把每个区间挂到父节点下面
+        std::vector<ScopeTiming> roots;
+        std::vector<std::vector<uint32_t>> path(frame.scopes.size());
+        for (uint32_t i = 0; i < frame.scopes.size(); i++) {
+            const ScopeRecord& scope = frame.scopes[i];
+            ScopeTiming timing;
+            timing.name = scope.name;
+            if (scope.endQuery != NO_PARENT) {
+                uint64_t ticks = (results[scope.endQuery] - results[scope.beginQuery]) & timestampMask;
+                timing.milliseconds = ticks * timestampPeriod / 1000000.0;
+            }
+
+            std::vector<ScopeTiming>* siblings = &roots;
+            if (scope.parent != NO_PARENT) {
+                path[i] = path[scope.parent];
+                path[i].push_back(0);
+                ScopeTiming* parent = &roots[path[scope.parent][0]];
+                for (size_t level = 1; level < path[scope.parent].size(); level++) {
+                    parent = &parent->children[path[scope.parent][level]];
+                }
+                siblings = &parent->children;
+                path[i].back() = static_cast<uint32_t>(siblings->size());
+            } else {
+                path[i] = {static_cast<uint32_t>(roots.size())};
+            }
+            siblings->push_back(std::move(timing));
+        }
+
+        frameTimings.swap(roots);
+        timingsFrameNumber = frame.frameNumber;
+    }
+
+    void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+        if (!isEnabled()) {
+            return;
+        }
+        readBack(frameIndex);
+
+        currentFrame = frameIndex;
+        FrameQueries& frame = frames[frameIndex];
+        frame.scopes.clear();
+        frame.queryCount = 0;
+        frame.frameNumber = Pacing::FramePacer::getFrameNumber();
+        scopeStack.clear();
+        // 查询在写入前必须重置，重置命令不能在render pass内
+        vkCmdResetQueryPool(commandBuffer, frame.pool, 0, MAX_QUERIES_PER_FRAME);
+    }
+
+    void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name){
+        if (!isEnabled()) {
+            return;
+        }
+        FrameQueries& frame = frames[currentFrame];
+        uint32_t parent = scopeStack.empty() ? NO_PARENT : scopeStack.back();
+        scopeStack.push_back(static_cast<uint32_t>(frame.scopes.size()));
+        // 查询用完后区间仍然入栈以保持配对，但不再写时间戳
+        if (frame.queryCount + 2 > MAX_QUERIES_PER_FRAME) {
+            frame.scopes.push_back(ScopeRecord{name, NO_PARENT, NO_PARENT, parent});
+            return;
+        }
+        frame.scopes.push_back(ScopeRecord{name, frame.queryCount, NO_PARENT, parent});
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, frame.queryCount);
+        frame.queryCount += 2;  // 结束查询的位置先预留，保证同一区间的两个查询相邻
+    }
+
+    void GpuProfiler::endScope(VkCommandBuffer commandBuffer){
+        if (!isEnabled() || scopeStack.empty()) {
+            return;
+        }
+        FrameQueries& frame = frames[currentFrame];
+        ScopeRecord& scope = frame.scopes[scopeStack.back()];
+        scopeStack.pop_back();
+        if (scope.beginQuery == NO_PARENT) {
+            return;
+        }
+        scope.endQuery = scope.beginQuery + 1;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, scope.endQuery);
+    }
+
+    const std::vector<ScopeTiming>& GpuProfiler::getFrameTimings(){
+        return frameTimings;
+    }
+
+    uint64_t GpuProfiler::getTimingsFrameNumber(){
+        return timingsFrameNumber;
+    }
+
+    void GpuProfiler::cleanup(){
+        for (auto& frame : frames) {
+            vkDestroyQueryPool(Device::VulkanDevice::getLogicalDevice(), frame.pool, nullptr);
+        }
+        frames.clear();
+        frameTimings.clear();
+        scopeStack.clear();
+    }
+
+    GpuScope::GpuScope(VkCommandBuffer commandBuffer, const char* name) : commandBuffer(commandBuffer){
+        GpuProfiler::beginScope(commandBuffer, name);
+    }
+
+    GpuScope::~GpuScope(){
+        GpuProfiler::endScope(commandBuffer);
+    }
+}
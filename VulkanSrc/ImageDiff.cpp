@@ -0,0 +1,268 @@
+#include "ImageDiff.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMAGEDIFF_X86
+#endif
+
+
+namespace ImageDiff{
+    namespace{
+        // 读取PNM文件头中的一个十进制数，跳过前面的空白和注释
+        bool readHeaderValue(FILE* file, uint32_t& value){
+            int c = fgetc(file);
+            while (c != EOF) {
+                if (c == '#') {
+                    while (c != EOF && c != '\n') {
+                        c = fgetc(file);
+                    }
+                } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    c = fgetc(file);
+                } else {
+                    break;
+                }
+            }
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            uint64_t result = 0;
+            while (c >= '0' && c <= '9') {
+                result = result * 10 + static_cast<uint64_t>(c - '0');
+                if (result > 0xFFFFFFFFu) {
+                    return false;
+                }
+                c = fgetc(file);
+            }
+            // 数值后面紧跟的一个空白字符属于文件头
+            value = static_cast<uint32_t>(result);
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        void writeFile(const std::string& path, const char* header, const uint8_t* data, size_t size){
+            FILE* file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                throw std::runtime_error("failed to open image output file!");
+            }
+            bool written = fputs(header, file) >= 0 && fwrite(data, 1, size, file) == size;
+            if (fclose(file) != 0 || !written) {
+                throw std::runtime_error("failed to write image file!");
+            }
+        }
+
+        struct Accumulator{
+            uint64_t sumAbsolute = 0;
+            uint64_t sumSquares = 0;
+            uint64_t mismatchCount = 0;
+            uint8_t channelMax[4] = {};
+        };
+
+        // 处理第[begin, end)个像素，SIMD版本处理不完的尾部交给标量版本
+        void comparePixelsScalar(const uint8_t* a, const uint8_t* b, size_t begin, size_t end, uint8_t tolerance,
+                                 uint8_t* mask, Accumulator& accumulator){
+            for (size_t p = begin; p < end; p++) {
+                bool mismatch = false;
+                for (int c = 0; c < 4; c++) {
+                    int difference = std::abs(static_cast<int>(a[p * 4 + c]) - static_cast<int>(b[p * 4 + c]));
+                    accumulator.sumAbsolute += static_cast<uint64_t>(difference);
+                    accumulator.sumSquares += static_cast<uint64_t>(difference * difference);
+                    accumulator.channelMax[c] = std::max(accumulator.channelMax[c], static_cast<uint8_t>(difference));
+                    mismatch |= difference > tolerance;
+                }
+                accumulator.mismatchCount += mismatch ? 1 : 0;
+                if (mask != nullptr) {
+                    mask[p] = mismatch ? 255 : 0;
+                }
+            }
+        }
+
+        void comparePixelsScalarFull(const uint8_t* a, const uint8_t* b, size_t count, uint8_t tolerance,
+                                     uint8_t* mask, Accumulator& accumulator){
+            comparePixelsScalar(a, b, 0, count, tolerance, mask, accumulator);
+        }
+
+#ifdef IMAGEDIFF_X86
+        // AVX2一次处理8个像素：饱和减法的两个方向取或得到绝对差，
+        // SAD累加绝对差，madd累加平方，每个像素的4个通道都不超过容差时对应的32位为全1
+        __attribute__((target("avx2")))
+        void comparePixelsAvx2(const uint8_t* a, const uint8_t* b, size_t count, uint8_t tolerance,
+                               uint8_t* mask, Accumulator& accumulator){
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i threshold = _mm256_set1_epi8(static_cast<char>(tolerance));
+            __m256i maxDifference = zero;
+            __m256i sumAbsolute = zero;
+            __m256i sumSquares = zero;
+
+            size_t p = 0;
+            for (; p + 8 <= count; p += 8) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + p * 4));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + p * 4));
+                __m256i difference = _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+
+                maxDifference = _mm256_max_epu8(maxDifference, difference);
+                sumAbsolute = _mm256_add_epi64(sumAbsolute, _mm256_sad_epu8(difference, zero));
+                // 每个32位元素最多4 * 255 * 255，逐次扩展到64位累加，不会溢出
+                __m256i low = _mm256_unpacklo_epi8(difference, zero);
+                __m256i high = _mm256_unpackhi_epi8(difference, zero);
+                __m256i squares = _mm256_add_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high));
+                sumSquares = _mm256_add_epi64(sumSquares, _mm256_add_epi64(_mm256_unpacklo_epi32(squares, zero),
+                                                                           _mm256_unpackhi_epi32(squares, zero)));
+
+                __m256i within = _mm256_cmpeq_epi32(_mm256_subs_epu8(difference, threshold), zero);
+                uint32_t mismatched = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(within))) & 0xFFu;
+                accumulator.mismatchCount += static_cast<uint64_t>(__builtin_popcount(mismatched));
+                if (mask != nullptr) {
+                    // 32位掩码饱和压缩成字节，两个128位通道各给出4个像素
+                    __m256i bytes = _mm256_andnot_si256(within, _mm256_set1_epi32(-1));
+                    bytes = _mm256_packs_epi32(bytes, bytes);
+                    bytes = _mm256_packs_epi16(bytes, bytes);
+                    uint32_t first = static_cast<uint32_t>(_mm256_cvtsi256_si32(bytes));
+                    uint32_t second = static_cast<uint32_t>(_mm256_extract_epi32(bytes, 4));
+                    std::copy_n(reinterpret_cast<const uint8_t*>(&first), 4, mask + p);
+                    std::copy_n(reinterpret_cast<const uint8_t*>(&second), 4, mask + p + 4);
+                }
+            }
+
+            alignas(32) uint8_t maxBytes[32];
+            alignas(32) uint64_t absoluteLanes[4];
+            alignas(32) uint64_t squareLanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(maxBytes), maxDifference);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(absoluteLanes), sumAbsolute);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(squareLanes), sumSquares);
+            for (int i = 0; i < 32; i++) {
+                accumulator.channelMax[i % 4] = std::max(accumulator.channelMax[i % 4], maxBytes[i]);
+            }
+            for (int i = 0; i < 4; i++) {
+                accumulator.sumAbsolute += absoluteLanes[i];
+                accumulator.sumSquares += squareLanes[i];
+            }
+            comparePixelsScalar(a, b, p, count, tolerance, mask, accumulator);
+        }
+#endif
+
+        using CompareFunc = void (*)(const uint8_t*, const uint8_t*, size_t, uint8_t, uint8_t*, Accumulator&);
+
+        CompareFunc selectKernel(Comparator::Kernel kernel){
+#ifdef IMAGEDIFF_X86
+            __builtin_cpu_init();
+            bool avx2 = __builtin_cpu_supports("avx2");
+            if (kernel != Comparator::Kernel::Scalar && avx2) {
+                return comparePixelsAvx2;
+            }
+#else
+            (void)kernel;
+#endif
+            return comparePixelsScalarFull;
+        }
+
+        CompareFunc activeKernel = selectKernel(Comparator::Kernel::Auto);
+    }
+
+    Image readPpm(const std::string& path){
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            throw std::runtime_error("failed to open image file " + path + "!");
+        }
+        Image image;
+        uint32_t maxValue = 0;
+        char magic[2] = {};
+        bool valid = fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && magic[1] == '6' &&
+                     readHeaderValue(file, image.width) && readHeaderValue(file, image.height) &&
+                     readHeaderValue(file, maxValue) && maxValue == 255 && image.width != 0 && image.height != 0;
+        std::vector<uint8_t> rgb;
+        if (valid) {
+            rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+            valid = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        }
+        fclose(file);
+        if (!valid) {
+            throw std::runtime_error("failed to read binary PPM image " + path + "!");
+        }
+
+        size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        image.pixels.resize(pixelCount * 4);
+        for (size_t p = 0; p < pixelCount; p++) {
+            image.pixels[p * 4 + 0] = rgb[p * 3 + 0];
+            image.pixels[p * 4 + 1] = rgb[p * 3 + 1];
+            image.pixels[p * 4 + 2] = rgb[p * 3 + 2];
+            image.pixels[p * 4 + 3] = 255;
+        }
+        return image;
+    }
+
+    void writePpm(const std::string& path, const Image& image){
+        size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        std::vector<uint8_t> rgb(pixelCount * 3);
+        for (size_t p = 0; p < pixelCount; p++) {
+            rgb[p * 3 + 0] = image.pixels[p * 4 + 0];
+            rgb[p * 3 + 1] = image.pixels[p * 4 + 1];
+            rgb[p * 3 + 2] = image.pixels[p * 4 + 2];
+        }
+        std::string header = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+        writeFile(path, header.c_str(), rgb.data(), rgb.size());
+    }
+
+    void writePgm(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& gray){
+        if (gray.size() != static_cast<size_t>(width) * height) {
+            throw std::runtime_error("mask size does not match image size!");
+        }
+        std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        writeFile(path, header.c_str(), gray.data(), gray.size());
+    }
+
+    Image fromPixels(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba){
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(static_cast<size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* source = pixels + static_cast<size_t>(y) * rowPitch;
+            uint8_t* destination = image.pixels.data() + static_cast<size_t>(y) * width * 4;
+            for (uint32_t x = 0; x < width; x++) {
+                destination[x * 4 + 0] = source[x * 4 + (rgba ? 0 : 2)];
+                destination[x * 4 + 1] = source[x * 4 + 1];
+                destination[x * 4 + 2] = source[x * 4 + (rgba ? 2 : 0)];
+                destination[x * 4 + 3] = source[x * 4 + 3];
+            }
+        }
+        return image;
+    }
+
+    void Comparator::setKernel(Kernel kernel){
+        activeKernel = selectKernel(kernel);
+    }
+
+    DiffResult Comparator::compare(const Image& reference, const Image& actual, uint8_t tolerance, std::vector<uint8_t>* mask){
+        if (reference.width != actual.width || reference.height != actual.height) {
+            throw std::runtime_error("compared images have different sizes!");
+        }
+        size_t pixelCount = static_cast<size_t>(reference.width) * reference.height;
+        if (mask != nullptr) {
+            mask->resize(pixelCount);
+        }
+        // 图像按行紧密排列，整幅图当作一段连续的像素处理
+        Accumulator accumulator;
+        activeKernel(reference.pixels.data(), actual.pixels.data(), pixelCount, tolerance,
+                     mask != nullptr ? mask->data() : nullptr, accumulator);
+
+        DiffResult result;
+        result.pixelCount = pixelCount;
+        result.mismatchCount = accumulator.mismatchCount;
+        for (int c = 0; c < 4; c++) {
+            result.channelMaxError[c] = accumulator.channelMax[c];
+            result.maxError = std::max(result.maxError, result.channelMaxError[c]);
+        }
+        double sampleCount = static_cast<double>(pixelCount) * 4.0;
+        if (pixelCount != 0) {
+            result.meanAbsoluteError = static_cast<double>(accumulator.sumAbsolute) / sampleCount;
+        }
+        double meanSquaredError = pixelCount != 0 ? static_cast<double>(accumulator.sumSquares) / sampleCount : 0.0;
+        result.psnr = meanSquaredError == 0.0 ? INFINITY : 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+        return result;
+    }
+}
@@ -0,0 +1,369 @@
+#include "Jobs.h"
+#include "Trace.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace Jobs{
+    struct Job{
+        JobFunction function;
+        Counter* counter;
+    };
+
+    std::vector<std::thread> JobSystem::threads;
+    std::vector<WorkStealingDeque*> JobSystem::deques;
+    std::mutex JobSystem::globalLock;
+    std::vector<Job*> JobSystem::globalQueue;
+    std::mutex JobSystem::sleepLock;
+    std::condition_variable JobSystem::wakeCondition;
+    std::atomic<uint32_t> JobSystem::queuedJobs{0};
+    std::atomic<uint32_t> JobSystem::sleepingWorkers{0};
+    std::atomic<bool> JobSystem::running{false};
+    std::atomic<bool> JobSystem::stopping{false};
+
+    namespace{
+        const uint32_t DEQUE_CAPACITY = 4096;
+        // 找不到任务时先自旋若干次再休眠，避免帧内短暂的空闲导致线程频繁睡眠唤醒
+        const uint32_t SPIN_COUNT = 64;
+
+        thread_local uint32_t currentWorker = JobSystem::INVALID_WORKER;
+        thread_local uint32_t stealSeed = 0;
+    }
+
+    void DoInit(){
+        JobSystem::start();
+    }
+
+    void cleanup(){
+        JobSystem::stop();
+    }
+
+    Counter::Counter() : value(0) {}
+
+    bool Counter::isDone() const{
+        return value.load(std::memory_order_acquire) == 0;
+    }
+
+    void Counter::increment(){
+        value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Counter::decrement(){
+        // 归零和取出等待任务在同一把锁内完成，不会漏掉正在登记的任务；
+        // 等待者在返回前也会获取这把锁，保证计数器被销毁时这里已经不再访问它
+        std::vector<Job*> ready;
+        {
+            std::lock_guard<std::mutex> guard(continuationLock);
+            if (value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                ready.swap(continuations);
+            }
+        }
+        for (Job* job : ready) {
+            JobSystem::schedule(job);
+        }
+    }
+
+    bool Counter::addContinuation(Job* job){
+        std::lock_guard<std::mutex> guard(continuationLock);
+        if (value.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        continuations.push_back(job);
+        return true;
+    }
+
+    void Counter::setException(std::exception_ptr thrown){
+        std::lock_guard<std::mutex> guard(continuationLock);
+        if (!exception) {
+            exception = thrown;
+        }
+    }
+
+    WorkStealingDeque::WorkStealingDeque(uint32_t capacity) : buffer(capacity), mask(capacity - 1), top(0), bottom(0) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            throw std::runtime_error("work stealing deque capacity must be a power of two!");
+        }
+    }
+
+    bool WorkStealingDeque::push(Job* job){
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > mask) {
+            return false;
+        }
+        buffer[b & mask].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Job* WorkStealingDeque::pop(){
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            // 队列为空
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // 只剩最后一个任务时与窃取线程竞争
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                job = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job* WorkStealingDeque::steal(){
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        Job* job = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return job;
+    }
+
+    void JobSystem::start(uint32_t threadCount, bool pinThreads){
+        if (running.load()) {
+            return;
+        }
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        stopping.store(false);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            deques.push_back(new WorkStealingDeque(DEQUE_CAPACITY));
+        }
+        currentWorker = 0;
+        TRACE_THREAD_NAME("main");
+        if (pinThreads) {
+            pinCurrentThread(0);
+        }
+        running.store(true);
+
+        for (uint32_t i = 1; i < threadCount; i++) {
+            threads.emplace_back([i, pinThreads](){
+                if (pinThreads) {
+                    pinCurrentThread(i);
+                }
+                workerLoop(i);
+            });
+        }
+    }
+
+    void JobSystem::stop(){
+        if (!running.load()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping.store(true);
+        }
+        wakeCondition.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+
+        // 停止前提交但未执行的任务在主线程上执行完
+        while (Job* job = findJob()) {
+            execute(job);
+        }
+        for (WorkStealingDeque* deque : deques) {
+            delete deque;
+        }
+        deques.clear();
+        currentWorker = INVALID_WORKER;
+        running.store(false);
+    }
+
+    bool JobSystem::isRunning(){
+        return running.load(std::memory_order_acquire);
+    }
+
+    uint32_t JobSystem::getWorkerCount(){
+        return std::max<uint32_t>(1, static_cast<uint32_t>(deques.size()));
+    }
+
+    uint32_t JobSystem::getWorkerIndex(){
+        return currentWorker;
+    }
+
+    void JobSystem::pinCurrentThread(uint32_t core){
+#ifdef __linux__
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cpuSet);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+        (void)core;
+#endif
+    }
+
+    void JobSystem::run(JobFunction function, Counter* counter, Counter* dependency){
+        if (counter != nullptr) {
+            counter->increment();
+        }
+        Job* job = new Job{std::move(function), counter};
+        if (dependency != nullptr && dependency->addContinuation(job)) {
+            return;
+        }
+        schedule(job);
+    }
+
+    void JobSystem::schedule(Job* job){
+        if (!isRunning()) {
+            execute(job);
+            return;
+        }
+
+        uint32_t worker = currentWorker;
+        if (worker == INVALID_WORKER || !deques[worker]->push(job)) {
+            // 非工作线程提交，或者本线程队列已满
+            std::lock_guard<std::mutex> guard(globalLock);
+            globalQueue.push_back(job);
+        }
+        queuedJobs.fetch_add(1);
+        if (sleepingWorkers.load() > 0) {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            wakeCondition.notify_one();
+        }
+    }
+
+    Job* JobSystem::findJob(){
+        uint32_t worker = currentWorker;
+        Job* job = nullptr;
+        if (worker != INVALID_WORKER) {
+            job = deques[worker]->pop();
+        }
+        if (job == nullptr) {
+            std::lock_guard<std::mutex> guard(globalLock);
+            if (!globalQueue.empty()) {
+                job = globalQueue.back();
+                globalQueue.pop_back();
+            }
+        }
+        if (job == nullptr && !deques.empty()) {
+            // 从随机位置开始依次尝试窃取，避免所有线程同时盯着同一个队列
+            uint32_t dequeCount = static_cast<uint32_t>(deques.size());
+            stealSeed = stealSeed * 1664525u + 1013904223u;
+            uint32_t first = stealSeed % dequeCount;
+            for (uint32_t i = 0; i < dequeCount && job == nullptr; i++) {
+                uint32_t victim = (first + i) % dequeCount;
+                if (victim != worker) {
+                    job = deques[victim]->steal();
+                }
+            }
+        }
+        if (job != nullptr) {
+            queuedJobs.fetch_sub(1);
+        }
+        return job;
+    }
+
+    void JobSystem::execute(Job* job){
+        TRACE_SCOPE("job");
+        std::exception_ptr thrown;
+        try {
+            job->function();
+        } catch (...) {
+            thrown = std::current_exception();
+        }
+        // 无论任务是否抛出都要递减计数，否则等待者会永远等下去；
+        // 任务函数可能持有计数器，所以先递减再释放任务
+        bool delivered = job->counter != nullptr;
+        if (delivered) {
+            if (thrown) {
+                job->counter->setException(thrown);
+            }
+            job->counter->decrement();
+        }
+        delete job;
+        if (thrown && !delivered) {
+            // 没有计数器时没有人能接收异常，交给执行它的线程，行为和直接调用一致
+            std::rethrow_exception(thrown);
+        }
+    }
+
+    void JobSystem::workerLoop(uint32_t workerIndex){
+        currentWorker = workerIndex;
+        stealSeed = workerIndex;
+        TRACE_THREAD_NAME("worker " + std::to_string(workerIndex));
+        uint32_t idleSpins = 0;
+        while (true) {
+            if (Job* job = findJob()) {
+                execute(job);
+                idleSpins = 0;
+                continue;
+            }
+            if (++idleSpins < SPIN_COUNT) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock);
+            sleepingWorkers.fetch_add(1);
+            wakeCondition.wait(lock, [](){
+                return stopping.load() || queuedJobs.load() > 0;
+            });
+            sleepingWorkers.fetch_sub(1);
+            idleSpins = 0;
+            if (stopping.load()) {
+                return;
+            }
+        }
+    }
+
+    void JobSystem::wait(const Counter& counter){
+        while (!counter.isDone()) {
+            if (Job* job = findJob()) {
+                execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        std::exception_ptr thrown;
+        {
+            std::lock_guard<std::mutex> guard(counter.continuationLock);
+            thrown.swap(counter.exception);
+        }
+        if (thrown) {
+            std::rethrow_exception(thrown);
+        }
+    }
+
+    void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function){
+        grainSize = std::max(1u, grainSize);
+        if (!isRunning() || count <= grainSize) {
+            if (count > 0) {
+                function(0, count);
+            }
+            return;
+        }
+
+        Counter counter;
+        for (uint32_t begin = 0; begin < count; begin += grainSize) {
+            uint32_t end = std::min(count, begin + grainSize);
+            run([&function, begin, end](){
+                function(begin, end);
+            }, &counter);
+        }
+        wait(counter);
+    }
+}
@@ -1,9 +1,15 @@
 #include "MeshData.h"
 #include "Device.h"
 #include "Draw.h"
+#include "Culling.h"
+#include "Scene.h"
+#include "Sync.h"
+#include "Trace.h"
+#include "Capture.h"
 
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
 
 
 namespace Mesh{
@@ -11,10 +17,32 @@ namespace Mesh{
     VkDeviceMemory SimpleMesh::vertexBufferMemory;
     VkBuffer SimpleMesh::indexBuffer;
     VkDeviceMemory SimpleMesh::indexBufferMemory;
+    uint32_t SimpleMesh::cullIndex = 0;
+    uint32_t SimpleMesh::sceneNode = Scene::INVALID_NODE;
 
     void DoInit(){
         SimpleMesh::createVertexBuffer();
         SimpleMesh::createIndexBuffer();
+        SimpleMesh::registerCullBounds();
+        SimpleMesh::createSceneNode();
+    }
+
+    void SimpleMesh::createSceneNode(){
+        // 网格作为根节点挂在场景图上，世界矩阵写入实例数据供着色器读取
+        sceneNode = Scene::SceneGraph::createNode(Scene::INVALID_NODE, true);
+    }
+
+    void SimpleMesh::registerCullBounds(){
+        // 顶点位于z=0平面，用顶点的二维范围作为网格的包围盒
+        glm::vec3 minCorner(vertices[0].pos.x, vertices[0].pos.y, 0.0f);
+        glm::vec3 maxCorner = minCorner;
+        for (const auto& vertex : vertices) {
+            minCorner.x = std::min(minCorner.x, vertex.pos.x);
+            minCorner.y = std::min(minCorner.y, vertex.pos.y);
+            maxCorner.x = std::max(maxCorner.x, vertex.pos.x);
+            maxCorner.y = std::max(maxCorner.y, vertex.pos.y);
+        }
+        cullIndex = Culling::FrustumCuller::addBox(minCorner, maxCorner);
     }
 
     const std::vector<SimpleMesh::Vertex> SimpleMesh::vertices = {
@@ -46,44 +74,35 @@ namespace Mesh{
 
     void SimpleMesh::createVertexBuffer() {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory; // 暂存缓冲区内存可能无法被cpu访问，需要通过cpu映射来执行访问
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        // 将暂存缓冲区的内存映射到cpu可访问的内存指针
-        void* data;
-        vkMapMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t) bufferSize);  // 复制顶点数据到暂存缓冲区
-        vkUnmapMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory);
-        // 创建GPU内存，用于顶点数据处理，仅GPU访问的内存，读写效率更高
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-        vkDestroyBuffer(Device::VulkanDevice::getLogicalDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory, nullptr);
+        uploadBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
     }
 
     void SimpleMesh::createIndexBuffer() {
         VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        uploadBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+    }
 
+    void SimpleMesh::uploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
         VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
+        VkDeviceMemory stagingBufferMemory; // 暂存缓冲区内存可能无法被cpu访问，需要通过cpu映射来执行访问
         //它的内存属性是主机可见和主机一致，即可以被CPU访问和修改，并且不需要显式刷新或使缓存失效
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
-        void* data;
-        vkMapMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, indices.data(), (size_t) bufferSize);
+        // 将暂存缓冲区的内存映射到cpu可访问的内存指针
+        void* mapped;
+        vkMapMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory, 0, size, 0, &mapped);
+        memcpy(mapped, data, (size_t) size);  // 复制数据到暂存缓冲区
         vkUnmapMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory);
+        // 创建GPU内存，仅GPU访问的内存，读写效率更高
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-
-        copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        copyBuffer(stagingBuffer, buffer, size);
 
         vkDestroyBuffer(Device::VulkanDevice::getLogicalDevice(), stagingBuffer, nullptr);
         vkFreeMemory(Device::VulkanDevice::getLogicalDevice(), stagingBufferMemory, nullptr);
+
+        // 捕获时记录缓冲区内容，回放时用同样的方式重新上传
+        Capture::Recorder::recordBuffer(buffer, usage, data, size);
     }
 
     void SimpleMesh::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -110,18 +129,15 @@ namespace Mesh{
 
         vkEndCommandBuffer(commandBuffer);
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(Device::VulkanDevice::getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(Device::VulkanDevice::getGraphicsQueue());
+        // 只等待这一次复制完成，不必等整个队列空闲
+        uint64_t copyDone = Sync::Timeline::submit(Sync::Transfer, {commandBuffer});
+        Sync::Timeline::wait(Sync::Transfer, copyDone);
 
         vkFreeCommandBuffers(device, DrawSpace::CommondFactory::getCommandPool(), 1, &commandBuffer);
     }
 
     void SimpleMesh::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        TRACE_SCOPE("createBuffer");
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
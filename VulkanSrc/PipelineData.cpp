@@ -1,8 +1,19 @@
 #include "PipelineData.h"
 #include "Device.h"
 #include "Present.h"
-#include "MeshData.h"
-
+#include "Bindless.h"
+#include "Config.h"
+#include "Capture.h"
+#include "Sync.h"
+#include "ShaderCompiler.h"
+#include "ShaderReflection.h"
+#include "ShaderRegistry.h"
+#include "Descriptor.h"
+#include "Jobs.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <iostream>
@@ -18,36 +29,36 @@ namespace PipelineData
         RenderPassFactory::cleanup();
     }
 
-    std::function<void()> ShaderFactory::destroyShader;
-    std::unique_ptr<VkPipelineShaderStageCreateInfo[]> ShaderFactory::getDefaultShaderInfo()
+    void ShaderFactory::loadDefaultShaderCode(std::vector<char>& vertCode, std::vector<char>& fragCode)
     {
-        // 读取着色器字节码，并使用vkShaderModule包装好
-        auto vertShaderCode = readFile("../Shader/vert.spv");
-        auto fragShaderCode = readFile("../Shader/frag.spv");
-
-        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        // 设置着色器阶段信息，用于传入管线对象中，执行渲染流程
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        destroyShader = [vertShaderModule, fragShaderModule]()
+        // 嵌入的字节码不依赖工作目录，也没有文件读取
+        if (Config::useEmbeddedShaders && ShaderRegistry::EmbeddedShaders::find("vert") != nullptr
+            && ShaderRegistry::EmbeddedShaders::find("frag") != nullptr)
         {
-            vkDestroyShaderModule(Device::VulkanDevice::getLogicalDevice(), fragShaderModule, nullptr);
-            vkDestroyShaderModule(Device::VulkanDevice::getLogicalDevice(), vertShaderModule, nullptr);
-        };
+            vertCode = ShaderRegistry::EmbeddedShaders::getCode("vert");
+            fragCode = ShaderRegistry::EmbeddedShaders::getCode("frag");
+            return;
+        }
+        loadShaderCodeFromDirectory(vertCode, fragCode);
+    }
 
-        return std::unique_ptr<VkPipelineShaderStageCreateInfo[]>{new VkPipelineShaderStageCreateInfo[2]{vertShaderStageInfo, fragShaderStageInfo}};
+    void ShaderFactory::loadShaderCodeFromDirectory(std::vector<char>& vertCode, std::vector<char>& fragCode)
+    {
+        std::string directory = Config::shaderDirectory;
+        std::string vertSource = directory + "shader.vert";
+        std::string fragSource = directory + "shader.frag";
+        if (ShaderCompiler::SpirvCache::isAvailable() && std::ifstream{vertSource}.good() && std::ifstream{fragSource}.good())
+        {
+            // 两个阶段并行编译，缓存命中时只读取缓存文件
+            std::vector<std::vector<char>> codes = ShaderCompiler::SpirvCache::compileAll({
+                {vertSource, ShaderCompiler::Stage::Vertex, {}},
+                {fragSource, ShaderCompiler::Stage::Fragment, {}}});
+            vertCode = std::move(codes[0]);
+            fragCode = std::move(codes[1]);
+            return;
+        }
+        vertCode = readFile(directory + "vert.spv");
+        fragCode = readFile(directory + "frag.spv");
     }
 
     VkShaderModule ShaderFactory::createShaderModule(const std::vector<char> &code)
@@ -68,11 +79,23 @@ namespace PipelineData
 
     std::vector<char> ShaderFactory::readFile(std::string fileName)
     {
-        std::ifstream file{fileName, std::ios::binary};
-        // 使用istream_iterator作为迭代器，执行结束后就把文件关闭了，不能再读取数据了
-        // 使用istreambuf_iterator直接对缓冲区进行操作，效率会更高，并且执行结束不会影响文件的状态
-        std::vector<char> code{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{}};
-        file.close();
+        // 打开时定位到末尾，先取得文件大小再一次读完，不逐字节经过流缓冲区
+        std::ifstream file{fileName, std::ios::binary | std::ios::ate};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open file " + fileName + "!");
+        }
+        std::streamsize size = file.tellg();
+        if (size <= 0)
+        {
+            throw std::runtime_error("failed to read file " + fileName + ": file is empty!");
+        }
+        std::vector<char> code(static_cast<size_t>(size));
+        file.seekg(0);
+        if (!file.read(code.data(), size))
+        {
+            throw std::runtime_error("failed to read file " + fileName + "!");
+        }
         return code;
     }
 
@@ -111,14 +134,25 @@ namespace PipelineData
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+        // 隐式的subpass到外部依赖目标是BOTTOM_OF_PIPE且没有访问，帧回读在render pass之后复制图像，
+        // 显式声明让颜色写入和最终的布局转换对传输读取可见
+        VkSubpassDependency readbackDependency{};
+        readbackDependency.srcSubpass = 0;
+        readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        VkSubpassDependency dependencies[] = {dependency, readbackDependency};
+
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount = 1;
         renderPassInfo.pAttachments = &colorAttachment;
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = dependencies;
 
         if (vkCreateRenderPass(Device::VulkanDevice::getLogicalDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
         {
@@ -169,29 +203,264 @@ namespace PipelineData
         vkDestroyRenderPass(Device::VulkanDevice::getLogicalDevice(), renderPass, nullptr);
     }
 
-    VkPipelineLayout Pipeline::pipelineLayout;
-    VkPipeline Pipeline::graphicsPipeline = VK_NULL_HANDLE;
+    namespace
+    {
+        inline void hashCombine(size_t& seed, size_t value)
+        {
+            seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+        }
 
-    void Pipeline::createGraphicsPipeline()
+        void fillShaderStages(const ShaderProgram& program, VkPipelineShaderStageCreateInfo* shaderStages)
+        {
+            shaderStages[0] = {};
+            shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            shaderStages[0].module = program.vertModule;
+            shaderStages[0].pName = "main";
+            shaderStages[1] = {};
+            shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shaderStages[1].module = program.fragModule;
+            shaderStages[1].pName = "main";
+        }
+
+        // 由两个阶段的反射结果得到管线布局：bindless开启时set 0固定为资源堆，push constant范围与堆的范围合并
+        VkPipelineLayout createProgramLayout(const ShaderReflection::ModuleInfo& vertInfo, const ShaderReflection::ModuleInfo& fragInfo)
+        {
+            ShaderReflection::LayoutDescription description = ShaderReflection::mergeLayouts({&vertInfo, &fragInfo});
+            bool bindless = Descriptor::BindlessHeap::isEnabled();
+            size_t setCount = std::max(description.sets.size(), static_cast<size_t>(bindless ? 1 : 0));
+
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            for (size_t set = 0; set < setCount; set++)
+            {
+                if (set == 0 && bindless)
+                {
+                    // 着色器声明的set 0被堆的布局替换，两者不一致时着色器会按错误的类型或越界访问描述符
+                    if (!description.sets.empty())
+                    {
+                        for (const VkDescriptorSetLayoutBinding& binding : description.sets[0])
+                        {
+                            if (!Descriptor::BindlessHeap::matchesBinding(binding))
+                                throw std::runtime_error("failed to create pipeline layout: set 0 binding " + std::to_string(binding.binding) +
+                                                         " does not match the bindless heap layout!");
+                        }
+                    }
+                    setLayouts.push_back(Descriptor::BindlessHeap::getLayout());
+                    continue;
+                }
+                // 中间没有用到的set也需要一个空布局占位
+                std::vector<VkDescriptorSetLayoutBinding> bindings;
+                if (set < description.sets.size())
+                    bindings = description.sets[set];
+                for (const VkDescriptorSetLayoutBinding& binding : bindings)
+                {
+                    if (binding.descriptorCount == 0)
+                        throw std::runtime_error("failed to create pipeline layout: unsized descriptor arrays are only supported in the bindless set!");
+                }
+                setLayouts.push_back(Descriptor::LayoutCache::getLayout(bindings));
+            }
+
+            VkPushConstantRange pushConstants = description.pushConstants;
+            if (bindless)
+            {
+                VkPushConstantRange heapRange = Descriptor::BindlessHeap::getPushConstantRange();
+                if (pushConstants.size == 0)
+                {
+                    pushConstants = heapRange;
+                }
+                else
+                {
+                    uint32_t end = std::max(pushConstants.offset + pushConstants.size, heapRange.offset + heapRange.size);
+                    pushConstants.offset = std::min(pushConstants.offset, heapRange.offset);
+                    pushConstants.size = end - pushConstants.offset;
+                    pushConstants.stageFlags |= heapRange.stageFlags;
+                }
+            }
+            std::vector<VkPushConstantRange> ranges;
+            if (pushConstants.size != 0)
+                ranges.push_back(pushConstants);
+            return Descriptor::PipelineLayoutCache::getLayout(setLayouts, ranges);
+        }
+
+        // 先反射再创建模块，字节码接口有问题时不会留下模块
+        void createProgram(PipelineGeneration& generation)
+        {
+            ShaderReflection::ModuleInfo vertInfo = ShaderReflection::reflect(generation.vertCode);
+            ShaderReflection::ModuleInfo fragInfo = ShaderReflection::reflect(generation.fragCode);
+            if (vertInfo.stage != VK_SHADER_STAGE_VERTEX_BIT || fragInfo.stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+                throw std::runtime_error("failed to reflect shaders: expected a vertex and a fragment shader!");
+            ShaderReflection::VertexInputLayout vertexInput = ShaderReflection::makeVertexInput(vertInfo);
+
+            ShaderProgram& program = generation.program;
+            program.layout = createProgramLayout(vertInfo, fragInfo);
+            program.vertexBinding = vertexInput.binding;
+            program.vertexAttributes = std::move(vertexInput.attributes);
+            program.vertModule = ShaderFactory::createShaderModule(generation.vertCode);
+            try
+            {
+                program.fragModule = ShaderFactory::createShaderModule(generation.fragCode);
+            }
+            catch (...)
+            {
+                vkDestroyShaderModule(Device::VulkanDevice::getLogicalDevice(), program.vertModule, nullptr);
+                program.vertModule = VK_NULL_HANDLE;
+                throw;
+            }
+        }
+
+        // 每个状态一个任务，所有工作线程同时调用vkCreateGraphicsPipelines；任何一个失败时销毁已创建的管线并抛出异常
+        void createPipelinesParallel(const ShaderProgram& program, const std::vector<PipelineState>& states, VkPipeline* pipelines)
+        {
+            std::vector<std::string> errors(states.size());
+            Jobs::JobSystem::parallelFor(static_cast<uint32_t>(states.size()), 1, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    try
+                    {
+                        Pipeline::createPipelines(program, {states[i]}, &pipelines[i]);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        pipelines[i] = VK_NULL_HANDLE;
+                        errors[i] = e.what();
+                    }
+                }
+            });
+            for (const std::string& error : errors)
+            {
+                if (error.empty())
+                    continue;
+                for (size_t i = 0; i < states.size(); i++)
+                {
+                    if (pipelines[i] != VK_NULL_HANDLE)
+                        vkDestroyPipeline(Device::VulkanDevice::getLogicalDevice(), pipelines[i], nullptr);
+                }
+                throw std::runtime_error(error);
+            }
+        }
+    }
+
+    PipelineState& PipelineState::specialize(VkShaderStageFlagBits stage, uint32_t id, uint32_t value)
     {
-        std::unique_ptr<VkPipelineShaderStageCreateInfo[]> shaderStages = ShaderFactory::getDefaultShaderInfo();
-        
+        std::vector<SpecializationConstant>* constants = nullptr;
+        if (stage == VK_SHADER_STAGE_VERTEX_BIT)
+            constants = &vertexConstants;
+        else if (stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+            constants = &fragmentConstants;
+        else
+            throw std::runtime_error("failed to specialize unsupported shader stage!");
+
+        // 保持有序，设置顺序不同的两个状态也相等
+        auto position = std::lower_bound(constants->begin(), constants->end(), id, [](const SpecializationConstant& constant, uint32_t key)
+        {
+            return constant.id < key;
+        });
+        if (position != constants->end() && position->id == id)
+            position->value = value;
+        else
+            constants->insert(position, SpecializationConstant{id, value});
+        return *this;
+    }
 
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    PipelineState& PipelineState::specialize(VkShaderStageFlagBits stage, uint32_t id, int32_t value)
+    {
+        return specialize(stage, id, static_cast<uint32_t>(value));
+    }
+
+    PipelineState& PipelineState::specialize(VkShaderStageFlagBits stage, uint32_t id, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return specialize(stage, id, bits);
+    }
+
+    PipelineState& PipelineState::specialize(VkShaderStageFlagBits stage, uint32_t id, bool value)
+    {
+        // SPIR-V的bool特化常量按VkBool32读取
+        return specialize(stage, id, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+    }
+
+    bool PipelineState::operator==(const PipelineState& other) const
+    {
+        auto sameConstants = [](const std::vector<SpecializationConstant>& a, const std::vector<SpecializationConstant>& b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const SpecializationConstant& x, const SpecializationConstant& y)
+            {
+                return x.id == y.id && x.value == y.value;
+            });
+        };
+        return topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode &&
+               frontFace == other.frontFace && blendEnable == other.blendEnable &&
+               sameConstants(vertexConstants, other.vertexConstants) && sameConstants(fragmentConstants, other.fragmentConstants);
+    }
+
+    bool PipelineState::operator!=(const PipelineState& other) const
+    {
+        return !(*this == other);
+    }
+
+    size_t PipelineStateHash::operator()(const PipelineState& state) const
+    {
+        size_t seed = std::hash<uint32_t>{}(static_cast<uint32_t>(state.topology));
+        hashCombine(seed, std::hash<uint32_t>{}(static_cast<uint32_t>(state.polygonMode)));
+        hashCombine(seed, std::hash<uint32_t>{}(state.cullMode));
+        hashCombine(seed, std::hash<uint32_t>{}(static_cast<uint32_t>(state.frontFace)));
+        hashCombine(seed, std::hash<bool>{}(state.blendEnable));
+        // 长度也参与哈希，同样的常量出现在不同阶段时结果不同
+        for (const std::vector<SpecializationConstant>* constants : {&state.vertexConstants, &state.fragmentConstants})
+        {
+            hashCombine(seed, constants->size());
+            for (const SpecializationConstant& constant : *constants)
+            {
+                hashCombine(seed, std::hash<uint32_t>{}(constant.id));
+                hashCombine(seed, std::hash<uint32_t>{}(constant.value));
+            }
+        }
+        return seed;
+    }
 
-        auto bindingDescription = Mesh::SimpleMesh::Vertex::getBindingDescription();
-        auto attributeDescriptions = Mesh::SimpleMesh::Vertex::getAttributeDescriptions();
+    VkPipelineCache Pipeline::pipelineCache = VK_NULL_HANDLE;
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    void Pipeline::createGraphicsPipeline()
+    {
+        // 不设置外部同步标志，多个线程同时创建管线时可以共用
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (vkCreatePipelineCache(Device::VulkanDevice::getLogicalDevice(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        // 默认管线在后台创建，和之后的初始化重叠，第一帧录制时才等待
+        PipelineStateCache::prewarmAsync({PipelineState{}});
+    }
 
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
+    std::vector<VkPipeline> Pipeline::createVariants(const std::vector<PipelineState>& states)
+    {
+        // 先批量创建缺少的状态，之后的查找全部命中
+        PipelineStateCache::prewarm(states);
+        std::vector<VkPipeline> pipelines(states.size(), VK_NULL_HANDLE);
+        for (size_t i = 0; i < states.size(); i++)
+            pipelines[i] = PipelineStateCache::get(states[i]);
+        return pipelines;
+    }
+
+    void Pipeline::createPipelines(const ShaderProgram& program, const std::vector<PipelineState>& states, VkPipeline* pipelines)
+    {
+        VkPipelineShaderStageCreateInfo shaderStages[2];
+        fillShaderStages(program, shaderStages);
+
+        // 顶点输入由顶点着色器反射得到，属性按location紧密排列在一个交错的缓冲区中，与Mesh::SimpleMesh::Vertex一致
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        if (!program.vertexAttributes.empty())
+        {
+            vertexInputInfo.vertexBindingDescriptionCount = 1;
+            vertexInputInfo.pVertexBindingDescriptions = &program.vertexBinding;
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(program.vertexAttributes.size());
+            vertexInputInfo.pVertexAttributeDescriptions = program.vertexAttributes.data();
+        }
 
         // 为视口设置动态设置，然后在单个命令队列中设置不同的视口和裁剪矩阵
         std::vector<VkDynamicState> dynamicStates = {
@@ -208,84 +477,416 @@ namespace PipelineData
         viewportState.viewportCount = 1;
         viewportState.scissorCount = 1;
 
-        // 光栅化状态设置
-        VkPipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;        // 设置近远平面之间的裁剪状态
-        rasterizer.rasterizerDiscardEnable = VK_FALSE; // 设置是否开启光栅化
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // 图像光栅化的模式，包括：点，线，面
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;    // 设置表面提出的类型，正面剔除，背面提出等
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // 表面的顶点位置方向（顶点朝前方向的顺时针）
-        rasterizer.depthBiasEnable = VK_FALSE;
-
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.sampleShadingEnable = VK_FALSE;
         multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        VkPipelineColorBlendStateCreateInfo colorBlending{};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &colorBlendAttachment;
-        colorBlending.blendConstants[0] = 0.0f;
-        colorBlending.blendConstants[1] = 0.0f;
-        colorBlending.blendConstants[2] = 0.0f;
-        colorBlending.blendConstants[3] = 0.0f;
-
-        // vkpipelinelayout用于指定uniform变量的描述，uniform可以用于所有着色器，并且可以在渲染期间动态改变
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        
-        if (vkCreatePipelineLayout(Device::VulkanDevice::getLogicalDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-        {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
-        VkGraphicsPipelineCreateInfo pipelineInfo{};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages.get();
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = &dynamicState;
-        pipelineInfo.layout = pipelineLayout;
-        pipelineInfo.renderPass = RenderPassFactory::GetRenderPass();
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-        VkResult error_code = vkCreateGraphicsPipelines(Device::VulkanDevice::getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
-        if (error_code != VK_SUCCESS)
+        // 每个状态各自的着色器阶段（特化常量）、图元装配、光栅化和混合状态，其余状态共用
+        std::vector<VkPipelineShaderStageCreateInfo> specializedStages(states.size() * 2);
+        std::vector<VkSpecializationInfo> specializationInfos(states.size() * 2);
+        std::vector<VkSpecializationMapEntry> mapEntries;
+        for (const PipelineState& state : states)
+            mapEntries.reserve(mapEntries.size() + state.vertexConstants.size() + state.fragmentConstants.size());
+        std::vector<VkPipelineInputAssemblyStateCreateInfo> inputAssemblies(states.size());
+        std::vector<VkPipelineRasterizationStateCreateInfo> rasterizers(states.size());
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(states.size());
+        std::vector<VkPipelineColorBlendStateCreateInfo> colorBlendings(states.size());
+        std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(states.size());
+        for (size_t i = 0; i < states.size(); i++)
         {
-            std::cout<<error_code<<std::endl;
-            throw std::runtime_error("failed to create graphics pipeline!");
+            const std::vector<SpecializationConstant>* stageConstants[2] = {&states[i].vertexConstants, &states[i].fragmentConstants};
+            for (size_t stage = 0; stage < 2; stage++)
+            {
+                // 常量数组本身作为数据块，映射项直接指向每个常量的value字段，不需要另外打包
+                VkPipelineShaderStageCreateInfo& stageInfo = specializedStages[i * 2 + stage];
+                stageInfo = shaderStages[stage];
+                const std::vector<SpecializationConstant>& constants = *stageConstants[stage];
+                if (constants.empty())
+                    continue;
+                VkSpecializationInfo& specializationInfo = specializationInfos[i * 2 + stage];
+                specializationInfo.mapEntryCount = static_cast<uint32_t>(constants.size());
+                specializationInfo.pMapEntries = mapEntries.data() + mapEntries.size();
+                specializationInfo.dataSize = constants.size() * sizeof(SpecializationConstant);
+                specializationInfo.pData = constants.data();
+                for (size_t c = 0; c < constants.size(); c++)
+                {
+                    mapEntries.push_back({constants[c].id,
+                                          static_cast<uint32_t>(c * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value)),
+                                          sizeof(uint32_t)});
+                }
+                stageInfo.pSpecializationInfo = &specializationInfo;
+            }
+
+            VkPipelineInputAssemblyStateCreateInfo& inputAssembly = inputAssemblies[i];
+            inputAssembly = {};
+            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly.topology = states[i].topology;
+            inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+            // 光栅化状态设置
+            VkPipelineRasterizationStateCreateInfo& rasterizer = rasterizers[i];
+            rasterizer = {};
+            rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer.depthClampEnable = VK_FALSE;        // 设置近远平面之间的裁剪状态
+            rasterizer.rasterizerDiscardEnable = VK_FALSE; // 设置是否开启光栅化
+            rasterizer.polygonMode = states[i].polygonMode; // 图像光栅化的模式，包括：点，线，面
+            rasterizer.lineWidth = 1.0f;
+            rasterizer.cullMode = states[i].cullMode;    // 设置表面提出的类型，正面剔除，背面提出等
+            rasterizer.frontFace = states[i].frontFace;   // 表面的顶点位置方向（默认顶点朝前方向的顺时针）
+            rasterizer.depthBiasEnable = VK_FALSE;
+
+            VkPipelineColorBlendAttachmentState& colorBlendAttachment = colorBlendAttachments[i];
+            colorBlendAttachment = {};
+            colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            colorBlendAttachment.blendEnable = states[i].blendEnable ? VK_TRUE : VK_FALSE;
+            // 开启混合时按alpha做常规的透明混合
+            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+            colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+            VkPipelineColorBlendStateCreateInfo& colorBlending = colorBlendings[i];
+            colorBlending = {};
+            colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            colorBlending.logicOpEnable = VK_FALSE;
+            colorBlending.logicOp = VK_LOGIC_OP_COPY;
+            colorBlending.attachmentCount = 1;
+            colorBlending.pAttachments = &colorBlendAttachment;
+            colorBlending.blendConstants[0] = 0.0f;
+            colorBlending.blendConstants[1] = 0.0f;
+            colorBlending.blendConstants[2] = 0.0f;
+            colorBlending.blendConstants[3] = 0.0f;
+
+            VkGraphicsPipelineCreateInfo& pipelineInfo = pipelineInfos[i];
+            pipelineInfo = {};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipelineInfo.stageCount = 2;
+            pipelineInfo.pStages = &specializedStages[i * 2];
+            pipelineInfo.pVertexInputState = &vertexInputInfo;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pColorBlendState = &colorBlending;
+            pipelineInfo.pDynamicState = &dynamicState;
+            pipelineInfo.layout = program.layout;
+            pipelineInfo.renderPass = RenderPassFactory::GetRenderPass();
+            pipelineInfo.subpass = 0;
+            pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         }
 
-        ShaderFactory::destroyShader();
+        VkResult error_code = vkCreateGraphicsPipelines(Device::VulkanDevice::getLogicalDevice(), pipelineCache,
+                                                        static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr, pipelines);
+        if (error_code != VK_SUCCESS)
+        {
+            // 可能在多个工作线程同时失败，错误码放进异常信息而不是直接打印
+            throw std::runtime_error("failed to create graphics pipeline (VkResult " + std::to_string(error_code) + ")!");
+        }
     }
 
     VkPipeline Pipeline::getGraphicPipeline()
     {
-        if(graphicsPipeline==VK_NULL_HANDLE)
-            createGraphicsPipeline();
-        return graphicsPipeline;
+        return PipelineStateCache::get(PipelineState{});
+    }
+
+    VkPipelineLayout Pipeline::getPipelineLayout()
+    {
+        return PipelineStateCache::getLayout();
     }
 
     void Pipeline::cleanup()
     {
-        vkDestroyPipeline(Device::VulkanDevice::getLogicalDevice(), graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(Device::VulkanDevice::getLogicalDevice(), pipelineLayout, nullptr);
+        PipelineStateCache::cleanup();
+        // 管线布局由Descriptor::PipelineLayoutCache持有，在Descriptor::cleanup中销毁
+        vkDestroyPipelineCache(Device::VulkanDevice::getLogicalDevice(), pipelineCache, nullptr);
+        pipelineCache = VK_NULL_HANDLE;
+    }
+
+    PipelineGeneration PipelineStateCache::current;
+    std::unordered_map<PipelineState, std::shared_ptr<Jobs::Counter>, PipelineStateHash> PipelineStateCache::inFlight;
+    std::shared_mutex PipelineStateCache::swapLock;
+    std::mutex PipelineStateCache::mapLock;
+
+    void PipelineStateCache::ensureShaderModules()
+    {
+        {
+            std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+            std::lock_guard<std::mutex> guard(mapLock);
+            if (current.program.vertModule != VK_NULL_HANDLE)
+                return;
+        }
+        // 在锁外加载，编译GLSL的任务可能在当前线程上执行
+        std::vector<char> vertCode;
+        std::vector<char> fragCode;
+        ShaderFactory::loadDefaultShaderCode(vertCode, fragCode);
+
+        std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+        std::lock_guard<std::mutex> guard(mapLock);
+        if (current.program.vertModule != VK_NULL_HANDLE)
+            return;
+        current.vertCode = std::move(vertCode);
+        current.fragCode = std::move(fragCode);
+        createProgram(current);
+        Capture::Recorder::recordShaderCode(current.vertCode, current.fragCode);
+        // 之后会有多个线程同时创建管线，render pass要先在这里创建好
+        RenderPassFactory::GetRenderPass();
+    }
+
+    VkPipeline PipelineStateCache::createState(const PipelineState& state, bool record)
+    {
+        // 创建期间持有共享锁，换代要等它完成，新管线不会混进新的一代
+        std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+        ShaderProgram program;
+        {
+            std::lock_guard<std::mutex> guard(mapLock);
+            auto found = current.pipelines.find(state);
+            if (found != current.pipelines.end())
+                return found->second;
+            program = current.program;
+        }
+
+        // 创建时不持有mapLock，其它状态的查找和创建不受影响
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        Pipeline::createPipelines(program, {state}, &pipeline);
+
+        std::lock_guard<std::mutex> guard(mapLock);
+        auto inserted = current.pipelines.emplace(state, pipeline);
+        if (!inserted.second)
+        {
+            // 其它线程先创建好了同一个状态
+            vkDestroyPipeline(Device::VulkanDevice::getLogicalDevice(), pipeline, nullptr);
+            return inserted.first->second;
+        }
+        if (record)
+            Capture::Recorder::recordPipeline(pipeline, state);
+        return pipeline;
+    }
+
+    VkPipelineLayout PipelineStateCache::getLayout()
+    {
+        ensureShaderModules();
+        std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+        std::lock_guard<std::mutex> guard(mapLock);
+        return current.program.layout;
+    }
+
+    VkPipeline PipelineStateCache::get(const PipelineState& state)
+    {
+        while (true)
+        {
+            std::shared_ptr<Jobs::Counter> pending;
+            {
+                std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+                std::lock_guard<std::mutex> guard(mapLock);
+                auto found = current.pipelines.find(state);
+                if (found != current.pipelines.end())
+                    return found->second;
+                auto building = inFlight.find(state);
+                if (building == inFlight.end())
+                    break;
+                pending = building->second;
+            }
+            // 等待期间当前线程帮忙执行其它任务；后台创建失败时下一轮在这里重新创建，异常抛给调用者
+            Jobs::JobSystem::wait(*pending);
+        }
+        ensureShaderModules();
+        return createState(state, true);
+    }
+
+    void PipelineStateCache::prewarm(const std::vector<PipelineState>& states)
+    {
+        std::vector<PipelineState> missing;
+        std::vector<std::shared_ptr<Jobs::Counter>> pending;
+        {
+            std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+            std::lock_guard<std::mutex> guard(mapLock);
+            for (const PipelineState& state : states)
+            {
+                auto building = inFlight.find(state);
+                if (building != inFlight.end())
+                    pending.push_back(building->second);
+                else if (current.pipelines.count(state) == 0 && std::find(missing.begin(), missing.end(), state) == missing.end())
+                    missing.push_back(state);
+            }
+        }
+        if (!missing.empty())
+        {
+            ensureShaderModules();
+            // 调用线程在parallelFor中等待，不会同时录制命令，工作线程可以在mapLock内写入捕获文件
+            std::vector<std::string> errors(missing.size());
+            Jobs::JobSystem::parallelFor(static_cast<uint32_t>(missing.size()), 1, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    try
+                    {
+                        createState(missing[i], true);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        errors[i] = e.what();
+                    }
+                }
+            });
+            for (const std::string& error : errors)
+            {
+                if (!error.empty())
+                    throw std::runtime_error(error);
+            }
+        }
+        for (const auto& counter : pending)
+            Jobs::JobSystem::wait(*counter);
+    }
+
+    void PipelineStateCache::prewarmAsync(const std::vector<PipelineState>& states)
+    {
+        // 捕获文件不是线程安全的，工作线程创建的管线无法在录制命令的同时写入
+        if (Capture::Recorder::isActive())
+        {
+            prewarm(states);
+            return;
+        }
+        ensureShaderModules();
+        std::vector<std::pair<PipelineState, std::shared_ptr<Jobs::Counter>>> jobs;
+        {
+            std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+            std::lock_guard<std::mutex> guard(mapLock);
+            for (const PipelineState& state : states)
+            {
+                if (current.pipelines.count(state) != 0 || inFlight.count(state) != 0)
+                    continue;
+                auto counter = std::make_shared<Jobs::Counter>();
+                inFlight.emplace(state, counter);
+                jobs.emplace_back(state, counter);
+            }
+        }
+        // 提交时不能持有锁，任务系统没有启动时任务直接在这里执行
+        for (const auto& job : jobs)
+        {
+            PipelineState state = job.first;
+            std::shared_ptr<Jobs::Counter> counter = job.second;
+            // 任务持有计数器，保证递减计数时它还存在
+            Jobs::JobSystem::run([state, counter]()
+            {
+                try
+                {
+                    createState(state, false);
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << "background pipeline creation failed: " << e.what() << std::endl;
+                }
+                std::lock_guard<std::mutex> guard(mapLock);
+                inFlight.erase(state);
+            }, counter.get());
+        }
+    }
+
+    PipelineGeneration PipelineStateCache::rebuild(const std::vector<char>& vertCode, const std::vector<char>& fragCode)
+    {
+        std::vector<PipelineState> states;
+        {
+            std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+            std::lock_guard<std::mutex> guard(mapLock);
+            for (const auto& entry : current.pipelines)
+                states.push_back(entry.first);
+        }
+
+        PipelineGeneration generation;
+        generation.vertCode = vertCode;
+        generation.fragCode = fragCode;
+        createProgram(generation);
+        if (states.empty())
+            return generation;
+
+        std::vector<VkPipeline> created(states.size(), VK_NULL_HANDLE);
+        try
+        {
+            createPipelinesParallel(generation.program, states, created.data());
+        }
+        catch (...)
+        {
+            destroy(generation);
+            throw;
+        }
+        for (size_t i = 0; i < states.size(); i++)
+            generation.pipelines.emplace(states[i], created[i]);
+        return generation;
+    }
+
+    void PipelineStateCache::swap(PipelineGeneration generation)
+    {
+        std::unique_lock<std::shared_mutex> swapGuard(swapLock);
+        replaceCurrent(std::move(generation));
+    }
+
+    bool PipelineStateCache::trySwap(PipelineGeneration& generation)
+    {
+        // createState在整个创建期间持有共享锁，这时拿不到独占锁
+        std::unique_lock<std::shared_mutex> swapGuard(swapLock, std::try_to_lock);
+        if (!swapGuard.owns_lock())
+            return false;
+        replaceCurrent(std::move(generation));
+        return true;
+    }
+
+    void PipelineStateCache::replaceCurrent(PipelineGeneration generation)
+    {
+        auto retired = std::make_shared<PipelineGeneration>(std::move(current));
+        current = std::move(generation);
+        if (current.program.vertModule != VK_NULL_HANDLE)
+        {
+            Capture::Recorder::recordShaderCode(current.vertCode, current.fragCode);
+            for (const auto& entry : current.pipelines)
+                Capture::Recorder::recordPipeline(entry.second, entry.first);
+        }
+        // 之前提交的帧可能还在使用旧的管线
+        Sync::DeletionQueue::retire(Sync::Graphics, [retired]()
+        {
+            destroy(*retired);
+        });
+    }
+
+    void PipelineStateCache::destroy(PipelineGeneration& generation)
+    {
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        for (const auto& entry : generation.pipelines)
+            vkDestroyPipeline(device, entry.second, nullptr);
+        generation.pipelines.clear();
+        if (generation.program.vertModule != VK_NULL_HANDLE)
+            vkDestroyShaderModule(device, generation.program.vertModule, nullptr);
+        if (generation.program.fragModule != VK_NULL_HANDLE)
+            vkDestroyShaderModule(device, generation.program.fragModule, nullptr);
+        generation.program = ShaderProgram{};
+    }
+
+    size_t PipelineStateCache::size()
+    {
+        std::shared_lock<std::shared_mutex> swapGuard(swapLock);
+        std::lock_guard<std::mutex> guard(mapLock);
+        return current.pipelines.size();
+    }
+
+    void PipelineStateCache::cleanup()
+    {
+        // 先等后台任务结束，它们会访问current
+        while (true)
+        {
+            std::shared_ptr<Jobs::Counter> pending;
+            {
+                std::lock_guard<std::mutex> guard(mapLock);
+                if (inFlight.empty())
+                    break;
+                pending = inFlight.begin()->second;
+            }
+            Jobs::JobSystem::wait(*pending);
+        }
+        std::unique_lock<std::shared_mutex> swapGuard(swapLock);
+        destroy(current);
+        current.vertCode.clear();
+        current.fragCode.clear();
     }
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "PipelineStats.h"
+#include "Device.h"
+#include "Config.h"
+#include "Present.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+
+namespace Profiling{
+    std::vector<PipelineStatistics::FrameQueries> PipelineStatistics::frames;
+    uint32_t PipelineStatistics::currentFrame = 0;
+    bool PipelineStatistics::statisticsSupported = false;
+    bool PipelineStatistics::occlusionPrecise = false;
+    std::vector<uint64_t> PipelineStatistics::results;
+    PipelineCounters PipelineStatistics::frameCounters;
+
+    namespace{
+        // 查询池的初始容量，某一帧超过时按2的幂扩大
+        const uint32_t INITIAL_DRAWS_PER_FRAME = 256;
+
+        // 结果按标志位从低到高排列，顺序与PipelineCounters前六个字段一致
+        const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        const uint32_t STATISTIC_COUNT = 6;
+
+        double ratio(uint64_t numerator, uint64_t denominator){
+            return denominator == 0 ? 0.0 : static_cast<double>(numerator) / denominator;
+        }
+    }
+
+    void PipelineStatistics::createQueryPools(){
+        if (!Config::enablePipelineStatistics) {
+            return;
+        }
+        // 逻辑设备启用了物理设备支持的全部核心特性，这里只需检查是否支持
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(Device::VulkanDevice::getPhysicalDevice(), &features);
+        statisticsSupported = features.pipelineStatisticsQuery == VK_TRUE;
+        occlusionPrecise = features.occlusionQueryPrecise == VK_TRUE;
+
+        frames.resize(Config::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : frames) {
+            createPools(frame, INITIAL_DRAWS_PER_FRAME);
+        }
+    }
+
+    void PipelineStatistics::createPools(FrameQueries& frame, uint32_t capacity){
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+        poolInfo.queryCount = capacity;
+        if (vkCreateQueryPool(device, &poolInfo, nullptr, &frame.occlusionPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create occlusion query pool!");
+        }
+
+        if (statisticsSupported) {
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+            if (vkCreateQueryPool(device, &poolInfo, nullptr, &frame.statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+        frame.capacity = capacity;
+        if (results.size() < static_cast<size_t>(capacity) * STATISTIC_COUNT) {
+            results.resize(static_cast<size_t>(capacity) * STATISTIC_COUNT);
+        }
+    }
+
+    void PipelineStatistics::destroyPools(FrameQueries& frame){
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        vkDestroyQueryPool(device, frame.occlusionPool, nullptr);
+        if (frame.statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, frame.statisticsPool, nullptr);
+        }
+        frame.occlusionPool = VK_NULL_HANDLE;
+        frame.statisticsPool = VK_NULL_HANDLE;
+        frame.capacity = 0;
+    }
+
+    bool PipelineStatistics::isEnabled(){
+        return !frames.empty();
+    }
+
+    void PipelineStatistics::readBack(uint32_t frameIndex){
+        FrameQueries& frame = frames[frameIndex];
+        PipelineCounters counters;
+        counters.drawCount = frame.drawCount;
+        counters.truncated = frame.drawCount > frame.capacity;
+        // 没有绘制的帧发布全零的计数，而不是沿用上一帧的结果
+        uint32_t queryCount = std::min(frame.drawCount, frame.capacity);
+        if (queryCount == 0) {
+            frameCounters = counters;
+            return;
+        }
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+
+        // 该槽位的帧已经完成，结果都已可用；万一没有就保留上一次的汇总
+        if (statisticsSupported) {
+            VkResult result = vkGetQueryPoolResults(device, frame.statisticsPool, 0, queryCount,
+                                                    sizeof(uint64_t) * STATISTIC_COUNT * queryCount, results.data(),
+                                                    sizeof(uint64_t) * STATISTIC_COUNT, VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS) {
+                return;
+            }
+            for (uint32_t draw = 0; draw < queryCount; draw++) {
+                const uint64_t* values = &results[draw * STATISTIC_COUNT];
+                counters.inputVertices += values[0];
+                counters.inputPrimitives += values[1];
+                counters.vertexShaderInvocations += values[2];
+                counters.clippingInvocations += values[3];
+                counters.clippingPrimitives += values[4];
+                counters.fragmentShaderInvocations += values[5];
+            }
+        }
+
+        VkResult result = vkGetQueryPoolResults(device, frame.occlusionPool, 0, queryCount,
+                                                sizeof(uint64_t) * queryCount, results.data(),
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return;
+        }
+        for (uint32_t draw = 0; draw < queryCount; draw++) {
+            counters.samplesPassed += results[draw];
+        }
+
+        frameCounters = counters;
+    }
+
+    void PipelineStatistics::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+        if (!isEnabled()) {
+            return;
+        }
+        readBack(frameIndex);
+
+        currentFrame = frameIndex;
+        FrameQueries& frame = frames[frameIndex];
+        // 该槽位的上一帧已经完成，不够用的查询池可以直接替换；场景的绘制数稳定后不再扩大
+        if (frame.drawCount > frame.capacity) {
+            uint32_t capacity = frame.capacity;
+            while (capacity < frame.drawCount) {
+                capacity *= 2;
+            }
+            destroyPools(frame);
+            createPools(frame, capacity);
+        }
+        frame.drawCount = 0;
+        vkCmdResetQueryPool(commandBuffer, frame.occlusionPool, 0, frame.capacity);
+        if (statisticsSupported) {
+            vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, frame.capacity);
+        }
+    }
+
+    void PipelineStatistics::beginDraw(VkCommandBuffer commandBuffer){
+        if (!isEnabled()) {
+            return;
+        }
+        FrameQueries& frame = frames[currentFrame];
+        // 查询用完后的绘制这一帧不再统计，只在endDraw中计数
+        if (frame.drawCount >= frame.capacity) {
+            return;
+        }
+        // 精确模式下得到实际通过的采样数，否则只保证非零
+        vkCmdBeginQuery(commandBuffer, frame.occlusionPool, frame.drawCount, occlusionPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+        if (statisticsSupported) {
+            vkCmdBeginQuery(commandBuffer, frame.statisticsPool, frame.drawCount, 0);
+        }
+    }
+
+    void PipelineStatistics::endDraw(VkCommandBuffer commandBuffer){
+        if (!isEnabled()) {
+            return;
+        }
+        FrameQueries& frame = frames[currentFrame];
+        if (frame.drawCount < frame.capacity) {
+            if (statisticsSupported) {
+                vkCmdEndQuery(commandBuffer, frame.statisticsPool, frame.drawCount);
+            }
+            vkCmdEndQuery(commandBuffer, frame.occlusionPool, frame.drawCount);
+        }
+        frame.drawCount++;
+    }
+
+    const PipelineCounters& PipelineStatistics::getFrameCounters(){
+        return frameCounters;
+    }
+
+    void PipelineStatistics::printReport(){
+        const PipelineCounters& counters = frameCounters;
+        if (!isEnabled()) {
+            return;
+        }
+        std::cout << "draws: " << counters.drawCount << ", samples passed: " << counters.samplesPassed
+                  << (occlusionPrecise ? "" : " (imprecise)") << std::endl;
+        if (counters.truncated) {
+            std::cout << "pipeline statistics truncated: query pools hold fewer queries than draws" << std::endl;
+        }
+        if (!statisticsSupported) {
+            std::cout << "pipeline statistics queries not supported" << std::endl;
+            return;
+        }
+        std::cout << "vertices: " << counters.inputVertices
+                  << ", vertex invocations: " << counters.vertexShaderInvocations
+                  << ", primitives: " << counters.inputPrimitives
+                  << ", clipped primitives: " << counters.clippingPrimitives
+                  << ", fragment invocations: " << counters.fragmentShaderInvocations << std::endl;
+
+        // 顶点着色次数接近顶点数说明顶点缓存命中率低；每个图元的片元数很少说明瓶颈在顶点端，很多则在填充率；
+        // 通过测试的采样数除以像素数是每个像素平均被写入的次数，即过度绘制
+        VkExtent2D extent = Presentation::SwapChain::getSwapChainExtent();
+        std::cout << "vertex reuse: " << ratio(counters.inputVertices, counters.vertexShaderInvocations)
+                  << ", fragments per primitive: " << ratio(counters.fragmentShaderInvocations, counters.clippingPrimitives);
+        if (occlusionPrecise) {
+            std::cout << ", overdraw: " << ratio(counters.samplesPassed, static_cast<uint64_t>(extent.width) * extent.height);
+        }
+        std::cout << std::endl;
+    }
+
+    void PipelineStatistics::cleanup(){
+        for (auto& frame : frames) {
+            destroyPools(frame);
+        }
+        frames.clear();
+    }
+}
@@ -3,6 +3,8 @@
 #include "Config.h"
 #include "window.h"
 #include "PipelineData.h"
+#include "Sync.h"
+#include "PresentPolicy.h"
 
 #include <limits>
 #include <algorithm>
@@ -17,6 +19,8 @@ namespace Presentation{
     VkFormat SwapChain::swapChainImageFormat = VK_FORMAT_UNDEFINED;
     VkExtent2D SwapChain::swapChainExtent;
     std::vector<VkImageView> SwapChain::swapChainImageViews{};
+    bool SwapChain::transferSource = false;
+    bool SwapChain::recreateRequested = false;
     
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
         for (const auto& availableFormat : availableFormats) {
@@ -28,22 +32,15 @@ namespace Presentation{
         return availableFormats[0];
     }
 
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
-            }
-        }
-
-        return VK_PRESENT_MODE_FIFO_KHR;
-    }
-
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
             return capabilities.currentExtent;
         } else {
-            int width, height;
-            glfwGetFramebufferSize(Init::GlfwWindow::getGlfwWindow(), &width, &height);
+            // 无窗口时surface没有固定大小，使用配置的分辨率
+            int width = static_cast<int>(Config::headlessExtent.width), height = static_cast<int>(Config::headlessExtent.height);
+            if (!Config::headless) {
+                glfwGetFramebufferSize(Init::GlfwWindow::getGlfwWindow(), &width, &height);
+            }
 
             VkExtent2D actualExtent = {
                 static_cast<uint32_t>(width),
@@ -57,18 +54,16 @@ namespace Presentation{
         }
     }
     
-    void SwapChain::createSwapChain() {
+    void SwapChain::createSwapChain(VkSwapchainKHR oldSwapChain) {
         // 获取surface支持的swapchain的功能,格式和显示模式
         Config::SwapChainSupportDetails swapChainSupport = Config::querySwapChainSupport(Device::VulkanDevice::getPhysicalDevice(), Device::VulkanDevice::getSurface());
         // 获取合适的swapchain功能,格式和显示模式
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-        if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-            imageCount = swapChainSupport.capabilities.maxImageCount;
-        }
+        // 呈现模式和图像数量由呈现策略按配置的目标决定
+        PresentSelection selection = PresentPolicy::select(swapChainSupport.capabilities, swapChainSupport.presentModes);
+        VkPresentModeKHR presentMode = selection.presentMode;
+        uint32_t imageCount = selection.imageCount;
         // 开始创建交换链
         VkSwapchainCreateInfoKHR createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -80,6 +75,11 @@ namespace Presentation{
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // 支持时允许复制出图像内容，供截图和回读使用
+        transferSource = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+        if (transferSource) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
         Device::QueueFamilyIndices indices =
          Device::VulkanDevice::findQueueFamilies(Device::VulkanDevice::getPhysicalDevice());
@@ -98,7 +98,8 @@ namespace Presentation{
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        // 传入旧交换链，驱动可以复用它的资源，旧交换链中已呈现的图像在销毁前仍然有效
+        createInfo.oldSwapchain = oldSwapChain;
         if (vkCreateSwapchainKHR(Device::VulkanDevice::getLogicalDevice(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
             throw std::runtime_error("failed to create swap chain!");
         }
@@ -139,20 +140,44 @@ namespace Presentation{
     }
 
     void SwapChain::recreateSwapChain() {
-        int width = 0, height = 0;
-        glfwGetFramebufferSize(Init::GlfwWindow::getGlfwWindow(), &width, &height);
-        while (width == 0 || height == 0) {
+        if (!Config::headless) {
+            int width = 0, height = 0;
             glfwGetFramebufferSize(Init::GlfwWindow::getGlfwWindow(), &width, &height);
-            glfwWaitEvents();
+            // 窗口最小化时等待恢复
+            while (width == 0 || height == 0) {
+                glfwWaitEvents();
+                glfwGetFramebufferSize(Init::GlfwWindow::getGlfwWindow(), &width, &height);
+            }
         }
+        recreateRequested = false;
 
-        vkDeviceWaitIdle(Device::VulkanDevice::getLogicalDevice());
-
-        cleanup();
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        VkSwapchainKHR oldSwapChain = swapChain;
+        std::vector<VkImageView> oldImageViews = swapChainImageViews;
+        std::vector<VkFramebuffer> oldFramebuffers = PipelineData::RenderPassFactory::getSwapChainFramebuffers();
 
-        createImageViews();
+        createSwapChain(oldSwapChain);
         createImageViews();
         PipelineData::RenderPassFactory::createFramebuffers();
+
+        // 仍在执行的帧可能还引用旧的图像视图和帧缓冲，等图形队列上已提交的工作完成后再销毁
+        Sync::DeletionQueue::retire(Sync::Graphics, [device, oldSwapChain, oldImageViews, oldFramebuffers](){
+            for (auto framebuffer : oldFramebuffers) {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (auto imageView : oldImageViews) {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        });
+    }
+
+    void SwapChain::requestRecreate(){
+        recreateRequested = true;
+    }
+
+    bool SwapChain::isRecreateRequested(){
+        return recreateRequested;
     }
 
     void SwapChain::DoInit(){
@@ -181,6 +206,16 @@ namespace Presentation{
     {
         return swapChainImageViews;
     }
+
+    VkImage SwapChain::getSwapChainImage(uint32_t imageIndex)
+    {
+        return swapChainImages[imageIndex];
+    }
+
+    bool SwapChain::isTransferSource()
+    {
+        return transferSource;
+    }
 }
 
 VkSwapchainKHR Presentation::SwapChain::getSwapChain()
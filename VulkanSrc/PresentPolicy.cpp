@@ -0,0 +1,123 @@
+#include "PresentPolicy.h"
+#include "Config.h"
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+namespace Presentation{
+    PresentSelection PresentPolicy::selection;
+
+    namespace{
+        const char* presentModeName(VkPresentModeKHR presentMode){
+            switch (presentMode) {
+                case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+                case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+                case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+                case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+                default: return "UNKNOWN";
+            }
+        }
+
+        const char* goalName(Config::PresentGoal goal){
+            switch (goal) {
+                case Config::PresentGoal::LowLatency: return "low latency";
+                case Config::PresentGoal::PowerSaving: return "power saving";
+                case Config::PresentGoal::MaxThroughput: return "max throughput";
+            }
+            return "unknown";
+        }
+    }
+
+    VkPresentModeKHR PresentPolicy::choosePresentMode(const std::vector<VkPresentModeKHR>& availableModes){
+        // 按目标排列的优先顺序，FIFO所有设备都支持，放在最后兜底
+        std::vector<VkPresentModeKHR> preferred;
+        switch (Config::presentGoal) {
+            case Config::PresentGoal::LowLatency:
+                // MAILBOX总是显示最新的一帧且不撕裂，IMMEDIATE延迟更低但会撕裂
+                preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+                break;
+            case Config::PresentGoal::PowerSaving:
+                // FIFO按显示器刷新率限制帧率，GPU在等待垂直同步时可以降频
+                preferred = {};
+                break;
+            case Config::PresentGoal::MaxThroughput:
+                preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+                break;
+        }
+
+        for (VkPresentModeKHR mode : preferred) {
+            if (std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end()) {
+                return mode;
+            }
+        }
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    uint32_t PresentPolicy::chooseImageCount(VkPresentModeKHR presentMode, const VkSurfaceCapabilitiesKHR& capabilities){
+        uint32_t imageCount = capabilities.minImageCount;
+        switch (Config::presentGoal) {
+            case Config::PresentGoal::LowLatency:
+                // FIFO下图像越多排队越长；MAILBOX需要三张图像才能在显示的同时替换等待中的那一帧
+                imageCount = presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? std::max(capabilities.minImageCount, 3u) : capabilities.minImageCount;
+                break;
+            case Config::PresentGoal::PowerSaving:
+                imageCount = capabilities.minImageCount;
+                break;
+            case Config::PresentGoal::MaxThroughput:
+                // 多一张图像，GPU不会因为等待可用图像而停顿
+                imageCount = capabilities.minImageCount + 1;
+                break;
+        }
+
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+            imageCount = capabilities.maxImageCount;
+        }
+        return imageCount;
+    }
+
+    PresentSelection PresentPolicy::select(const VkSurfaceCapabilitiesKHR& capabilities, const std::vector<VkPresentModeKHR>& availableModes){
+        selection.presentMode = choosePresentMode(availableModes);
+        selection.imageCount = chooseImageCount(selection.presentMode, capabilities);
+        Pacing::FramePacer::setQueuedFrames(countQueuedFrames(selection));
+        return selection;
+    }
+
+    PresentSelection PresentPolicy::getSelection(){
+        return selection;
+    }
+
+    uint32_t PresentPolicy::countQueuedFrames(const PresentSelection& presentSelection){
+        // FIFO类模式下，已提交的帧按顺序排队显示，排队深度受交换链图像数和在途帧数共同限制；
+        // MAILBOX和IMMEDIATE会用最新的帧替换或立即显示，不会排队
+        if (presentSelection.presentMode != VK_PRESENT_MODE_FIFO_KHR && presentSelection.presentMode != VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+            return 0;
+        }
+        uint32_t imageQueue = presentSelection.imageCount > 0 ? presentSelection.imageCount - 1 : 0;
+        return std::min<uint32_t>(imageQueue, Config::MAX_FRAMES_IN_FLIGHT);
+    }
+
+    LatencyReport PresentPolicy::estimateLatency(){
+        LatencyReport report;
+        report.selection = selection;
+        report.queuedFrames = countQueuedFrames(selection);
+        Pacing::Percentiles latency = Pacing::FramePacer::getPercentiles(Pacing::FramePacer::Metric::ModeledLatency);
+        report.p50 = latency.p50;
+        report.p95 = latency.p95;
+        report.p99 = latency.p99;
+        return report;
+    }
+
+    void PresentPolicy::printReport(){
+        LatencyReport report = estimateLatency();
+        Pacing::Percentiles interval = Pacing::FramePacer::getPercentiles(Pacing::FramePacer::Metric::PresentInterval);
+
+        std::cout << "present goal: " << goalName(Config::presentGoal)
+                  << ", mode: " << presentModeName(report.selection.presentMode)
+                  << ", images: " << report.selection.imageCount << std::endl;
+        std::cout << "frame interval ms p50/p95/p99: " << interval.p50 << " / " << interval.p95 << " / " << interval.p99 << std::endl;
+        std::cout << "modeled latency ms p50/p95/p99: " << report.p50 << " / " << report.p95 << " / " << report.p99
+                  << " (cpu time + " << report.queuedFrames << " queued frames + scanout, not measured at display)" << std::endl;
+    }
+}
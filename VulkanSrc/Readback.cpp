@@ -0,0 +1,255 @@
+#include "Readback.h"
+#include "Device.h"
+#include "MeshData.h"
+#include "Present.h"
+#include "Config.h"
+#include "ImageDiff.h"
+#include "Jobs.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Readback{
+    void DoInit(){
+        FrameReadback::createRing();
+        if (Config::screenshotPath != nullptr) {
+            FrameReadback::addCallback([](const Frame& frame){
+                if (frame.frameNumber != Config::screenshotFrame) {
+                    return;
+                }
+                bool bgra = frame.format == VK_FORMAT_B8G8R8A8_UNORM || frame.format == VK_FORMAT_B8G8R8A8_SRGB;
+                bool rgba = frame.format == VK_FORMAT_R8G8B8A8_UNORM || frame.format == VK_FORMAT_R8G8B8A8_SRGB;
+                if (!bgra && !rgba) {
+                    std::cerr << "screenshot only supports 8-bit BGRA/RGBA swapchain formats" << std::endl;
+                    return;
+                }
+                // 保存编码后的字节，SRGB格式的截图与屏幕上看到的一致
+                ImageDiff::writePpm(Config::screenshotPath,
+                                    ImageDiff::fromPixels(frame.data, frame.rowPitch, frame.width, frame.height, rgba));
+            });
+        }
+    }
+    void cleanup(){
+        FrameReadback::cleanup();
+    }
+
+    namespace{
+        const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+        // 只支持每像素4或8字节的非压缩颜色格式，交换链常用的格式都在其中
+        uint32_t bytesPerPixel(VkFormat format){
+            switch (format) {
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+                return 4;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return 8;
+            default:
+                return 0;
+            }
+        }
+
+        void transitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage){
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+    }
+
+    std::vector<FrameReadback::Slot> FrameReadback::slots;
+    std::vector<uint32_t> FrameReadback::frameSlots;
+    uint32_t FrameReadback::nextSlot = 0;
+    std::vector<std::function<void(const Frame&)>> FrameReadback::callbacks;
+    VkMemoryPropertyFlags FrameReadback::memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint64_t FrameReadback::frameNumber = 0;
+
+    void FrameReadback::createRing(){
+        slots.assign(Config::MAX_FRAMES_IN_FLIGHT + RETAINED_SLOTS, Slot{});
+        frameSlots.assign(Config::MAX_FRAMES_IN_FLIGHT, NO_SLOT);
+        nextSlot = 0;
+        // CPU要逐字节读取结果，优先选带缓存的内存，非一致内存在读取前失效缓存
+        VkPhysicalDeviceMemoryProperties properties;
+        vkGetPhysicalDeviceMemoryProperties(Device::VulkanDevice::getPhysicalDevice(), &properties);
+        VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+            if ((properties.memoryTypes[i].propertyFlags & cached) == cached) {
+                memoryProperties = cached;
+                break;
+            }
+        }
+    }
+
+    void FrameReadback::addCallback(std::function<void(const Frame&)> callback){
+        callbacks.push_back(std::move(callback));
+    }
+
+    void FrameReadback::clearCallbacks(){
+        callbacks.clear();
+    }
+
+    bool FrameReadback::isEnabled(){
+        return !callbacks.empty() && Presentation::SwapChain::isTransferSource();
+    }
+
+    void FrameReadback::retain(const Frame& frame, std::shared_ptr<Jobs::Counter> counter){
+        slots[frame.slot].retainers.push_back(std::move(counter));
+    }
+
+    void FrameReadback::release(uint32_t slotIndex){
+        Slot& slot = slots[slotIndex];
+        // 处理速度跟不上时在这里等待，等待期间当前线程帮忙执行任务
+        for (const auto& counter : slot.retainers) {
+            Jobs::JobSystem::wait(*counter);
+        }
+        slot.retainers.clear();
+    }
+
+    void FrameReadback::ensureCapacity(uint32_t slotIndex, VkDeviceSize size){
+        // 调用时该缓冲区上一次的复制已经完成并交付，保留它的任务也已结束，可以直接替换
+        Slot& slot = slots[slotIndex];
+        if (slot.capacity >= size) {
+            return;
+        }
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        if (slot.buffer != VK_NULL_HANDLE) {
+            vkUnmapMemory(device, slot.memory);
+            vkDestroyBuffer(device, slot.buffer, nullptr);
+            vkFreeMemory(device, slot.memory, nullptr);
+        }
+        Mesh::SimpleMesh::createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties, slot.buffer, slot.memory);
+        if (vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map readback buffer memory!");
+        }
+        slot.capacity = size;
+    }
+
+    void FrameReadback::recordCopy(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImage image, VkExtent2D extent, VkFormat format){
+        uint32_t pixelSize = bytesPerPixel(format);
+        if (!isEnabled() || pixelSize == 0) {
+            return;
+        }
+        // 环比在途帧多，轮到的缓冲区上一次的帧早已完成并交付，只可能还被回调保留
+        uint32_t slotIndex = nextSlot;
+        nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+        release(slotIndex);
+        VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * pixelSize;
+        ensureCapacity(slotIndex, size);
+        Slot& slot = slots[slotIndex];
+        frameSlots[frameIndex] = slotIndex;
+
+        // render pass把图像留在PRESENT_SRC布局，复制前转换为传输源，复制后转换回去再呈现。
+        // 颜色写入和render pass的布局转换由它到外部的依赖同步到传输阶段，这里从传输阶段接上这条依赖链
+        transitionImage(commandBuffer, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        0, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;  // 0表示紧密排列
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {extent.width, extent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+        transitionImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_ACCESS_TRANSFER_READ_BIT, 0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+        // 复制结果对主机可见
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = slot.buffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = size;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+        slot.pending = true;
+        slot.frame.width = extent.width;
+        slot.frame.height = extent.height;
+        slot.frame.rowPitch = extent.width * pixelSize;
+        slot.frame.format = format;
+        slot.frame.frameNumber = frameNumber++;
+        slot.frame.slot = slotIndex;
+    }
+
+    void FrameReadback::collect(uint32_t frameIndex){
+        if (frameIndex >= frameSlots.size() || frameSlots[frameIndex] == NO_SLOT) {
+            return;
+        }
+        Slot& slot = slots[frameSlots[frameIndex]];
+        frameSlots[frameIndex] = NO_SLOT;
+        if (!slot.pending) {
+            return;
+        }
+        slot.pending = false;
+        if (callbacks.empty()) {
+            return;
+        }
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(Device::VulkanDevice::getLogicalDevice(), 1, &range);
+
+        slot.frame.data = static_cast<const uint8_t*>(slot.mapped);
+        for (const auto& callback : callbacks) {
+            callback(slot.frame);
+        }
+    }
+
+    void FrameReadback::collectAll(){
+        std::vector<uint32_t> pending;
+        for (uint32_t i = 0; i < frameSlots.size(); i++) {
+            if (frameSlots[i] != NO_SLOT && slots[frameSlots[i]].pending) {
+                pending.push_back(i);
+            }
+        }
+        std::sort(pending.begin(), pending.end(), [](uint32_t a, uint32_t b){
+            return slots[frameSlots[a]].frame.frameNumber < slots[frameSlots[b]].frame.frameNumber;
+        });
+        for (uint32_t frameIndex : pending) {
+            collect(frameIndex);
+        }
+    }
+
+    void FrameReadback::cleanup(){
+        VkDevice device = Device::VulkanDevice::getLogicalDevice();
+        for (uint32_t i = 0; i < slots.size(); i++) {
+            release(i);
+            Slot& slot = slots[i];
+            if (slot.buffer != VK_NULL_HANDLE) {
+                vkUnmapMemory(device, slot.memory);
+                vkDestroyBuffer(device, slot.buffer, nullptr);
+                vkFreeMemory(device, slot.memory, nullptr);
+            }
+        }
+        slots.clear();
+        frameSlots.clear();
+        callbacks.clear();
+    }
+}
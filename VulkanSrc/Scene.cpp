@@ -0,0 +1,427 @@
+#include "Scene.h"
+#include "Device.h"
+#include "Config.h"
+#include "MeshData.h"
+#include "Bindless.h"
+#include "Jobs.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace Scene{
+    VkBuffer InstanceStream::buffer = VK_NULL_HANDLE;
+    VkDeviceMemory InstanceStream::bufferMemory = VK_NULL_HANDLE;
+    void* InstanceStream::mappedData = nullptr;
+    VkDeviceSize InstanceStream::frameStride = 0;
+    uint32_t InstanceStream::capacity = 0;
+    uint32_t InstanceStream::nextSlot = 0;
+    uint32_t InstanceStream::currentFrame = 0;
+    std::vector<uint32_t> InstanceStream::freeSlots;
+    std::vector<uint32_t> InstanceStream::bufferIndices;
+
+    std::vector<uint32_t> SceneGraph::handleToIndex;
+    std::vector<uint32_t> SceneGraph::handleParent;
+    std::vector<uint32_t> SceneGraph::handleDepth;
+    std::vector<std::vector<uint32_t>> SceneGraph::handleChildren;
+    std::vector<uint32_t> SceneGraph::parentIndex;
+    std::vector<uint32_t> SceneGraph::indexToHandle;
+    std::vector<uint32_t> SceneGraph::instanceSlot;
+    std::vector<glm::mat4> SceneGraph::localTransforms;
+    std::vector<glm::mat4> SceneGraph::worldTransforms;
+    std::vector<uint8_t> SceneGraph::dirty;
+    std::vector<uint8_t> SceneGraph::pendingFrames;
+    std::vector<uint32_t> SceneGraph::levelOffsets;
+    bool SceneGraph::layoutDirty = false;
+    std::vector<uint32_t> SceneGraph::dirtyNodes;
+    std::vector<uint32_t> SceneGraph::updateList;
+    std::vector<uint32_t> SceneGraph::updateLevels;
+    std::vector<uint32_t> SceneGraph::pendingUploads;
+
+    namespace{
+        const uint32_t MAX_INSTANCES = 128 * 1024;
+        // 每个任务处理的节点数，一层中少于该数量的节点直接在当前线程更新
+        const uint32_t NODES_PER_JOB = 8 * 1024;
+        // 直接修改的节点超过总数的这个比例时，按层顺序扫描全部节点比逐个收集子树更快
+        const uint32_t DENSE_UPDATE_DIVISOR = 4;
+    }
+
+    void DoInit(){
+        InstanceStream::createStream(MAX_INSTANCES);
+    }
+
+    void cleanup(){
+        SceneGraph::clear();
+        InstanceStream::cleanup();
+    }
+
+    void InstanceStream::createStream(uint32_t instanceCapacity){
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(Device::VulkanDevice::getPhysicalDevice(), &properties);
+        VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+
+        capacity = instanceCapacity;
+        frameStride = (sizeof(glm::mat4) * capacity + alignment - 1) / alignment * alignment;
+        VkDeviceSize bufferSize = frameStride * Config::MAX_FRAMES_IN_FLIGHT;
+
+        // 每帧写入一次、GPU读取一次的数据，直接放在主机可见内存中，省去暂存缓冲区和拷贝命令
+        Mesh::SimpleMesh::createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       buffer, bufferMemory);
+        if (vkMapMemory(Device::VulkanDevice::getLogicalDevice(), bufferMemory, 0, bufferSize, 0, &mappedData) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map instance buffer memory!");
+        }
+
+        bufferIndices.assign(Config::MAX_FRAMES_IN_FLIGHT, Descriptor::BindlessHeap::INVALID_INDEX);
+        if (Descriptor::BindlessHeap::isEnabled()) {
+            for (int i = 0; i < Config::MAX_FRAMES_IN_FLIGHT; i++) {
+                bufferIndices[i] = Descriptor::BindlessHeap::registerStorageBuffer(buffer, frameStride * i, sizeof(glm::mat4) * capacity);
+            }
+        }
+    }
+
+    uint32_t InstanceStream::acquireSlot(){
+        if (!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (nextSlot >= capacity) {
+            throw std::runtime_error("instance buffer is full!");
+        }
+        return nextSlot++;
+    }
+
+    void InstanceStream::releaseSlot(uint32_t slot){
+        if (slot != INVALID_INSTANCE) {
+            freeSlots.push_back(slot);
+        }
+    }
+
+    void InstanceStream::setCurrentFrame(uint32_t frameIndex){
+        currentFrame = frameIndex;
+    }
+
+    glm::mat4* InstanceStream::getFrameData(uint32_t frameIndex){
+        if (mappedData == nullptr) {
+            return nullptr;
+        }
+        return reinterpret_cast<glm::mat4*>(static_cast<char*>(mappedData) + frameStride * frameIndex);
+    }
+
+    uint32_t InstanceStream::getCurrentBufferIndex(){
+        if (bufferIndices.empty()) {
+            return Descriptor::BindlessHeap::INVALID_INDEX;
+        }
+        return bufferIndices[currentFrame];
+    }
+
+    uint32_t InstanceStream::getSlotCount(){
+        return nextSlot;
+    }
+
+    uint32_t InstanceStream::getCapacity(){
+        return capacity;
+    }
+
+    void InstanceStream::cleanup(){
+        for (uint32_t index : bufferIndices) {
+            Descriptor::BindlessHeap::release(Descriptor::BindlessHeap::StorageBuffers, index);
+        }
+        bufferIndices.clear();
+        if (buffer != VK_NULL_HANDLE) {
+            vkUnmapMemory(Device::VulkanDevice::getLogicalDevice(), bufferMemory);
+            vkDestroyBuffer(Device::VulkanDevice::getLogicalDevice(), buffer, nullptr);
+            vkFreeMemory(Device::VulkanDevice::getLogicalDevice(), bufferMemory, nullptr);
+        }
+        buffer = VK_NULL_HANDLE;
+        bufferMemory = VK_NULL_HANDLE;
+        mappedData = nullptr;
+        capacity = 0;
+        nextSlot = 0;
+        currentFrame = 0;
+        freeSlots.clear();
+    }
+
+    uint32_t SceneGraph::createNode(uint32_t parent, bool renderable){
+        uint32_t handle = static_cast<uint32_t>(handleToIndex.size());
+        uint32_t depth = 0;
+        uint32_t parentPosition = INVALID_NODE;
+        if (parent != INVALID_NODE) {
+            if (parent >= handle) {
+                throw std::runtime_error("scene node parent does not exist!");
+            }
+            depth = handleDepth[parent] + 1;
+            parentPosition = handleToIndex[parent];
+        }
+
+        // 先追加到末尾，只要新节点不比最深一层浅，数组仍然按深度有序，否则在下一次更新前重新排序
+        uint32_t index = static_cast<uint32_t>(parentIndex.size());
+        if (levelOffsets.empty()) {
+            levelOffsets.push_back(0);
+        }
+        uint32_t levelCount = static_cast<uint32_t>(levelOffsets.size()) - 1;
+        if (!layoutDirty && depth + 1 == levelCount) {
+            levelOffsets.back() = index + 1;
+        } else if (!layoutDirty && depth == levelCount) {
+            levelOffsets.push_back(index + 1);
+        } else {
+            layoutDirty = true;
+        }
+
+        handleToIndex.push_back(index);
+        handleParent.push_back(parent);
+        handleDepth.push_back(depth);
+        handleChildren.emplace_back();
+        if (parent != INVALID_NODE) {
+            handleChildren[parent].push_back(handle);
+        }
+
+        parentIndex.push_back(parentPosition);
+        indexToHandle.push_back(handle);
+        instanceSlot.push_back(renderable ? InstanceStream::acquireSlot() : INVALID_INSTANCE);
+        localTransforms.emplace_back(1.0f);
+        worldTransforms.emplace_back(1.0f);
+        dirty.push_back(1);
+        pendingFrames.push_back(0);
+        dirtyNodes.push_back(handle);
+        return handle;
+    }
+
+    void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& transform){
+        uint32_t index = handleToIndex[node];
+        localTransforms[index] = transform;
+        if (!dirty[index]) {
+            dirty[index] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    const glm::mat4& SceneGraph::getLocalTransform(uint32_t node){
+        return localTransforms[handleToIndex[node]];
+    }
+
+    const glm::mat4& SceneGraph::getWorldTransform(uint32_t node){
+        return worldTransforms[handleToIndex[node]];
+    }
+
+    uint32_t SceneGraph::getInstanceIndex(uint32_t node){
+        return instanceSlot[handleToIndex[node]];
+    }
+
+    uint32_t SceneGraph::getNodeCount(){
+        return static_cast<uint32_t>(handleToIndex.size());
+    }
+
+    void SceneGraph::clear(){
+        for (uint32_t slot : instanceSlot) {
+            InstanceStream::releaseSlot(slot);
+        }
+        handleToIndex.clear();
+        handleParent.clear();
+        handleDepth.clear();
+        handleChildren.clear();
+        parentIndex.clear();
+        indexToHandle.clear();
+        instanceSlot.clear();
+        localTransforms.clear();
+        worldTransforms.clear();
+        dirty.clear();
+        pendingFrames.clear();
+        levelOffsets.clear();
+        layoutDirty = false;
+        dirtyNodes.clear();
+        updateList.clear();
+        updateLevels.clear();
+        pendingUploads.clear();
+    }
+
+    void SceneGraph::rebuildLayout(){
+        uint32_t nodeCount = getNodeCount();
+        uint32_t levelCount = 0;
+        for (uint32_t depth : handleDepth) {
+            levelCount = std::max(levelCount, depth + 1);
+        }
+
+        // 按深度做计数排序，同一层内保持创建顺序
+        levelOffsets.assign(levelCount + 1, 0);
+        for (uint32_t depth : handleDepth) {
+            levelOffsets[depth + 1]++;
+        }
+        for (uint32_t level = 0; level < levelCount; level++) {
+            levelOffsets[level + 1] += levelOffsets[level];
+        }
+        std::vector<uint32_t> cursor(levelOffsets.begin(), levelOffsets.end() - 1);
+        std::vector<uint32_t> newIndex(nodeCount);
+        for (uint32_t handle = 0; handle < nodeCount; handle++) {
+            newIndex[handle] = cursor[handleDepth[handle]]++;
+        }
+
+        std::vector<uint32_t> sortedParent(nodeCount);
+        std::vector<uint32_t> sortedInstance(nodeCount);
+        std::vector<glm::mat4> sortedLocal(nodeCount);
+        std::vector<glm::mat4> sortedWorld(nodeCount);
+        std::vector<uint8_t> sortedDirty(nodeCount);
+        std::vector<uint8_t> sortedPending(nodeCount);
+        for (uint32_t handle = 0; handle < nodeCount; handle++) {
+            uint32_t from = handleToIndex[handle];
+            uint32_t to = newIndex[handle];
+            sortedParent[to] = handleParent[handle] == INVALID_NODE ? INVALID_NODE : newIndex[handleParent[handle]];
+            sortedInstance[to] = instanceSlot[from];
+            sortedLocal[to] = localTransforms[from];
+            sortedWorld[to] = worldTransforms[from];
+            sortedDirty[to] = dirty[from];
+            sortedPending[to] = pendingFrames[from];
+        }
+
+        for (uint32_t handle = 0; handle < nodeCount; handle++) {
+            indexToHandle[newIndex[handle]] = handle;
+        }
+        handleToIndex.swap(newIndex);
+        parentIndex.swap(sortedParent);
+        instanceSlot.swap(sortedInstance);
+        localTransforms.swap(sortedLocal);
+        worldTransforms.swap(sortedWorld);
+        dirty.swap(sortedDirty);
+        pendingFrames.swap(sortedPending);
+        layoutDirty = false;
+    }
+
+    void SceneGraph::collectUpdates(){
+        // 从直接修改的节点出发收集整棵子树；dirty标记保证每个节点只进入一次，
+        // 已经被标记的子节点要么自己在dirtyNodes中，要么已经被收集，不需要再展开
+        std::vector<uint32_t> collected;
+        collected.swap(dirtyNodes);
+        for (size_t i = 0; i < collected.size(); i++) {
+            for (uint32_t child : handleChildren[collected[i]]) {
+                uint32_t childIndex = handleToIndex[child];
+                if (!dirty[childIndex]) {
+                    dirty[childIndex] = 1;
+                    collected.push_back(child);
+                }
+            }
+        }
+
+        // 同一层内的顺序无关，按深度做计数排序，父节点所在的层总在子节点之前
+        uint32_t levelCount = levelOffsets.empty() ? 0 : static_cast<uint32_t>(levelOffsets.size()) - 1;
+        updateLevels.assign(levelCount + 1, 0);
+        for (uint32_t node : collected) {
+            updateLevels[handleDepth[node] + 1]++;
+        }
+        for (uint32_t level = 0; level < levelCount; level++) {
+            updateLevels[level + 1] += updateLevels[level];
+        }
+        std::vector<uint32_t> cursor(updateLevels.begin(), updateLevels.end() - 1);
+        updateList.resize(collected.size());
+        for (uint32_t node : collected) {
+            updateList[cursor[handleDepth[node]]++] = node;
+        }
+        // 把容量还给dirtyNodes，下一帧收集时不用重新分配
+        collected.clear();
+        dirtyNodes.swap(collected);
+    }
+
+    void SceneGraph::updateRange(uint32_t begin, uint32_t end, glm::mat4* frameData){
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t index = handleToIndex[updateList[i]];
+            uint32_t parent = parentIndex[index];
+            worldTransforms[index] = parent == INVALID_NODE ? localTransforms[index] : worldTransforms[parent] * localTransforms[index];
+            // 矩阵还在缓存中，顺便写入当前帧的数据段
+            if (instanceSlot[index] != INVALID_INSTANCE && frameData != nullptr) {
+                frameData[instanceSlot[index]] = worldTransforms[index];
+            }
+        }
+    }
+
+    void SceneGraph::updateDenseRange(uint32_t begin, uint32_t end, glm::mat4* frameData){
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t parent = parentIndex[i];
+            // 父节点所在的层已经更新完，它的脏标记会沿层级向下传递
+            if (parent != INVALID_NODE && dirty[parent]) {
+                dirty[i] = 1;
+            }
+            if (dirty[i]) {
+                worldTransforms[i] = parent == INVALID_NODE ? localTransforms[i] : worldTransforms[parent] * localTransforms[i];
+                if (instanceSlot[i] != INVALID_INSTANCE && frameData != nullptr) {
+                    frameData[instanceSlot[i]] = worldTransforms[i];
+                }
+            }
+        }
+    }
+
+    void SceneGraph::uploadPending(glm::mat4* frameData){
+        // 每帧有独立的实例数据段，矩阵变化后需要依次写入所有帧的数据段；
+        // 本帧重新计算过的节点已经写入，由markPending重新计数
+        for (uint32_t node : pendingUploads) {
+            uint32_t index = handleToIndex[node];
+            if (!dirty[index]) {
+                frameData[instanceSlot[index]] = worldTransforms[index];
+                pendingFrames[index]--;
+            }
+        }
+        // 所有帧都写过的节点从列表中移除，保持剩余节点的顺序
+        pendingUploads.erase(std::remove_if(pendingUploads.begin(), pendingUploads.end(), [](uint32_t node){
+            return pendingFrames[handleToIndex[node]] == 0;
+        }), pendingUploads.end());
+    }
+
+    void SceneGraph::markPending(uint32_t index, bool written){
+        dirty[index] = 0;
+        if (instanceSlot[index] == INVALID_INSTANCE) {
+            return;
+        }
+        uint8_t remaining = static_cast<uint8_t>(Config::MAX_FRAMES_IN_FLIGHT - (written ? 1 : 0));
+        if (pendingFrames[index] == 0 && remaining != 0) {
+            pendingUploads.push_back(indexToHandle[index]);
+        }
+        pendingFrames[index] = remaining;
+    }
+
+    void SceneGraph::update(uint32_t frameIndex){
+        if (layoutDirty) {
+            rebuildLayout();
+        }
+        InstanceStream::setCurrentFrame(frameIndex);
+        glm::mat4* frameData = InstanceStream::getFrameData(frameIndex);
+
+        // 同一层内的节点互不依赖，层与层之间必须按顺序执行
+        uint32_t nodeCount = getNodeCount();
+        bool dense = dirtyNodes.size() * DENSE_UPDATE_DIVISOR >= nodeCount;
+        if (dense) {
+            // 大部分节点都被修改，按层顺序扫描全部节点比逐个收集子树快
+            dirtyNodes.clear();
+            uint32_t levelCount = levelOffsets.empty() ? 0 : static_cast<uint32_t>(levelOffsets.size()) - 1;
+            for (uint32_t level = 0; level < levelCount; level++) {
+                uint32_t levelBegin = levelOffsets[level];
+                Jobs::JobSystem::parallelFor(levelOffsets[level + 1] - levelBegin, NODES_PER_JOB, [levelBegin, frameData](uint32_t begin, uint32_t end){
+                    updateDenseRange(levelBegin + begin, levelBegin + end, frameData);
+                });
+            }
+        } else {
+            collectUpdates();
+            for (uint32_t level = 0; level + 1 < updateLevels.size(); level++) {
+                uint32_t levelBegin = updateLevels[level];
+                Jobs::JobSystem::parallelFor(updateLevels[level + 1] - levelBegin, NODES_PER_JOB, [levelBegin, frameData](uint32_t begin, uint32_t end){
+                    updateRange(levelBegin + begin, levelBegin + end, frameData);
+                });
+            }
+        }
+
+        // 先补写之前变化、还没写入当前帧数据段的节点，再登记本帧变化的节点
+        if (frameData != nullptr) {
+            uploadPending(frameData);
+        }
+        bool written = frameData != nullptr;
+        if (dense) {
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                if (dirty[i]) {
+                    markPending(i, written);
+                }
+            }
+        } else {
+            for (uint32_t node : updateList) {
+                markPending(handleToIndex[node], written);
+            }
+        }
+    }
+}
@@ -0,0 +1,322 @@
+#include "ShaderCompiler.h"
+#include "Jobs.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef VULKAN_HAS_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+
+namespace ShaderCompiler{
+    namespace{
+#ifdef VULKAN_HAS_SHADERC
+        shaderc_compiler_t compiler = nullptr;
+#endif
+        // 缓存文件的格式或编译选项改变时增加，旧的缓存自然失效
+        const char* CACHE_SETTINGS = "spirv-cache-1;vulkan1.2;performance;main";
+        const uint32_t SPIRV_MAGIC = 0x07230203;
+
+        // FNV-1a 128位，跨平台和跨构建结果稳定，适合作为磁盘上的键
+        class Hasher{
+        public:
+            void update(const void* data, size_t size){
+                const uint8_t* bytes = static_cast<const uint8_t*>(data);
+                for (size_t i = 0; i < size; i++) {
+                    state ^= bytes[i];
+                    state *= PRIME;
+                }
+            }
+            // 先写长度再写内容，相邻字段之间不会互相混淆
+            void field(const std::string& text){
+                uint64_t size = text.size();
+                update(&size, sizeof(size));
+                update(text.data(), text.size());
+            }
+            std::string hex() const{
+                static const char digits[] = "0123456789abcdef";
+                std::string result(32, '0');
+                unsigned __int128 value = state;
+                for (int i = 31; i >= 0; i--) {
+                    result[i] = digits[static_cast<uint32_t>(value & 0xF)];
+                    value >>= 4;
+                }
+                return result;
+            }
+
+        private:
+            static constexpr unsigned __int128 PRIME = (static_cast<unsigned __int128>(1) << 88) + 0x13B;
+            unsigned __int128 state = (static_cast<unsigned __int128>(0x6C62272E07BB0142ull) << 64) | 0x62B821756295C58Dull;
+        };
+
+        bool readText(const std::string& path, std::string& text){
+            std::ifstream file{path, std::ios::binary};
+            if (!file.is_open()) {
+                return false;
+            }
+            text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+            return true;
+        }
+
+        // #include的文件相对包含它的文件所在目录查找
+        std::string resolveIncludePath(const std::string& requestingPath, const std::string& requested){
+            size_t slash = requestingPath.find_last_of('/');
+            return slash == std::string::npos ? requested : requestingPath.substr(0, slash + 1) + requested;
+        }
+
+        // 逐行找出#include "name"或#include <name>，不考虑条件编译，多算进键里的文件只会让缓存更保守
+        std::vector<std::string> findIncludes(const std::string& source){
+            std::vector<std::string> includes;
+            size_t position = 0;
+            while (position < source.size()) {
+                size_t end = source.find('\n', position);
+                if (end == std::string::npos) {
+                    end = source.size();
+                }
+                size_t i = source.find_first_not_of(" \t", position);
+                if (i < end && source[i] == '#') {
+                    i = source.find_first_not_of(" \t", i + 1);
+                    if (i < end && source.compare(i, 7, "include") == 0) {
+                        i = source.find_first_not_of(" \t", i + 7);
+                        if (i < end && (source[i] == '"' || source[i] == '<')) {
+                            char close = source[i] == '"' ? '"' : '>';
+                            size_t nameEnd = source.find(close, i + 1);
+                            if (nameEnd < end) {
+                                includes.push_back(source.substr(i + 1, nameEnd - i - 1));
+                            }
+                        }
+                    }
+                }
+                position = end + 1;
+            }
+            return includes;
+        }
+
+        void hashIncludes(Hasher& hasher, const std::string& path, const std::string& source, std::set<std::string>& visited){
+            for (const std::string& name : findIncludes(source)) {
+                std::string includePath = resolveIncludePath(path, name);
+                hasher.field(name);
+                // 带include guard的文件只展开一次，也避免循环包含
+                if (!visited.insert(includePath).second) {
+                    continue;
+                }
+                std::string content;
+                if (!readText(includePath, content)) {
+                    // 找不到的文件留给编译器报错
+                    hasher.field("<missing>");
+                    continue;
+                }
+                hasher.field(content);
+                hashIncludes(hasher, includePath, content, visited);
+            }
+        }
+
+        bool isSpirv(const std::vector<char>& code){
+            if (code.size() < 20 || code.size() % 4 != 0) {
+                return false;
+            }
+            uint32_t magic;
+            std::copy_n(code.data(), sizeof(magic), reinterpret_cast<char*>(&magic));
+            return magic == SPIRV_MAGIC;
+        }
+
+        std::string cachePath(const std::string& key){
+            std::string directory = Config::shaderCacheDirectory;
+            if (!directory.empty() && directory.back() != '/') {
+                directory += '/';
+            }
+            return directory + key + ".spv";
+        }
+
+        // 先写临时文件再改名，并行编译或多个进程同时写同一个键时读到的总是完整文件
+        void storeCacheFile(const std::string& path, const std::vector<char>& code){
+            mkdir(Config::shaderCacheDirectory, 0755);
+            // 进程号区分不同进程，线程号的哈希只在同一进程内唯一
+            std::string temporary = path + ".tmp" + std::to_string(getpid()) + "-"
+                                    + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+            std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+            if (!file.is_open()) {
+                return;
+            }
+            file.write(code.data(), static_cast<std::streamsize>(code.size()));
+            file.close();
+            if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+                std::remove(temporary.c_str());
+            }
+        }
+
+#ifdef VULKAN_HAS_SHADERC
+        struct IncludeResult{
+            shaderc_include_result result;
+            std::string name;
+            std::string content;
+        };
+
+        shaderc_include_result* resolveInclude(void*, const char* requested, int, const char* requesting, size_t){
+            IncludeResult* include = new IncludeResult();
+            include->name = resolveIncludePath(requesting, requested);
+            if (!readText(include->name, include->content)) {
+                // 名字为空表示解析失败，内容作为错误信息
+                include->content = "cannot open include file " + include->name;
+                include->name.clear();
+            }
+            include->result = {include->name.data(), include->name.size(), include->content.data(), include->content.size(), include};
+            return &include->result;
+        }
+
+        void releaseInclude(void*, shaderc_include_result* result){
+            delete static_cast<IncludeResult*>(result->user_data);
+        }
+#endif
+    }
+
+    void DoInit(){
+#ifdef VULKAN_HAS_SHADERC
+        compiler = shaderc_compiler_initialize();
+        if (compiler == nullptr) {
+            throw std::runtime_error("failed to initialize shader compiler!");
+        }
+#endif
+    }
+    void cleanup(){
+#ifdef VULKAN_HAS_SHADERC
+        if (compiler != nullptr) {
+            shaderc_compiler_release(compiler);
+            compiler = nullptr;
+        }
+#endif
+    }
+
+    std::atomic<uint64_t> SpirvCache::hitCount{0};
+    std::atomic<uint64_t> SpirvCache::missCount{0};
+
+    bool SpirvCache::isAvailable(){
+#ifdef VULKAN_HAS_SHADERC
+        return compiler != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    std::string SpirvCache::computeKey(const CompileRequest& request){
+        std::string source;
+        if (!readText(request.path, source)) {
+            throw std::runtime_error("failed to open file " + request.path + "!");
+        }
+        Hasher hasher;
+        hasher.field(CACHE_SETTINGS);
+#ifdef VULKAN_HAS_SHADERC
+        // 编译器升级后生成的代码可能不同，VULKAN_SHADERC_ID是构建时链接的shaderc库的哈希
+        hasher.field(VULKAN_SHADERC_ID);
+#endif
+        hasher.field(request.stage == Stage::Vertex ? "vert" : "frag");
+        // 宏定义与顺序无关
+        std::vector<std::pair<std::string, std::string>> defines = request.defines;
+        std::sort(defines.begin(), defines.end());
+        for (const auto& define : defines) {
+            hasher.field(define.first);
+            hasher.field(define.second);
+        }
+        hasher.field(source);
+        std::set<std::string> visited;
+        hashIncludes(hasher, request.path, source, visited);
+        return hasher.hex();
+    }
+
+    std::vector<char> SpirvCache::compileSource(const CompileRequest& request){
+#ifdef VULKAN_HAS_SHADERC
+        std::string source;
+        if (!readText(request.path, source)) {
+            throw std::runtime_error("failed to open file " + request.path + "!");
+        }
+        // 编译器对象可以被多个线程同时使用，选项每次单独创建
+        shaderc_compile_options_t options = shaderc_compile_options_initialize();
+        shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+        shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+        shaderc_compile_options_set_include_callbacks(options, resolveInclude, releaseInclude, nullptr);
+        for (const auto& define : request.defines) {
+            shaderc_compile_options_add_macro_definition(options, define.first.data(), define.first.size(),
+                                                         define.second.data(), define.second.size());
+        }
+        shaderc_shader_kind kind = request.stage == Stage::Vertex ? shaderc_vertex_shader : shaderc_fragment_shader;
+        shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, source.data(), source.size(), kind,
+                                                                       request.path.c_str(), "main", options);
+        shaderc_compile_options_release(options);
+        if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+            std::string message = shaderc_result_get_error_message(result);
+            shaderc_result_release(result);
+            throw std::runtime_error("failed to compile shader " + request.path + "!\n" + message);
+        }
+        const char* bytes = shaderc_result_get_bytes(result);
+        std::vector<char> code(bytes, bytes + shaderc_result_get_length(result));
+        shaderc_result_release(result);
+        return code;
+#else
+        throw std::runtime_error("compiling " + request.path + " requires a build with shaderc!");
+#endif
+    }
+
+    std::vector<char> SpirvCache::compile(const CompileRequest& request){
+        std::string path = cachePath(computeKey(request));
+        std::vector<char> cached;
+        {
+            std::ifstream file{path, std::ios::binary};
+            if (file.is_open()) {
+                cached.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+            }
+        }
+        // 损坏或写了一半的缓存文件当作未命中
+        if (isSpirv(cached)) {
+            hitCount++;
+            return cached;
+        }
+        missCount++;
+        std::vector<char> code = compileSource(request);
+        storeCacheFile(path, code);
+        return code;
+    }
+
+    std::vector<std::vector<char>> SpirvCache::compileAll(const std::vector<CompileRequest>& requests){
+        std::vector<std::vector<char>> results(requests.size());
+        std::vector<std::string> errors(requests.size());
+        // 每个着色器一个任务，异常在任务内捕获，全部完成后再统一抛出
+        Jobs::JobSystem::parallelFor(static_cast<uint32_t>(requests.size()), 1, [&](uint32_t begin, uint32_t end){
+            for (uint32_t i = begin; i < end; i++) {
+                try {
+                    results[i] = compile(requests[i]);
+                } catch (const std::exception& e) {
+                    errors[i] = e.what();
+                }
+            }
+        });
+        std::string message;
+        for (const std::string& error : errors) {
+            if (!error.empty()) {
+                message += (message.empty() ? "" : "\n") + error;
+            }
+        }
+        if (!message.empty()) {
+            throw std::runtime_error(message);
+        }
+        return results;
+    }
+
+    uint64_t SpirvCache::getHitCount(){
+        return hitCount.load();
+    }
+
+    uint64_t SpirvCache::getMissCount(){
+        return missCount.load();
+    }
+}
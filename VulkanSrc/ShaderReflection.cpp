@@ -0,0 +1,485 @@
+#include "ShaderReflection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+
+namespace ShaderReflection{
+    namespace{
+        const uint32_t SPIRV_MAGIC = 0x07230203;
+        const uint32_t NOT_SET = 0xFFFFFFFF;
+
+        // 只列出反射用到的操作码、装饰和存储类型，数值见SPIR-V规范
+        enum Op : uint32_t{
+            OpEntryPoint = 15,
+            OpTypeBool = 20,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpSpecConstant = 50,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+            OpTypeAccelerationStructureKHR = 5341
+        };
+
+        enum Decoration : uint32_t{
+            DecorationBlock = 2,
+            DecorationBufferBlock = 3,
+            DecorationArrayStride = 6,
+            DecorationMatrixStride = 7,
+            DecorationBuiltIn = 11,
+            DecorationLocation = 30,
+            DecorationBinding = 33,
+            DecorationDescriptorSet = 34,
+            DecorationOffset = 35
+        };
+
+        enum StorageClass : uint32_t{
+            StorageUniformConstant = 0,
+            StorageInput = 1,
+            StorageUniform = 2,
+            StoragePushConstant = 9,
+            StorageStorageBuffer = 12
+        };
+
+        const uint32_t DIM_BUFFER = 5;
+        const uint32_t DIM_SUBPASS_DATA = 6;
+
+        struct Type{
+            uint32_t opcode = 0;
+            uint32_t width = 0;        // 标量位宽
+            bool isSigned = false;
+            uint32_t element = 0;      // 向量分量、矩阵列、数组元素或指针指向的类型
+            uint32_t count = 0;        // 向量分量数或矩阵列数
+            uint32_t lengthId = 0;     // 数组长度常量
+            uint32_t storageClass = 0;
+            uint32_t dim = 0;          // 图像维度
+            uint32_t sampled = 0;      // 1为采样图像，2为存储图像
+            std::vector<uint32_t> members;
+        };
+
+        struct Decorations{
+            uint32_t location = NOT_SET;
+            uint32_t binding = NOT_SET;
+            uint32_t set = 0;
+            uint32_t arrayStride = 0;
+            bool builtIn = false;
+            bool bufferBlock = false;
+        };
+
+        struct MemberDecorations{
+            uint32_t offset = NOT_SET;
+            uint32_t matrixStride = 0;
+            bool builtIn = false;
+        };
+
+        struct Variable{
+            uint32_t id;
+            uint32_t type;
+            uint32_t storageClass;
+        };
+
+        // 一遍扫描收集类型、常量、装饰和全局变量，之后按需查询
+        class Module{
+        public:
+            explicit Module(const std::vector<char>& code){
+                if (code.size() < 20 || code.size() % 4 != 0) {
+                    throw std::runtime_error("failed to reflect shader: invalid SPIR-V size!");
+                }
+                words.resize(code.size() / 4);
+                std::memcpy(words.data(), code.data(), code.size());
+                if (words[0] != SPIRV_MAGIC) {
+                    throw std::runtime_error("failed to reflect shader: invalid SPIR-V magic!");
+                }
+                size_t position = 5;
+                while (position < words.size()) {
+                    uint32_t wordCount = words[position] >> 16;
+                    if (wordCount == 0 || position + wordCount > words.size()) {
+                        throw std::runtime_error("failed to reflect shader: truncated SPIR-V instruction!");
+                    }
+                    parseInstruction(words[position] & 0xFFFF, &words[position], wordCount);
+                    position += wordCount;
+                }
+                if (executionModel == NOT_SET) {
+                    throw std::runtime_error("failed to reflect shader: no entry point!");
+                }
+            }
+
+            uint32_t executionModel = NOT_SET;
+            std::vector<Variable> variables;
+
+            const Type& type(uint32_t id) const{
+                auto found = types.find(id);
+                if (found == types.end()) {
+                    throw std::runtime_error("failed to reflect shader: unknown type id!");
+                }
+                return found->second;
+            }
+
+            Decorations decorations(uint32_t id) const{
+                auto found = decorationMap.find(id);
+                return found == decorationMap.end() ? Decorations{} : found->second;
+            }
+
+            MemberDecorations memberDecorations(uint32_t structId, uint32_t member) const{
+                auto found = memberDecorationMap.find(structId);
+                if (found == memberDecorationMap.end() || member >= found->second.size()) {
+                    return MemberDecorations{};
+                }
+                return found->second[member];
+            }
+
+            // 特化常量按默认值计算
+            uint32_t arrayLength(const Type& array) const{
+                auto found = constants.find(array.lengthId);
+                if (found == constants.end()) {
+                    throw std::runtime_error("failed to reflect shader: array length is not a constant!");
+                }
+                return found->second;
+            }
+
+            // 按std140/std430的偏移和步长计算大小，不定长数组计为0
+            uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const{
+                const Type& t = type(typeId);
+                switch (t.opcode) {
+                    case OpTypeBool:
+                        return 4;
+                    case OpTypeInt:
+                    case OpTypeFloat:
+                        return t.width / 8;
+                    case OpTypeVector:
+                        return t.count * sizeOf(t.element);
+                    case OpTypeMatrix:
+                        return t.count * (matrixStride != 0 ? matrixStride : sizeOf(t.element));
+                    case OpTypeArray: {
+                        uint32_t stride = decorations(typeId).arrayStride;
+                        return arrayLength(t) * (stride != 0 ? stride : sizeOf(t.element));
+                    }
+                    case OpTypeStruct: {
+                        uint32_t size = 0;
+                        for (uint32_t i = 0; i < t.members.size(); i++) {
+                            MemberDecorations member = memberDecorations(typeId, i);
+                            uint32_t offset = member.offset != NOT_SET ? member.offset : size;
+                            size = std::max(size, offset + sizeOf(t.members[i], member.matrixStride));
+                        }
+                        return size;
+                    }
+                    default:
+                        return 0;
+                }
+            }
+
+        private:
+            void parseInstruction(uint32_t opcode, const uint32_t* op, uint32_t wordCount){
+                switch (opcode) {
+                    case OpEntryPoint:
+                        // 只反射第一个入口点
+                        if (executionModel == NOT_SET) {
+                            executionModel = op[1];
+                        }
+                        break;
+                    case OpTypeBool:
+                    case OpTypeSampler:
+                    case OpTypeSampledImage:
+                    case OpTypeAccelerationStructureKHR:
+                        types[op[1]].opcode = opcode;
+                        break;
+                    case OpTypeInt:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].width = op[2];
+                        types[op[1]].isSigned = op[3] != 0;
+                        break;
+                    case OpTypeFloat:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].width = op[2];
+                        break;
+                    case OpTypeVector:
+                    case OpTypeMatrix:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].element = op[2];
+                        types[op[1]].count = op[3];
+                        break;
+                    case OpTypeImage:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].dim = op[3];
+                        types[op[1]].sampled = op[7];
+                        break;
+                    case OpTypeArray:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].element = op[2];
+                        types[op[1]].lengthId = op[3];
+                        break;
+                    case OpTypeRuntimeArray:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].element = op[2];
+                        break;
+                    case OpTypeStruct:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].members.assign(op + 2, op + wordCount);
+                        break;
+                    case OpTypePointer:
+                        types[op[1]].opcode = opcode;
+                        types[op[1]].storageClass = op[2];
+                        types[op[1]].element = op[3];
+                        break;
+                    case OpConstant:
+                    case OpSpecConstant:
+                        // 64位常量只取低32位，数组长度不会超过这个范围
+                        if (wordCount > 3) {
+                            constants[op[2]] = op[3];
+                        }
+                        break;
+                    case OpVariable:
+                        variables.push_back({op[2], op[1], op[3]});
+                        break;
+                    case OpDecorate: {
+                        Decorations& decoration = decorationMap[op[1]];
+                        uint32_t value = wordCount > 3 ? op[3] : 0;
+                        switch (op[2]) {
+                            case DecorationLocation: decoration.location = value; break;
+                            case DecorationBinding: decoration.binding = value; break;
+                            case DecorationDescriptorSet: decoration.set = value; break;
+                            case DecorationArrayStride: decoration.arrayStride = value; break;
+                            case DecorationBuiltIn: decoration.builtIn = true; break;
+                            case DecorationBufferBlock: decoration.bufferBlock = true; break;
+                            default: break;
+                        }
+                        break;
+                    }
+                    case OpMemberDecorate: {
+                        std::vector<MemberDecorations>& members = memberDecorationMap[op[1]];
+                        if (members.size() <= op[2]) {
+                            members.resize(op[2] + 1);
+                        }
+                        uint32_t value = wordCount > 4 ? op[4] : 0;
+                        switch (op[3]) {
+                            case DecorationOffset: members[op[2]].offset = value; break;
+                            case DecorationMatrixStride: members[op[2]].matrixStride = value; break;
+                            case DecorationBuiltIn: members[op[2]].builtIn = true; break;
+                            default: break;
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            std::vector<uint32_t> words;
+            std::unordered_map<uint32_t, Type> types;
+            std::unordered_map<uint32_t, uint32_t> constants;
+            std::unordered_map<uint32_t, Decorations> decorationMap;
+            std::unordered_map<uint32_t, std::vector<MemberDecorations>> memberDecorationMap;
+        };
+
+        VkShaderStageFlagBits toStage(uint32_t executionModel){
+            switch (executionModel) {
+                case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+                case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+                case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+                case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+                case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+                case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+                default: throw std::runtime_error("failed to reflect shader: unsupported execution model!");
+            }
+        }
+
+        VkFormat inputFormat(const Module& module, const Type& t){
+            const Type& scalar = t.opcode == OpTypeVector ? module.type(t.element) : t;
+            uint32_t components = t.opcode == OpTypeVector ? t.count : 1;
+            if (scalar.width != 32 || components < 1 || components > 4) {
+                throw std::runtime_error("failed to reflect vertex input: only 32-bit scalars and vectors are supported!");
+            }
+            static const VkFormat floatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+            static const VkFormat intFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+            static const VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+            if (scalar.opcode == OpTypeFloat) {
+                return floatFormats[components - 1];
+            }
+            if (scalar.opcode == OpTypeInt) {
+                return scalar.isSigned ? intFormats[components - 1] : uintFormats[components - 1];
+            }
+            throw std::runtime_error("failed to reflect vertex input: unsupported component type!");
+        }
+
+        // 数组的每个元素和矩阵的每一列各占一个位置
+        void addInputs(const Module& module, uint32_t typeId, uint32_t& location, std::vector<VertexInput>& inputs){
+            const Type& t = module.type(typeId);
+            if (t.opcode == OpTypeArray || t.opcode == OpTypeMatrix) {
+                uint32_t count = t.opcode == OpTypeArray ? module.arrayLength(t) : t.count;
+                for (uint32_t i = 0; i < count; i++) {
+                    addInputs(module, t.element, location, inputs);
+                }
+                return;
+            }
+            inputs.push_back({location, inputFormat(module, t), module.sizeOf(typeId)});
+            location++;
+        }
+
+        VkDescriptorType descriptorType(const Module& module, uint32_t storageClass, uint32_t typeId, const Decorations& typeDecorations){
+            const Type& t = module.type(typeId);
+            if (storageClass == StorageStorageBuffer) {
+                return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+            if (storageClass == StorageUniform) {
+                // 旧版本SPIR-V用Uniform加BufferBlock表示存储缓冲区
+                return typeDecorations.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            }
+            switch (t.opcode) {
+                case OpTypeSampler:
+                    return VK_DESCRIPTOR_TYPE_SAMPLER;
+                case OpTypeSampledImage:
+                    return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                case OpTypeImage:
+                    if (t.dim == DIM_BUFFER) {
+                        return t.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                    }
+                    if (t.dim == DIM_SUBPASS_DATA) {
+                        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                    }
+                    return t.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                default:
+                    throw std::runtime_error("failed to reflect shader: unsupported descriptor type!");
+            }
+        }
+    }
+
+    ModuleInfo reflect(const std::vector<char>& code){
+        Module module(code);
+        ModuleInfo info{};
+        info.stage = toStage(module.executionModel);
+
+        uint32_t pushConstantEnd = 0;
+        info.pushConstants.offset = NOT_SET;
+        for (const Variable& variable : module.variables) {
+            const Type& pointer = module.type(variable.type);
+            uint32_t typeId = pointer.element;
+            Decorations decorations = module.decorations(variable.id);
+
+            if (variable.storageClass == StorageInput) {
+                if (info.stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn) {
+                    continue;
+                }
+                // gl_PerVertex之类的内建块没有location
+                const Type& t = module.type(typeId);
+                if (t.opcode == OpTypeStruct && module.memberDecorations(typeId, 0).builtIn) {
+                    continue;
+                }
+                if (decorations.location == NOT_SET) {
+                    throw std::runtime_error("failed to reflect vertex input: missing location!");
+                }
+                uint32_t location = decorations.location;
+                addInputs(module, typeId, location, info.inputs);
+            } else if (variable.storageClass == StorageUniformConstant || variable.storageClass == StorageUniform ||
+                       variable.storageClass == StorageStorageBuffer) {
+                if (decorations.binding == NOT_SET) {
+                    continue;
+                }
+                // 去掉数组，数量是各维长度之积
+                uint32_t count = 1;
+                while (module.type(typeId).opcode == OpTypeArray || module.type(typeId).opcode == OpTypeRuntimeArray) {
+                    const Type& array = module.type(typeId);
+                    count = array.opcode == OpTypeArray ? count * module.arrayLength(array) : 0;
+                    typeId = array.element;
+                }
+                if (module.type(typeId).opcode == OpTypeAccelerationStructureKHR) {
+                    throw std::runtime_error("failed to reflect shader: acceleration structures are not supported!");
+                }
+                VkDescriptorType type = descriptorType(module, variable.storageClass, typeId, module.decorations(typeId));
+                info.bindings.push_back({decorations.set, decorations.binding, type, count, static_cast<VkShaderStageFlags>(info.stage)});
+            } else if (variable.storageClass == StoragePushConstant) {
+                const Type& block = module.type(typeId);
+                for (uint32_t i = 0; i < block.members.size(); i++) {
+                    MemberDecorations member = module.memberDecorations(typeId, i);
+                    uint32_t offset = member.offset != NOT_SET ? member.offset : 0;
+                    info.pushConstants.offset = std::min(info.pushConstants.offset, offset);
+                }
+                pushConstantEnd = std::max(pushConstantEnd, module.sizeOf(typeId));
+            }
+        }
+
+        if (pushConstantEnd == 0) {
+            info.pushConstants = {};
+        } else {
+            // 范围的偏移和大小都要是4的倍数
+            info.pushConstants.stageFlags = info.stage;
+            info.pushConstants.offset &= ~3u;
+            info.pushConstants.size = ((pushConstantEnd + 3) & ~3u) - info.pushConstants.offset;
+        }
+
+        std::sort(info.inputs.begin(), info.inputs.end(), [](const VertexInput& a, const VertexInput& b){
+            return a.location < b.location;
+        });
+        std::sort(info.bindings.begin(), info.bindings.end(), [](const ResourceBinding& a, const ResourceBinding& b){
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        });
+        return info;
+    }
+
+    VertexInputLayout makeVertexInput(const ModuleInfo& vertexModule){
+        VertexInputLayout layout{};
+        layout.binding.binding = 0;
+        layout.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        uint32_t offset = 0;
+        for (const VertexInput& input : vertexModule.inputs) {
+            layout.attributes.push_back({input.location, 0, input.format, offset});
+            offset += input.size;
+        }
+        layout.binding.stride = offset;
+        return layout;
+    }
+
+    LayoutDescription mergeLayouts(const std::vector<const ModuleInfo*>& modules){
+        // 按(set, binding)合并，同一个资源被多个阶段使用时累加stageFlags
+        std::map<std::pair<uint32_t, uint32_t>, ResourceBinding> merged;
+        LayoutDescription description{};
+        uint32_t pushConstantBegin = NOT_SET;
+        uint32_t pushConstantEnd = 0;
+        for (const ModuleInfo* module : modules) {
+            for (const ResourceBinding& binding : module->bindings) {
+                auto inserted = merged.emplace(std::make_pair(binding.set, binding.binding), binding);
+                if (inserted.second) {
+                    continue;
+                }
+                ResourceBinding& existing = inserted.first->second;
+                if (existing.type != binding.type || existing.count != binding.count) {
+                    throw std::runtime_error("failed to merge shader layouts: binding " + std::to_string(binding.binding) +
+                                             " in set " + std::to_string(binding.set) + " differs between stages!");
+                }
+                existing.stageFlags |= binding.stageFlags;
+            }
+            if (module->pushConstants.size != 0) {
+                pushConstantBegin = std::min(pushConstantBegin, module->pushConstants.offset);
+                pushConstantEnd = std::max(pushConstantEnd, module->pushConstants.offset + module->pushConstants.size);
+                description.pushConstants.stageFlags |= module->pushConstants.stageFlags;
+            }
+        }
+
+        for (const auto& entry : merged) {
+            const ResourceBinding& binding = entry.second;
+            if (description.sets.size() <= binding.set) {
+                description.sets.resize(binding.set + 1);
+            }
+            description.sets[binding.set].push_back({binding.binding, binding.type, binding.count, binding.stageFlags, nullptr});
+        }
+        if (pushConstantEnd != 0) {
+            description.pushConstants.offset = pushConstantBegin;
+            description.pushConstants.size = pushConstantEnd - pushConstantBegin;
+        }
+        return description;
+    }
+}
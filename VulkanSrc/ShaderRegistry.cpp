@@ -0,0 +1,43 @@
+#include "ShaderRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace ShaderRegistry{
+    namespace{
+#ifdef VULKAN_HAS_EMBEDDED_SHADERS
+        // 生成的表按名字升序排列
+#include "EmbeddedShaders.inc"
+        const EmbeddedShader* const shadersBegin = std::begin(EMBEDDED_SHADERS);
+        const EmbeddedShader* const shadersEnd = std::end(EMBEDDED_SHADERS);
+#else
+        const EmbeddedShader* const shadersBegin = nullptr;
+        const EmbeddedShader* const shadersEnd = nullptr;
+#endif
+    }
+
+    const EmbeddedShader* EmbeddedShaders::find(const std::string& name){
+        const EmbeddedShader* shader = std::lower_bound(shadersBegin, shadersEnd, name, [](const EmbeddedShader& entry, const std::string& key){
+            return strcmp(entry.name, key.c_str()) < 0;
+        });
+        if (shader == shadersEnd || name != shader->name) {
+            return nullptr;
+        }
+        return shader;
+    }
+
+    std::vector<char> EmbeddedShaders::getCode(const std::string& name){
+        const EmbeddedShader* shader = find(name);
+        if (shader == nullptr) {
+            throw std::runtime_error("failed to find embedded shader " + name + "!");
+        }
+        const char* bytes = reinterpret_cast<const char*>(shader->code);
+        return std::vector<char>(bytes, bytes + shader->wordCount * sizeof(uint32_t));
+    }
+
+    size_t EmbeddedShaders::getCount(){
+        return static_cast<size_t>(shadersEnd - shadersBegin);
+    }
+}
@@ -0,0 +1,193 @@
+#include "ShaderReload.h"
+#include "PipelineData.h"
+#include "Config.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+
+namespace ShaderReload{
+    void DoInit(){
+        if (!Config::enableShaderHotReload || Config::headless) {
+            return;
+        }
+        ShaderWatcher::start(Config::shaderDirectory);
+    }
+    void cleanup(){
+        ShaderWatcher::stop();
+    }
+
+    namespace{
+        const uint32_t SPIRV_MAGIC = 0x07230203;
+
+        // 预编译的字节码、GLSL源码和被它们包含的文件
+        bool isWatchedFile(const char* name){
+            size_t length = strlen(name);
+            for (const char* extension : {".spv", ".vert", ".frag", ".glsl"}) {
+                size_t extensionLength = strlen(extension);
+                if (length > extensionLength && strcmp(name + length - extensionLength, extension) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 编辑器可能先截断再写入，长度或魔数不对时等下一次写入
+        bool isSpirv(const std::vector<char>& code){
+            if (code.size() < 20 || code.size() % 4 != 0) {
+                return false;
+            }
+            uint32_t magic;
+            memcpy(&magic, code.data(), sizeof(magic));
+            return magic == SPIRV_MAGIC;
+        }
+
+        // 读出所有已到达的事件，返回其中是否有被监视的文件
+        bool drainEvents(int fd){
+            alignas(struct inotify_event) char buffer[4096];
+            bool changed = false;
+            while (true) {
+                ssize_t length = read(fd, buffer, sizeof(buffer));
+                if (length <= 0) {
+                    return changed;
+                }
+                for (ssize_t offset = 0; offset < length;) {
+                    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+                    if (event->len > 0 && isWatchedFile(event->name)) {
+                        changed = true;
+                    }
+                    offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+                }
+            }
+        }
+    }
+
+    std::string ShaderWatcher::directory;
+    int ShaderWatcher::inotifyFd = -1;
+    int ShaderWatcher::wakeFd = -1;
+    std::thread ShaderWatcher::watcher;
+    std::mutex ShaderWatcher::pendingLock;
+    std::atomic<bool> ShaderWatcher::hasPending{false};
+    std::unique_ptr<PipelineData::PipelineGeneration> ShaderWatcher::pendingGeneration;
+    uint64_t ShaderWatcher::reloadCount = 0;
+
+    void ShaderWatcher::start(const std::string& watchDirectory){
+        directory = watchDirectory;
+        if (!directory.empty() && directory.back() != '/') {
+            directory += '/';
+        }
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        // 只关心写完的文件和改名进来的文件，后者覆盖了先写临时文件再改名的保存方式
+        if (inotifyFd < 0 || wakeFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "shader hot reload disabled: cannot watch " << directory << std::endl;
+            stop();
+            return;
+        }
+        watcher = std::thread(watchLoop);
+    }
+
+    void ShaderWatcher::stop(){
+        if (watcher.joinable()) {
+            uint64_t value = 1;
+            if (write(wakeFd, &value, sizeof(value)) != sizeof(value)) {
+                std::cerr << "failed to wake shader watcher" << std::endl;
+            }
+            watcher.join();
+        }
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+        if (wakeFd >= 0) {
+            close(wakeFd);
+            wakeFd = -1;
+        }
+        // 还没换上去的一代从未被GPU使用，可以直接销毁
+        std::lock_guard<std::mutex> guard(pendingLock);
+        if (pendingGeneration) {
+            PipelineData::PipelineStateCache::destroy(*pendingGeneration);
+            pendingGeneration.reset();
+        }
+        hasPending.store(false, std::memory_order_relaxed);
+    }
+
+    void ShaderWatcher::watchLoop(){
+        struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                continue;
+            }
+            if (fds[1].revents & POLLIN) {
+                return;
+            }
+            if (!drainEvents(inotifyFd)) {
+                continue;
+            }
+            // 顶点和片元着色器通常一起编译，等事件停下来后再重建
+            while (poll(fds, 2, DEBOUNCE_MILLISECONDS) > 0) {
+                if (fds[1].revents & POLLIN) {
+                    return;
+                }
+                drainEvents(inotifyFd);
+            }
+            rebuild();
+        }
+    }
+
+    void ShaderWatcher::rebuild(){
+        std::vector<char> vertCode;
+        std::vector<char> fragCode;
+        std::unique_ptr<PipelineData::PipelineGeneration> generation;
+        try {
+            // 启动时可能用的是嵌入的字节码，重建时总是读取目录中修改后的文件
+            PipelineData::ShaderFactory::loadShaderCodeFromDirectory(vertCode, fragCode);
+            if (!isSpirv(vertCode) || !isSpirv(fragCode)) {
+                return;
+            }
+            generation.reset(new PipelineData::PipelineGeneration(PipelineData::PipelineStateCache::rebuild(vertCode, fragCode)));
+        } catch (const std::exception& e) {
+            // 编译错误不影响正在使用的管线
+            std::cerr << "shader reload failed: " << e.what() << std::endl;
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(pendingLock);
+        // 上一次重建的结果还没换上去，直接丢弃
+        if (pendingGeneration) {
+            PipelineData::PipelineStateCache::destroy(*pendingGeneration);
+        }
+        pendingGeneration = std::move(generation);
+        hasPending.store(true, std::memory_order_release);
+    }
+
+    void ShaderWatcher::applyPending(){
+        // 没有新管线时只读一次原子变量
+        if (!hasPending.load(std::memory_order_acquire)) {
+            return;
+        }
+        // 监视线程正在放入新的一代时也不等待
+        std::unique_lock<std::mutex> guard(pendingLock, std::try_to_lock);
+        if (!guard.owns_lock() || !pendingGeneration) {
+            return;
+        }
+        // 后台还有管线在创建时不等待，保留这一代下一帧再换，主循环不会被编译阻塞
+        if (!PipelineData::PipelineStateCache::trySwap(*pendingGeneration)) {
+            return;
+        }
+        pendingGeneration.reset();
+        hasPending.store(false, std::memory_order_relaxed);
+        reloadCount++;
+        std::cout << "shaders reloaded (" << reloadCount << ")" << std::endl;
+    }
+
+    uint64_t ShaderWatcher::getReloadCount(){
+        return reloadCount;
+    }
+}
@@ -0,0 +1,220 @@
+#include "Sync.h"
+#include "Device.h"
+
+#include <stdexcept>
+
+
+namespace Sync{
+    Timeline::QueueTimeline Timeline::timelines[QueueTypeCount];
+    uint32_t Timeline::timelineIndex[QueueTypeCount] = {Graphics, Graphics, Graphics};
+    std::mutex DeletionQueue::lock;
+    std::deque<DeletionQueue::PendingDeletion> DeletionQueue::pending;
+
+    void DoInit(){
+        Timeline::createTimelines();
+    }
+
+    void cleanup(){
+        DeletionQueue::flush();
+        Timeline::cleanup();
+    }
+
+    void Timeline::createTimelines(){
+        // 目前设备只创建了图形队列，计算和传输提交也走图形队列，共用同一条时间线
+        timelineIndex[Graphics] = Graphics;
+        timelineIndex[Compute] = Graphics;
+        timelineIndex[Transfer] = Graphics;
+        timelines[Graphics].queue = Device::VulkanDevice::getGraphicsQueue();
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        for (uint32_t i = 0; i < QueueTypeCount; i++) {
+            if (timelineIndex[i] != i) {
+                continue;
+            }
+            if (vkCreateSemaphore(Device::VulkanDevice::getLogicalDevice(), &semaphoreInfo, nullptr, &timelines[i].semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timeline semaphore!");
+            }
+            timelines[i].lastSubmitted.store(0);
+            timelines[i].completed.store(0);
+        }
+    }
+
+    VkQueue Timeline::getQueue(QueueType type){
+        return timelines[timelineIndex[type]].queue;
+    }
+
+    VkSemaphore Timeline::getSemaphore(QueueType type){
+        return timelines[timelineIndex[type]].semaphore;
+    }
+
+    SemaphoreWait Timeline::waitFor(QueueType type, uint64_t value, VkPipelineStageFlags stage){
+        return SemaphoreWait{getSemaphore(type), value, stage};
+    }
+
+    uint64_t Timeline::submit(QueueType type, const std::vector<VkCommandBuffer>& commandBuffers,
+                              const std::vector<SemaphoreWait>& waits,
+                              const std::vector<VkSemaphore>& binarySignals){
+        QueueTimeline& timeline = timelines[timelineIndex[type]];
+
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<uint64_t> waitValues;
+        std::vector<VkPipelineStageFlags> waitStages;
+        for (const auto& wait : waits) {
+            waitSemaphores.push_back(wait.semaphore);
+            waitValues.push_back(wait.value);
+            waitStages.push_back(wait.stage);
+        }
+
+        // 时间线信号量放在第一个，后面是交换链等需要的二值信号量
+        std::vector<VkSemaphore> signalSemaphores{timeline.semaphore};
+        signalSemaphores.insert(signalSemaphores.end(), binarySignals.begin(), binarySignals.end());
+        std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+
+        std::lock_guard<std::mutex> guard(timeline.submitLock);
+        uint64_t value = timeline.lastSubmitted.load(std::memory_order_relaxed) + 1;
+        signalValues[0] = value;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+        submitInfo.pCommandBuffers = commandBuffers.data();
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+        if (vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit command buffer!");
+        }
+        timeline.lastSubmitted.store(value, std::memory_order_release);
+        return value;
+    }
+
+    uint64_t Timeline::getLastSubmittedValue(QueueType type){
+        return timelines[timelineIndex[type]].lastSubmitted.load(std::memory_order_acquire);
+    }
+
+    uint64_t Timeline::advanceCompleted(QueueTimeline& timeline, uint64_t value){
+        uint64_t current = timeline.completed.load(std::memory_order_acquire);
+        // 多个线程可能同时查询到不同的值，只保留最大的那个
+        while (current < value && !timeline.completed.compare_exchange_weak(current, value, std::memory_order_acq_rel)) {
+        }
+        return current < value ? value : current;
+    }
+
+    uint64_t Timeline::getCompletedValue(QueueType type){
+        QueueTimeline& timeline = timelines[timelineIndex[type]];
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(Device::VulkanDevice::getLogicalDevice(), timeline.semaphore, &value) != VK_SUCCESS) {
+            throw std::runtime_error("failed to query timeline semaphore value!");
+        }
+        return advanceCompleted(timeline, value);
+    }
+
+    bool Timeline::isComplete(QueueType type, uint64_t value){
+        // 先比较缓存的完成值，大多数查询不需要调用驱动
+        if (value <= timelines[timelineIndex[type]].completed.load(std::memory_order_acquire)) {
+            return true;
+        }
+        return value <= getCompletedValue(type);
+    }
+
+    bool Timeline::wait(QueueType type, uint64_t value, uint64_t timeout){
+        if (isComplete(type, value)) {
+            return true;
+        }
+        QueueTimeline& timeline = timelines[timelineIndex[type]];
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline.semaphore;
+        waitInfo.pValues = &value;
+
+        VkResult result = vkWaitSemaphores(Device::VulkanDevice::getLogicalDevice(), &waitInfo, timeout);
+        if (result == VK_TIMEOUT) {
+            return false;
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for timeline semaphore!");
+        }
+        advanceCompleted(timeline, value);
+        return true;
+    }
+
+    void Timeline::waitIdle(){
+        for (uint32_t i = 0; i < QueueTypeCount; i++) {
+            if (timelineIndex[i] == i && timelines[i].semaphore != VK_NULL_HANDLE) {
+                wait(static_cast<QueueType>(i), timelines[i].lastSubmitted.load(std::memory_order_acquire));
+            }
+        }
+    }
+
+    void Timeline::cleanup(){
+        for (auto& timeline : timelines) {
+            if (timeline.semaphore != VK_NULL_HANDLE) {
+                vkDestroySemaphore(Device::VulkanDevice::getLogicalDevice(), timeline.semaphore, nullptr);
+            }
+            timeline.semaphore = VK_NULL_HANDLE;
+            timeline.queue = VK_NULL_HANDLE;
+            timeline.lastSubmitted.store(0);
+            timeline.completed.store(0);
+        }
+    }
+
+    void DeletionQueue::retire(QueueType type, std::function<void()> deleter){
+        retire(type, Timeline::getLastSubmittedValue(type), std::move(deleter));
+    }
+
+    void DeletionQueue::retire(QueueType type, uint64_t value, std::function<void()> deleter){
+        std::lock_guard<std::mutex> guard(lock);
+        pending.push_back(PendingDeletion{type, value, std::move(deleter)});
+    }
+
+    void DeletionQueue::collect(){
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            // 不同队列的值互不可比，逐个检查而不是只看队首
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (Timeline::isComplete(it->type, it->value)) {
+                    ready.push_back(std::move(it->deleter));
+                    it = pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (auto& deleter : ready) {
+            deleter();
+        }
+    }
+
+    void DeletionQueue::flush(){
+        std::deque<PendingDeletion> remaining;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            remaining.swap(pending);
+        }
+        for (auto& deletion : remaining) {
+            deletion.deleter();
+        }
+    }
+}
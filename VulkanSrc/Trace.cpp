@@ -0,0 +1,104 @@
+#include "Trace.h"
+
+#ifdef VULKAN_ENABLE_TRACING
+
+#include <chrono>
+#include <cstdio>
+
+
+namespace Tracing{
+    thread_local ThreadBuffer* Tracer::threadBuffer = nullptr;
+    std::mutex Tracer::registryLock;
+    std::vector<std::unique_ptr<ThreadBuffer>> Tracer::buffers;
+
+    namespace{
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+        void writeEscaped(FILE* file, const char* text){
+            for (; *text; text++) {
+                char c = *text;
+                if (c == '"' || c == '\\') {
+                    fputc('\\', file);
+                    fputc(c, file);
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    fprintf(file, "\\u%04x", c);
+                } else {
+                    fputc(c, file);
+                }
+            }
+        }
+    }
+
+    uint64_t Tracer::now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    ThreadBuffer& Tracer::registerThread(){
+        // 每个线程只在第一次记录时加一次锁
+        std::lock_guard<std::mutex> guard(registryLock);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        ThreadBuffer* buffer = buffers.back().get();
+        buffer->threadId = static_cast<uint32_t>(buffers.size());
+        threadBuffer = buffer;
+        return *buffer;
+    }
+
+    void Tracer::record(const char* name, uint64_t begin, uint64_t end){
+        ThreadBuffer& buffer = threadBuffer ? *threadBuffer : registerThread();
+        uint32_t index = buffer.count.load(std::memory_order_relaxed);
+        // 缓冲区满了之后丢弃新事件，只记数量，不在热路径上分配内存
+        if (index >= ThreadBuffer::CAPACITY) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer.events[index] = Event{name, begin, end};
+        buffer.count.store(index + 1, std::memory_order_release);
+    }
+
+    void Tracer::setThreadName(const std::string& name){
+        ThreadBuffer& buffer = threadBuffer ? *threadBuffer : registerThread();
+        std::lock_guard<std::mutex> guard(registryLock);
+        buffer.threadName = name;
+    }
+
+    bool Tracer::writeChromeTrace(const char* path){
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> guard(registryLock);
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto& buffer : buffers) {
+            if (!buffer->threadName.empty()) {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                        first ? "" : ",\n", buffer->threadId);
+                writeEscaped(file, buffer->threadName.c_str());
+                fprintf(file, "\"}}");
+                first = false;
+            }
+
+            // 只读取已经发布的事件，其它线程此时仍可以继续追加
+            uint32_t count = buffer->count.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; i++) {
+                const Event& event = buffer->events[i];
+                // 完整事件(ph为X)的时间单位是微秒
+                fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+                writeEscaped(file, event.name);
+                fprintf(file, "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        buffer->threadId, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+                first = false;
+            }
+
+            uint32_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+            if (dropped > 0) {
+                fprintf(stderr, "trace buffer of thread %u overflowed, %u events dropped\n", buffer->threadId, dropped);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+}
+
+#endif
@@ -0,0 +1,423 @@
+#include "VideoSink.h"
+#include "Jobs.h"
+#include "Trace.h"
+#include "Readback.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VIDEO_X86
+#endif
+
+
+namespace Video{
+    void DoInit(){
+        if (Config::videoOutputPath == nullptr) {
+            return;
+        }
+        size_t length = strlen(Config::videoOutputPath);
+        bool y4m = length >= 4 && strcmp(Config::videoOutputPath + length - 4, ".y4m") == 0;
+        VideoSink::open(Config::videoOutputPath, y4m ? Container::Y4M : Container::Raw, Config::videoFrameRate);
+        Readback::FrameReadback::addCallback([](const Readback::Frame& frame){
+            bool bgra = frame.format == VK_FORMAT_B8G8R8A8_UNORM || frame.format == VK_FORMAT_B8G8R8A8_SRGB;
+            bool rgba = frame.format == VK_FORMAT_R8G8B8A8_UNORM || frame.format == VK_FORMAT_R8G8B8A8_SRGB;
+            if (!bgra && !rgba) {
+                static bool reported = false;
+                if (!reported) {
+                    std::cerr << "video output only supports 8-bit BGRA/RGBA swapchain formats" << std::endl;
+                    reported = true;
+                }
+                return;
+            }
+            // 转换在后台进行，回读缓冲区保留到转换完成，渲染线程不等待
+            std::shared_ptr<Jobs::Counter> converted = VideoSink::submit(frame.data, frame.rowPitch, frame.width, frame.height, rgba);
+            if (converted) {
+                Readback::FrameReadback::retain(frame, std::move(converted));
+            }
+        });
+    }
+    void cleanup(){
+        VideoSink::close();
+    }
+
+    namespace{
+        // 定点系数放大256倍，按内存中的字节顺序排列；每组色度系数之和为0，灰色的色度正好是128
+        struct Coefficients{
+            int16_t y[3];
+            int16_t u[3];
+            int16_t v[3];
+        };
+        const Coefficients BGRA_COEFFICIENTS = {{16, 157, 47}, {112, -86, -26}, {-10, -102, 112}};
+        const Coefficients RGBA_COEFFICIENTS = {{47, 157, 16}, {-26, -86, 112}, {112, -102, -10}};
+        // 色度加上128 * 256 + 128的偏移后恒为正，16位无符号运算不会溢出
+        const int CHROMA_BIAS = 32896;
+
+        // 各实现的结果逐位相同，SIMD版本处理不完的尾部交给标量版本
+        void convertRowPairScalar(const uint8_t* row0, const uint8_t* row1, uint32_t xBegin, uint32_t width, const Coefficients& c,
+                                  uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v){
+            for (uint32_t x = xBegin; x < width; x += 2) {
+                int sum[3] = {0, 0, 0};
+                for (int row = 0; row < 2; row++) {
+                    const uint8_t* pixels = (row == 0 ? row0 : row1) + x * 4;
+                    uint8_t* luma = (row == 0 ? y0 : y1) + x;
+                    for (int dx = 0; dx < 2; dx++) {
+                        const uint8_t* p = pixels + dx * 4;
+                        luma[dx] = static_cast<uint8_t>(((c.y[0] * p[0] + c.y[1] * p[1] + c.y[2] * p[2] + 128) >> 8) + 16);
+                        sum[0] += p[0];
+                        sum[1] += p[1];
+                        sum[2] += p[2];
+                    }
+                }
+                int a0 = (sum[0] + 2) >> 2, a1 = (sum[1] + 2) >> 2, a2 = (sum[2] + 2) >> 2;
+                u[x / 2] = static_cast<uint8_t>((c.u[0] * a0 + c.u[1] * a1 + c.u[2] * a2 + CHROMA_BIAS) >> 8);
+                v[x / 2] = static_cast<uint8_t>((c.v[0] * a0 + c.v[1] * a1 + c.v[2] * a2 + CHROMA_BIAS) >> 8);
+            }
+        }
+
+#ifdef VIDEO_X86
+        // 把8个像素拆成三个分量，每个分量8个16位值
+        inline void splitChannels(__m128i first, __m128i second, __m128i* channels){
+            const __m128i byteMask = _mm_set1_epi32(0xFF);
+            for (int k = 0; k < 3; k++) {
+                channels[k] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 8 * k), byteMask),
+                                              _mm_and_si128(_mm_srli_epi32(second, 8 * k), byteMask));
+            }
+        }
+
+        // 16位乘法只保留低16位，结果按无符号数解释时与标量版本一致
+        inline __m128i weightedSum(const __m128i* channels, const __m128i* weights, __m128i bias){
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(channels[0], weights[0]), _mm_mullo_epi16(channels[1], weights[1]));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(channels[2], weights[2]));
+            return _mm_srli_epi16(_mm_add_epi16(sum, bias), 8);
+        }
+
+        // 两行各8个像素的分量相加后，相邻两列再相加，得到4个2x2块的平均值（32位）
+        inline __m128i average2x2(__m128i top, __m128i bottom){
+            __m128i sum = _mm_madd_epi16(_mm_add_epi16(top, bottom), _mm_set1_epi16(1));
+            return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(2)), 2);
+        }
+
+        // SSE2一次处理两行各16个像素
+        void convertRowPairSse2(const uint8_t* row0, const uint8_t* row1, uint32_t width, const Coefficients& c,
+                                uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v){
+            __m128i yWeights[3], uWeights[3], vWeights[3];
+            for (int k = 0; k < 3; k++) {
+                yWeights[k] = _mm_set1_epi16(c.y[k]);
+                uWeights[k] = _mm_set1_epi16(c.u[k]);
+                vWeights[k] = _mm_set1_epi16(c.v[k]);
+            }
+            const __m128i lumaBias = _mm_set1_epi16(128);
+            const __m128i lumaOffset = _mm_set1_epi16(16);
+            const __m128i chromaBias = _mm_set1_epi16(static_cast<int16_t>(CHROMA_BIAS));
+
+            uint32_t x = 0;
+            for (; x + 16 <= width; x += 16) {
+                __m128i channels[2][2][3];  // [行][前后8个像素][分量]
+                for (int row = 0; row < 2; row++) {
+                    const __m128i* pixels = reinterpret_cast<const __m128i*>((row == 0 ? row0 : row1) + x * 4);
+                    splitChannels(_mm_loadu_si128(pixels), _mm_loadu_si128(pixels + 1), channels[row][0]);
+                    splitChannels(_mm_loadu_si128(pixels + 2), _mm_loadu_si128(pixels + 3), channels[row][1]);
+                    __m128i low = _mm_add_epi16(weightedSum(channels[row][0], yWeights, lumaBias), lumaOffset);
+                    __m128i high = _mm_add_epi16(weightedSum(channels[row][1], yWeights, lumaBias), lumaOffset);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>((row == 0 ? y0 : y1) + x), _mm_packus_epi16(low, high));
+                }
+                __m128i average[3];
+                for (int k = 0; k < 3; k++) {
+                    average[k] = _mm_packs_epi32(average2x2(channels[0][0][k], channels[1][0][k]),
+                                                 average2x2(channels[0][1][k], channels[1][1][k]));
+                }
+                __m128i cb = weightedSum(average, uWeights, chromaBias);
+                __m128i cr = weightedSum(average, vWeights, chromaBias);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), _mm_packus_epi16(cb, cb));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), _mm_packus_epi16(cr, cr));
+            }
+            convertRowPairScalar(row0, row1, x, width, c, y0, y1, u, v);
+        }
+
+        // AVX2的pack按128位通道交错，重排64位块恢复顺序
+        __attribute__((target("avx2")))
+        inline __m256i packOrdered32(__m256i first, __m256i second){
+            return _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), 0xD8);
+        }
+
+        __attribute__((target("avx2")))
+        inline void splitChannels(__m256i first, __m256i second, __m256i* channels){
+            const __m256i byteMask = _mm256_set1_epi32(0xFF);
+            for (int k = 0; k < 3; k++) {
+                channels[k] = packOrdered32(_mm256_and_si256(_mm256_srli_epi32(first, 8 * k), byteMask),
+                                            _mm256_and_si256(_mm256_srli_epi32(second, 8 * k), byteMask));
+            }
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256i weightedSum(const __m256i* channels, const __m256i* weights, __m256i bias){
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(channels[0], weights[0]), _mm256_mullo_epi16(channels[1], weights[1]));
+            sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(channels[2], weights[2]));
+            return _mm256_srli_epi16(_mm256_add_epi16(sum, bias), 8);
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256i average2x2(__m256i top, __m256i bottom){
+            __m256i sum = _mm256_madd_epi16(_mm256_add_epi16(top, bottom), _mm256_set1_epi16(1));
+            return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(2)), 2);
+        }
+
+        // AVX2一次处理两行各32个像素，运行时检测CPU支持后才会调用
+        __attribute__((target("avx2")))
+        void convertRowPairAvx2(const uint8_t* row0, const uint8_t* row1, uint32_t width, const Coefficients& c,
+                                uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v){
+            __m256i yWeights[3], uWeights[3], vWeights[3];
+            for (int k = 0; k < 3; k++) {
+                yWeights[k] = _mm256_set1_epi16(c.y[k]);
+                uWeights[k] = _mm256_set1_epi16(c.u[k]);
+                vWeights[k] = _mm256_set1_epi16(c.v[k]);
+            }
+            const __m256i lumaBias = _mm256_set1_epi16(128);
+            const __m256i lumaOffset = _mm256_set1_epi16(16);
+            const __m256i chromaBias = _mm256_set1_epi16(static_cast<int16_t>(CHROMA_BIAS));
+
+            uint32_t x = 0;
+            for (; x + 32 <= width; x += 32) {
+                __m256i channels[2][2][3];  // [行][前后16个像素][分量]
+                for (int row = 0; row < 2; row++) {
+                    const __m256i* pixels = reinterpret_cast<const __m256i*>((row == 0 ? row0 : row1) + x * 4);
+                    splitChannels(_mm256_loadu_si256(pixels), _mm256_loadu_si256(pixels + 1), channels[row][0]);
+                    splitChannels(_mm256_loadu_si256(pixels + 2), _mm256_loadu_si256(pixels + 3), channels[row][1]);
+                    __m256i low = _mm256_add_epi16(weightedSum(channels[row][0], yWeights, lumaBias), lumaOffset);
+                    __m256i high = _mm256_add_epi16(weightedSum(channels[row][1], yWeights, lumaBias), lumaOffset);
+                    __m256i luma = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>((row == 0 ? y0 : y1) + x), luma);
+                }
+                __m256i average[3];
+                for (int k = 0; k < 3; k++) {
+                    average[k] = packOrdered32(average2x2(channels[0][0][k], channels[1][0][k]),
+                                               average2x2(channels[0][1][k], channels[1][1][k]));
+                }
+                __m256i cb = _mm256_permute4x64_epi64(_mm256_packus_epi16(weightedSum(average, uWeights, chromaBias), _mm256_setzero_si256()), 0xD8);
+                __m256i cr = _mm256_permute4x64_epi64(_mm256_packus_epi16(weightedSum(average, vWeights, chromaBias), _mm256_setzero_si256()), 0xD8);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x / 2), _mm256_castsi256_si128(cb));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(v + x / 2), _mm256_castsi256_si128(cr));
+            }
+            convertRowPairSse2(row0 + x * 4, row1 + x * 4, width - x, c, y0 + x, y1 + x, u + x / 2, v + x / 2);
+        }
+#endif
+
+        void convertRowPairScalarFull(const uint8_t* row0, const uint8_t* row1, uint32_t width, const Coefficients& c,
+                                      uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v){
+            convertRowPairScalar(row0, row1, 0, width, c, y0, y1, u, v);
+        }
+
+        using RowPairFunc = void (*)(const uint8_t*, const uint8_t*, uint32_t, const Coefficients&, uint8_t*, uint8_t*, uint8_t*, uint8_t*);
+
+        RowPairFunc selectKernel(ColorConverter::Kernel kernel){
+#ifdef VIDEO_X86
+            __builtin_cpu_init();
+            bool avx2 = __builtin_cpu_supports("avx2");
+            switch (kernel) {
+                case ColorConverter::Kernel::Scalar:
+                    return convertRowPairScalarFull;
+                case ColorConverter::Kernel::Sse2:
+                    return convertRowPairSse2;
+                default:
+                    // 强制AVX2但CPU不支持时退回SSE2
+                    return avx2 ? convertRowPairAvx2 : convertRowPairSse2;
+            }
+#else
+            return convertRowPairScalarFull;
+#endif
+        }
+
+        RowPairFunc activeKernel = selectKernel(ColorConverter::Kernel::Auto);
+
+        // 每个任务转换的行对数，4K下约68个任务
+        const uint32_t ROW_PAIRS_PER_JOB = 16;
+    }
+
+    void ColorConverter::setKernel(Kernel kernel){
+        activeKernel = selectKernel(kernel);
+    }
+
+    void ColorConverter::convertRows(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, bool rgba,
+                                     uint32_t rowPairBegin, uint32_t rowPairEnd,
+                                     uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane){
+        const Coefficients& coefficients = rgba ? RGBA_COEFFICIENTS : BGRA_COEFFICIENTS;
+        uint32_t chromaWidth = width / 2;
+        for (uint32_t pair = rowPairBegin; pair < rowPairEnd; pair++) {
+            const uint8_t* row0 = pixels + static_cast<size_t>(pair) * 2 * rowPitch;
+            uint8_t* y0 = yPlane + static_cast<size_t>(pair) * 2 * width;
+            activeKernel(row0, row0 + rowPitch, width, coefficients, y0, y0 + width,
+                         uPlane + static_cast<size_t>(pair) * chromaWidth, vPlane + static_cast<size_t>(pair) * chromaWidth);
+        }
+    }
+
+    void ColorConverter::convert(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba,
+                                 uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane){
+        Jobs::JobSystem::parallelFor(height / 2, ROW_PAIRS_PER_JOB, [=](uint32_t begin, uint32_t end){
+            convertRows(pixels, rowPitch, width, rgba, begin, end, yPlane, uPlane, vPlane);
+        });
+    }
+
+    void ColorConverter::convertAsync(const uint8_t* pixels, uint32_t rowPitch, uint32_t width, uint32_t height, bool rgba,
+                                      uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane, Jobs::Counter* counter){
+        uint32_t rowPairs = height / 2;
+        for (uint32_t begin = 0; begin < rowPairs; begin += ROW_PAIRS_PER_JOB) {
+            uint32_t end = std::min(rowPairs, begin + ROW_PAIRS_PER_JOB);
+            Jobs::JobSystem::run([=](){
+                convertRows(pixels, rowPitch, width, rgba, begin, end, yPlane, uPlane, vPlane);
+            }, counter);
+        }
+    }
+
+    FILE* VideoSink::file = nullptr;
+    Container VideoSink::container = Container::Y4M;
+    uint32_t VideoSink::frameRate = 60;
+    uint32_t VideoSink::width = 0;
+    uint32_t VideoSink::height = 0;
+    std::vector<std::vector<uint8_t>> VideoSink::buffers;
+    std::vector<uint32_t> VideoSink::freeBuffers;
+    std::deque<VideoSink::QueuedFrame> VideoSink::writeQueue;
+    std::mutex VideoSink::queueLock;
+    std::condition_variable VideoSink::queueCondition;
+    std::thread VideoSink::writer;
+    bool VideoSink::stopping = false;
+    uint64_t VideoSink::frameCount = 0;
+    uint64_t VideoSink::droppedCount = 0;
+    uint64_t VideoSink::stallCount = 0;
+
+    void VideoSink::open(const char* path, Container outputContainer, uint32_t outputFrameRate){
+        close();
+        file = fopen(path, "wb");
+        if (!file) {
+            throw std::runtime_error("failed to open video output file!");
+        }
+        container = outputContainer;
+        frameRate = outputFrameRate;
+        width = 0;
+        height = 0;
+        frameCount = 0;
+        droppedCount = 0;
+        stallCount = 0;
+        stopping = false;
+        writer = std::thread(writerLoop);
+    }
+
+    bool VideoSink::isOpen(){
+        return file != nullptr;
+    }
+
+    std::shared_ptr<Jobs::Counter> VideoSink::submit(const uint8_t* pixels, uint32_t rowPitch, uint32_t frameWidth, uint32_t frameHeight, bool rgba){
+        if (!file) {
+            return nullptr;
+        }
+        TRACE_SCOPE("video submit");
+        // I420的色度是宽高各一半，奇数尺寸裁掉最后一列或一行
+        uint32_t evenWidth = frameWidth & ~1u;
+        uint32_t evenHeight = frameHeight & ~1u;
+        if (evenWidth == 0 || evenHeight == 0) {
+            return nullptr;
+        }
+        if (width == 0) {
+            width = evenWidth;
+            height = evenHeight;
+            size_t frameSize = static_cast<size_t>(width) * height * 3 / 2;
+            buffers.assign(BUFFER_COUNT, std::vector<uint8_t>(frameSize));
+            freeBuffers.clear();
+            for (uint32_t i = 0; i < BUFFER_COUNT; i++) {
+                freeBuffers.push_back(i);
+            }
+            // 写线程此时还没有任务，文件头可以直接在这里写入
+            if (container == Container::Y4M) {
+                fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, frameRate);
+            }
+        } else if (evenWidth != width || evenHeight != height) {
+            // 视频流中途不能改变分辨率
+            droppedCount++;
+            return nullptr;
+        }
+
+        uint32_t index;
+        {
+            std::unique_lock<std::mutex> lock(queueLock);
+            if (freeBuffers.empty()) {
+                stallCount++;
+                queueCondition.wait(lock, []{ return !freeBuffers.empty(); });
+            }
+            index = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        uint8_t* yPlane = buffers[index].data();
+        uint8_t* uPlane = yPlane + static_cast<size_t>(width) * height;
+        uint8_t* vPlane = uPlane + static_cast<size_t>(width / 2) * (height / 2);
+        auto converted = std::make_shared<Jobs::Counter>();
+        ColorConverter::convertAsync(pixels, rowPitch, width, height, rgba, yPlane, uPlane, vPlane, converted.get());
+
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            writeQueue.push_back({index, converted});
+            frameCount++;
+        }
+        queueCondition.notify_all();
+        return converted;
+    }
+
+    void VideoSink::writerLoop(){
+        TRACE_THREAD_NAME("video writer");
+        std::unique_lock<std::mutex> lock(queueLock);
+        while (true) {
+            queueCondition.wait(lock, []{ return stopping || !writeQueue.empty(); });
+            if (writeQueue.empty()) {
+                break;  // 停止时先把排队的帧写完
+            }
+            QueuedFrame queued = writeQueue.front();
+            writeQueue.pop_front();
+            uint32_t index = queued.buffer;
+            lock.unlock();
+            {
+                // 按提交顺序写入，这一帧还没转换完时帮忙执行转换任务
+                TRACE_SCOPE("video write");
+                Jobs::JobSystem::wait(*queued.converted);
+                if (container == Container::Y4M) {
+                    fputs("FRAME\n", file);
+                }
+                fwrite(buffers[index].data(), 1, buffers[index].size(), file);
+            }
+            lock.lock();
+            freeBuffers.push_back(index);
+            queueCondition.notify_all();
+        }
+    }
+
+    void VideoSink::close(){
+        if (!file) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        writer.join();
+        fclose(file);
+        file = nullptr;
+        buffers.clear();
+        freeBuffers.clear();
+    }
+
+    uint64_t VideoSink::getFrameCount(){
+        return frameCount;
+    }
+
+    uint64_t VideoSink::getDroppedCount(){
+        return droppedCount;
+    }
+
+    uint64_t VideoSink::getStallCount(){
+        return stallCount;
+    }
+}
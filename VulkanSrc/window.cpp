@@ -1,6 +1,8 @@
 #include "window.h"
 #include "Config.h"
 #include "Draw.h"
+#include "FramePacer.h"
+#include "Present.h"
 
 
 namespace Init
@@ -9,12 +11,21 @@ namespace Init
 
     void GlfwWindow::initWindow(int &error_code)
     {
+        if (Config::headless) {
+            return;
+        }
         glfwInit();
-        // 禁用Opengl上下文和重置窗口大小
+        // 禁用Opengl上下文，允许调整窗口大小
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
         using Config::AreaWidthHeigh;
         glfw_window_handler = glfwCreateWindow((int)AreaWidthHeigh::Width, (int)AreaWidthHeigh::Height, "Vulkan", nullptr, nullptr);
+        // 帧缓冲大小改变时通知交换链在下一次呈现后重建
+        glfwSetFramebufferSizeCallback(glfw_window_handler, [](GLFWwindow*, int, int){
+            Presentation::SwapChain::requestRecreate();
+        });
+        // 输入由帧循环在开始录制前采样
+        Pacing::FramePacer::setInputSampler(glfwPollEvents);
     }
 
     const char** GlfwWindow::GetExtensionInfo(uint32_t &glfwExtensionCount)
@@ -24,13 +35,22 @@ namespace Init
 
     void GlfwWindow::loop()
     {
+        if (Config::headless) {
+            // 无窗口模式没有关闭事件，渲染配置的帧数后退出
+            for (uint32_t frame = 0; frame < Config::headlessFrameCount; frame++) {
+                DrawSpace::CommondFactory::drawFrame();
+            }
+            return;
+        }
         while (!glfwWindowShouldClose(glfw_window_handler)) {
-            glfwPollEvents();
             DrawSpace::CommondFactory::drawFrame();
         }
     }
     void GlfwWindow::cleanup()
     {
+        if (glfw_window_handler == nullptr) {
+            return;
+        }
         glfwDestroyWindow(glfw_window_handler);
         glfwTerminate();
     }
@@ -0,0 +1,73 @@
+# 把SPIR-V文件转换成C++头文件，每个着色器一个alignas(4) constexpr uint32_t数组，
+# 最后是按名字升序排列的表，名字是去掉.spv后缀的文件名，ShaderRegistry对它做二分查找
+#
+# cmake -DSHADER_FILES=<a.spv|b.spv> -DOUTPUT_FILE=<头文件> -P EmbedShaders.cmake
+# 文件列表用'|'分隔，避免在add_custom_command中被当成多个参数
+
+cmake_minimum_required(VERSION 3.15)
+
+if(NOT SHADER_FILES OR NOT OUTPUT_FILE)
+    message(FATAL_ERROR "usage: cmake -DSHADER_FILES=<a.spv|b.spv> -DOUTPUT_FILE=<header> -P EmbedShaders.cmake")
+endif()
+
+string(REPLACE "|" ";" SHADER_FILES "${SHADER_FILES}")
+set(BYTE "[0-9a-f][0-9a-f]")
+set(WORD "0x[0-9a-f]+u, ")
+string(REPEAT "${WORD}" 8 LINE)
+
+set(NAMES "")
+foreach(SHADER_FILE IN LISTS SHADER_FILES)
+    get_filename_component(NAME "${SHADER_FILE}" NAME)
+    string(REGEX REPLACE "\\.spv$" "" NAME "${NAME}")
+    if(NOT NAME MATCHES "^[A-Za-z0-9_.-]+$")
+        message(FATAL_ERROR "invalid shader name ${NAME}!")
+    endif()
+    if(NAME IN_LIST NAMES)
+        message(FATAL_ERROR "duplicate shader name ${NAME}!")
+    endif()
+    list(APPEND NAMES "${NAME}")
+    set(FILE_OF_${NAME} "${SHADER_FILE}")
+endforeach()
+list(SORT NAMES)
+
+set(CONTENT "// 由cmake/EmbedShaders.cmake生成，不要手动修改\n\n")
+set(TABLE "")
+set(INDEX 0)
+foreach(NAME IN LISTS NAMES)
+    set(SHADER_FILE "${FILE_OF_${NAME}}")
+    file(SIZE "${SHADER_FILE}" SIZE)
+    math(EXPR REMAINDER "${SIZE} % 4")
+    if(SIZE LESS 20 OR NOT REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SHADER_FILE} is not a SPIR-V module!")
+    endif()
+    file(READ "${SHADER_FILE}" HEX HEX)
+    # 按魔数判断文件的字节序，输出的是字的数值，与构建机器的字节序无关
+    string(SUBSTRING "${HEX}" 0 8 MAGIC)
+    if(MAGIC STREQUAL "03022307")
+        string(REGEX REPLACE "(${BYTE})(${BYTE})(${BYTE})(${BYTE})" "0x\\4\\3\\2\\1u, " WORDS "${HEX}")
+    elseif(MAGIC STREQUAL "07230203")
+        string(REGEX REPLACE "(${BYTE})(${BYTE})(${BYTE})(${BYTE})" "0x\\1\\2\\3\\4u, " WORDS "${HEX}")
+    else()
+        message(FATAL_ERROR "${SHADER_FILE} is not a SPIR-V module!")
+    endif()
+    string(REGEX REPLACE "(${LINE})" "\\1\n" WORDS "${WORDS}")
+    string(REGEX REPLACE "[ \n]+$" "" WORDS "${WORDS}")
+    string(REPLACE " \n" "\n    " WORDS "${WORDS}")
+    math(EXPR WORD_COUNT "${SIZE} / 4")
+
+    get_filename_component(FILE_NAME "${SHADER_FILE}" NAME)
+    string(APPEND CONTENT "// ${FILE_NAME}\n")
+    string(APPEND CONTENT "alignas(4) constexpr uint32_t SHADER_${INDEX}[${WORD_COUNT}] = {\n    ${WORDS}\n};\n\n")
+    string(APPEND TABLE "    {\"${NAME}\", SHADER_${INDEX}, ${WORD_COUNT}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+string(APPEND CONTENT "constexpr ShaderRegistry::EmbeddedShader EMBEDDED_SHADERS[] = {\n${TABLE}};\n")
+
+# 内容不变时不改写，避免依赖它的源文件重新编译
+if(EXISTS "${OUTPUT_FILE}")
+    file(READ "${OUTPUT_FILE}" PREVIOUS)
+    if(PREVIOUS STREQUAL CONTENT)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT_FILE}" "${CONTENT}")